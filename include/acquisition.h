@@ -0,0 +1,127 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#ifndef _ACQUISITION_H_
+#define _ACQUISITION_H_
+
+#include <stdint.h>
+
+#include <ADS1115.h>
+
+#include "config.h"
+
+extern ADS1115 ads;
+
+// resolution of the values returned by acquisitionRead(), at PGA = 16
+#ifdef ADS_OVERSAMPLING
+#define ADS_NV_PER_COUNT (7812L >> ADS_OVERSAMPLING_BITS)
+#else
+#define ADS_NV_PER_COUNT 7812L
+#endif
+// same in µV, Q10: µV = counts * ADS_UV_PER_COUNT_Q10 >> 10, without a division
+#define ADS_UV_PER_COUNT_Q10 ((ADS_NV_PER_COUNT * 1024L + 500) / 1000)
+
+// O2 cells, on MUX_DIFF_0_1 and MUX_DIFF_2_3
+#ifdef DUAL_CELL_ENABLE
+#define CELL_COUNT 2
+#else
+#define CELL_COUNT 1
+#endif
+// conversions dropped after each MUX switch, the first one still ran on the
+// previous input (and the RC filter of the new one settles)
+#define ADS_MUX_DISCARD 1
+
+// time between two values of a cell returned by acquisitionRead(), µs
+#if defined(DUAL_CELL_ENABLE)
+#define ADS_SAMPLE_PERIOD (1000000ul * CELL_COUNT * (ADS_DECIMATION + ADS_MUX_DISCARD) / 475)
+#elif defined(ADS_OVERSAMPLING)
+#define ADS_SAMPLE_PERIOD (1000000ul * ADS_DECIMATION / 475)
+#elif defined(ADS_ALERT_PIN)
+#define ADS_SAMPLE_PERIOD (1000000ul / 16)
+#else
+#define ADS_SAMPLE_PERIOD (1000ul * ANALYZE_INTERVAL)
+#endif
+
+/**
+ * Configure the ADC and start continuous conversions
+ * 
+ * Depending on config.h / build flags, samples are:
+ * - read by the TWI interrupt as soon as ALERT/RDY fires (ADS_ALERT_PIN + TWI_QUEUE)
+ * - read by the main loop after ALERT/RDY fired (ADS_ALERT_PIN)
+ * - polled every ANALYZE_INTERVAL
+ * With ADS_OVERSAMPLING, the TWI interrupt decimates the conversions and
+ * only the averaged values are returned.
+ * With DUAL_CELL_ENABLE, the TWI interrupt also switches the MUX to the
+ * other cell after each block of ADS_DECIMATION conversions, and drops the
+ * ADS_MUX_DISCARD first ones after the switch: a cell gets
+ * 475 x ADS_DECIMATION / (CELL_COUNT x (ADS_DECIMATION + ADS_MUX_DISCARD))
+ * conversions per second, one value every ADS_SAMPLE_PERIOD.
+ */
+void acquisitionBegin();
+
+/**
+ * Power the ADC down (single-shot mode, no conversion) and back up
+ * 
+ * acquisitionRead() returns nothing while stopped, samples taken before
+ * the stop are dropped by acquisitionStart().
+ */
+void acquisitionStart();
+void acquisitionStop();
+bool acquisitionRunning();
+
+/**
+ * Get the next sample, if any
+ * 
+ * @param value ADC reading, ADS_NV_PER_COUNT nV per count
+ * @param cell 0 to CELL_COUNT - 1, the cells come in turn
+ * @return true if a new sample was available
+ */
+bool acquisitionRead(int16_t* value, uint8_t* cell);
+
+/**
+ * Number of samples of a cell returned by acquisitionRead() since power-up
+ */
+uint32_t acquisitionSamples(uint8_t cell);
+
+#ifdef WATCH_ENABLE
+/**
+ * Watch the cell instead of sampling it (WATCH_ENABLE)
+ * 
+ * The ADC converts at 8 SPS with its window comparator on value +/- band:
+ * nothing is read, there is no I2C traffic, ALERT/RDY only fires once two
+ * conversions in a row are out of the window, and acquisitionChanged()
+ * then returns true, once. acquisitionStart() / acquisitionStop() end it.
+ * Only the first cell is watched.
+ * 
+ * @param value, band in acquisitionRead() counts of the first cell
+ */
+void acquisitionWatch(int16_t value, int16_t band);
+bool acquisitionChanged();
+#endif
+
+#ifdef ADS_ALERT_PIN
+/**
+ * ALERT/RDY pin change, called from the pin change interrupt it shares
+ * with the encoder button
+ * 
+ * @param otherPin true if another pin of the vector changed
+ */
+void acquisitionAlert(bool otherPin);
+#endif
+
+/**
+ * Number of conversions lost since power-up
+ * (e.g. main loop or I2C bus too busy to collect them)
+ */
+uint16_t acquisitionOverruns();
+
+#endif // _ACQUISITION_H_
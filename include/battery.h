@@ -0,0 +1,68 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#ifndef _BATTERY_H_
+#define _BATTERY_H_
+
+#include <stdint.h>
+
+#include "config.h"
+
+/**
+ * Battery voltage, measured by the AVR ADC on BATTERY_PIN
+ * 
+ * Conversions are started by batteryStart() and collected by the ADC
+ * interrupt, the main loop never polls the ADC. When neither the I2C bus
+ * nor the UART is busy, the CPU sleeps through the conversion in ADC noise
+ * reduction mode: it wakes up on the ADC interrupt (or any earlier one),
+ * ~110 µs later. Timer 0 is stopped meanwhile, millis() loses that time.
+ * The voltage is the average of the last BATTERY_AVERAGE conversions.
+ */
+
+/**
+ * Configure the ADC, with a first (blocking) conversion
+ */
+void batteryBegin();
+
+/**
+ * Start a conversion, unless one is already running
+ */
+void batteryStart();
+
+/**
+ * Collect the finished conversions
+ * 
+ * @param voltage average battery voltage, mV
+ * @return true if there was a new conversion
+ */
+bool batteryRead(int16_t* voltage);
+
+/**
+ * State of charge of a Li-ion cell at rest, from its voltage
+ * 
+ * @return 0 to 100 %
+ */
+uint8_t batteryStateOfCharge(int16_t voltage);
+
+/**
+ * Conversion result, called by the port from the ADC interrupt
+ */
+void batteryConversion(uint16_t value);
+
+/**
+ * Hardware port, battery.cpp provides the AVR one
+ * batteryPortStart() may only sleep if asked to, and the UART is idle
+ */
+void batteryPortBegin();
+void batteryPortStart(bool sleep);
+
+#endif // _BATTERY_H_
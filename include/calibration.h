@@ -0,0 +1,111 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#ifndef _CALIBRATION_H_
+#define _CALIBRATION_H_
+
+#include <stdint.h>
+
+enum calibration_status_t {
+	CALIBRATION_BUSY,
+	CALIBRATION_DONE,
+	CALIBRATION_NOISY,   // standard error still too high at timeout, or samples too spread
+	CALIBRATION_DRIFT,   // recent readings moved away from the mean
+	CALIBRATION_RANGE,   // cell output not plausible for the gas (dead cell, wrong wiring)
+	CALIBRATION_NONLINEAR, // O2 point off the line through zero and air (worn out cell)
+};
+
+// reference gas of a calibration
+enum calibration_gas_t {
+	CALIBRATION_AIR,     // 20.95 %
+	CALIBRATION_O2,      // 100 %
+};
+
+#define CALIBRATION_GAIN_SHIFT  14
+
+/**
+ * Linear model of the cell: O2 = (counts - offset) * gain
+ * 
+ * gain is the reciprocal of the cell sensitivity, so that the conversion
+ * does not need any division. An air calibration only updates the gain,
+ * an O2 calibration sets both the gain and the offset, through the air
+ * point of the current model. Not calibrated: gain is 0.
+ */
+struct calibration_model_t {
+	uint16_t gain;       // 0.01 % O2 per count, Q14
+	int16_t offset;      // counts at 0 % O2
+};
+
+// O2 concentration in 0.01%, from ADC counts
+inline int16_t calibrationConcentration(const calibration_model_t& model, int16_t counts)
+{
+	int32_t concentration = ((int32_t)(counts - model.offset) * model.gain
+		+ (1L << (CALIBRATION_GAIN_SHIFT - 1))) >> CALIBRATION_GAIN_SHIFT;
+	return concentration > INT16_MAX ? INT16_MAX : (int16_t)concentration;
+}
+
+/**
+ * Collects the calibration samples and tells when their mean is good enough
+ * 
+ * Running mean and variance use Welford's algorithm, in fixed point
+ * (mean in 1/256 count, sum of squared deviations in 1/65536 count²).
+ * Calibration is done as soon as the standard error of the mean is below
+ * CALIBRATION_MAX_STDERR, and at least CALIBRATION_MIN_TIME elapsed.
+ */
+class Calibration {
+public:
+	/**
+	 * @param nvPerCount ADC resolution, nV per count
+	 */
+	Calibration(uint16_t nvPerCount);
+
+	void begin(uint32_t now, calibration_gas_t gas = CALIBRATION_AIR);
+	void addSample(int16_t value);
+
+	/**
+	 * Check the samples collected so far
+	 * 
+	 * @param recentAverage average of the last readings, in counts, to detect drift
+	 * @param now ms
+	 */
+	calibration_status_t update(int16_t recentAverage, uint32_t now);
+
+	/**
+	 * Fit the model to the mean of the samples, once update() is done
+	 * 
+	 * The air point of an O2 calibration is where *model reads 20.95 %.
+	 * *model is only changed on success.
+	 * @return CALIBRATION_DONE, CALIBRATION_RANGE or CALIBRATION_NONLINEAR
+	 */
+	calibration_status_t fit(calibration_model_t* model) const;
+
+	// mean of the samples, µV
+	int32_t getMicroVolts() const;
+	// standard deviation of the samples, nV
+	uint32_t getNoise() const;
+	uint16_t getCount() const { return count; }
+	calibration_gas_t getGas() const { return gas; }
+	// O2 concentration of the reference gas, 0.01%
+	uint16_t getReference() const { return gas == CALIBRATION_O2 ? 10000 : 2095; }
+
+private:
+	uint32_t variance() const;   // count², Q16
+
+	uint16_t nvPerCount;
+	calibration_gas_t gas;
+	uint32_t start;
+	uint16_t count;
+	int32_t mean;                // count, Q8
+	uint64_t m2;                 // count², Q16
+};
+
+#endif // _CALIBRATION_H_
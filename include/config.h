@@ -15,25 +15,124 @@
 
 // TIMING AND DELAYS
 #define SPLASH_DELAY            2000 // ms
-#define DISPLAY_REFRESH_RATE    1000 // ms
+#define DISPLAY_REFRESH_RATE    250  // ms
 #define ANALYZE_INTERVAL        250  // ms
-#define SAMPLE_SIZE             20u  // nb of values to be averaged
-#define CALIBRATION_TIME        6000 // ms - should be > ANALYZE_INTERVAL * SAMPLE_SIZE
-#define BATTERY_INTERVAL        5000
-#define BATTERY_THRESHOLD       3500 // mV
+#define SAMPLE_SIZE             16u  // nb of values to be averaged, power of 2 is faster
+#define SAMPLE_BITS             14u  // |ADC counts| < 2^14 (128 mV), 32-bit variance up to 16 values
+#define CALIBRATION_TIME        6000 // ms - give up if the mean did not converge by then
+#define BATTERY_INTERVAL        1000 // ms - one conversion, see battery.h
+#define SAMPLING_INTERVAL       10   // ms - collect ADC samples, well before the FIFO fills
+#define CALIBRATION_INTERVAL    50   // ms - check whether the calibration converged
+
+// ADC
+// ALERT/RDY output of the ADS1115, used as conversion-ready interrupt
+// must be on PORTD (D0-D7, PCINT2) - comment out to poll every ANALYZE_INTERVAL
+#define ADS_ALERT_PIN 7
+// run the ADC at 475 SPS and average blocks of ADS_DECIMATION conversions
+// (boxcar decimation, ~30 values/s with ADS_OVERSAMPLING_BITS extra bits)
+// needs ADS_ALERT_PIN and the TWI_QUEUE build - comment out for 16 SPS
+#define ADS_OVERSAMPLING
+#define ADS_DECIMATION          16u  // power of 2
+#define ADS_OVERSAMPLING_BITS   1    // 1/2 LSB resolution, +/-128mV range
+
+// SECOND CELL
+// a second O2 cell between AIN2 (P) and AIN3 (N), converted in turn with the
+// first one: each cell has its own average and calibration, and the cells are
+// cross-checked (see acquisition.h, voting.h) - needs ADS_OVERSAMPLING
+// enabled by -D DUAL_CELL_ENABLE (native_dual env), for boards with two cells
+#define CELL_MAX_DIFFERENCE     50   // 0.01% - the cells disagree beyond 0.5% O2 of each other...
+#define CELL_DISAGREE_TIME      3000 // ms - ...and are flagged on screen once it lasts 3s
+
+// CALIBRATION
+// done as soon as the mean of the samples is known well enough, see calibration.h
+#define CALIBRATION_MIN_TIME    1000  // ms
+#define CALIBRATION_MAX_STDERR  500   // nV - standard error of the mean
+#define CALIBRATION_MAX_NOISE   20    // µV - std dev of the samples
+#define CALIBRATION_MAX_DRIFT   10    // µV - last readings vs mean
+#define CALIBRATION_MIN_UV      6000  // µV - plausible cell output in air
+#define CALIBRATION_MAX_UV      16000 // µV
+// O2 point: the air point alone must read 100% +/- this, in 0.01% O2
+#define CALIBRATION_MAX_NONLINEARITY 300
+
+// BATTERY
+// 1:2 divider on BATTERY_PIN, state of charge from a Li-ion discharge curve
+#define BATTERY_PIN             A0
+#define BATTERY_VREF            3300 // mV - AVcc
+#define BATTERY_AVERAGE         8    // conversions
+#define BATTERY_LOW             10   // % - warning at or below
+#define BATTERY_HYSTERESIS      3    // % - the shown charge only goes up by this much (charging)
+
+// DISPLAY
+// only send the SH1106 pages covering regions that changed since the last frame
+#define DISPLAY_PARTIAL_UPDATE
+#define DISPLAY_CONTRAST        0xCF // as set by u8g2.begin()
+#define DISPLAY_DIM_CONTRAST    0x10
+#define DISPLAY_DIM_DELAY       30000 // ms - without input or state change (POWER_ENABLE)
+
+// POWER
+// sleep between tasks, ADC powered down when no reading is needed (menus, HOLD without WATCH_ENABLE)
+// and display dimmed without input, see power.h - comment out to disable
+#define POWER_ENABLE
+
+// WAKE ON CHANGE
+// in HOLD, the ADC window comparator watches the cell instead of the CPU, and
+// analysis resumes by itself when the gas changes (next cylinder)
+// needs POWER_ENABLE and ADS_ALERT_PIN - comment out to disable
+#define WATCH_ENABLE
+#define WATCH_BAND              100  // 0.01% - resume once the reading leaves +/-1% O2 around the held one
+
+// AUTO HOLD
+// go to HOLD by itself once the O2 reading is stable - comment out to disable
+#define AUTO_HOLD_ENABLE
+#define AUTO_HOLD_TOLERANCE     5    // 0.01% - reading stays within +/-0.05%...
+#define AUTO_HOLD_TIME          3000 // ms - ...for 3s
+#define AUTO_HOLD_MAX_SLOPE     60   // 0.01% / min - and drifts less than 0.6%/min
+#define AUTO_HOLD_MAX_SPREAD    10   // 0.01% - std dev of the averaged samples
+#define AUTO_HOLD_ARM           50   // 0.01% - only once the reading moved 0.5% away from the last held one (or air)
+
+// BATCH (FILL STATION)
+// each automatic HOLD is numbered and logged to EEPROM (O2, MOD at pO2 1.4, cell mV,
+// time since boot), a double click in HOLD dumps the log as CSV on Serial at 19200 baud
+// (not with TELEMETRY_ENABLE) - needs AUTO_HOLD_ENABLE and EEPROM_ENABLE - comment out to disable
+#define BATCH_ENABLE
+
+// PREDICTION
+// while the cell settles, show the final value predicted from its exponential response
+#define PREDICTION_ENABLE
+#define CELL_TIME_CONSTANT      6000 // ms - starting value, refined on each reading
+#define PREDICTION_SAMPLES      8    // ADC values between two points fed to the fit (~270ms)
+#define PREDICTION_SPAN         4    // x PREDICTION_SAMPLES between the 3 points of the fit
+#define PREDICTION_SETTLED      5    // 0.01% - show the measured value once within +/-0.05% of the prediction
 
 // ENCODER
 #define ENC_PIN_A   2
 #define ENC_PIN_B   3
 #define ENC_PIN_SW  4
 #define ENC_STEPS   4
+#define ENC_DEBOUNCE          5   // ms - button level stable for
+#define ENC_HOLD_TIME         800 // ms
+#define ENC_DOUBLE_CLICK_TIME 400 // ms - a click is reported once over
 
 // BUZZER
 #define BUZZER_ENABLE
 #define BUZZER_PIN	8
 
+// TELEMETRY
+// binary sample stream on Serial for logging / analysis on a PC, see telemetry.h
+// enabled by -D TELEMETRY_ENABLE (pro8_telemetry env), instead of DEBUG / PROFILE
+#define TELEMETRY_BAUD          250000 // exact at 8MHz, ~5kB/s are used at 475 SPS
+#define TELEMETRY_BUFFER        256    // bytes, power of 2 - with the Serial buffer, covers a ~70ms loop pass at 475 SPS
+
 // EEPROM
 #define EEPROM_ENABLE
-#define EEPROM_CALIBRATION_ADDRESS 0x00
+// journal of the calibrations, newest valid one used at boot (see storage.h)
+// 56 records of 9 bytes: each slot is rewritten once every 56 calibrations
+// (39 records of 13 bytes with DUAL_CELL_ENABLE)
+#define EEPROM_CALIBRATION_ADDRESS 0x000
+#define EEPROM_CALIBRATION_SIZE    0x200 // bytes
+// log of the analyzed cylinders (BATCH_ENABLE), the oldest record is overwritten
+// 46 records of 11 bytes
+#define EEPROM_LOG_ADDRESS         0x200
+#define EEPROM_LOG_SIZE            0x200 // bytes
 
 #endif // _CONFIG_H_
\ No newline at end of file
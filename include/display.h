@@ -0,0 +1,48 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#ifndef _DISPLAY_H_
+#define _DISPLAY_H_
+
+#include <U8g2lib.h>
+
+// Screen regions, as masks of the 8 pixel high SH1106 pages (tile rows)
+#define REGION_HEADER   0x03 // y 0..15: title and battery badge
+#define REGION_DIGITS   0x3C // y 16..47: big readout (logisoso30, baseline 48)
+#define REGION_FOOTER   0xC0 // y 48..63: MOD / sensor line, menu buttons
+#define REGION_ALL      0xFF
+
+#ifdef TWI_QUEUE
+
+// I2C transfers that can be queued before rendering has to wait
+// each costs 44 bytes of RAM: a TwiTransaction (12 bytes on AVR) and 32 of data
+#define DISPLAY_TWI_SLOTS 6
+
+/**
+ * u8x8 byte callback for I2C displays, going through the TWI queue
+ * 
+ * Each transfer (command or data chunk) is copied to a slot and queued,
+ * so rendering of the next page can start while the bus sends this one.
+ * Rendering only waits when all slots are in flight.
+ */
+uint8_t u8x8_byte_twi_queue(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr);
+
+class U8G2_SH1106_128X64_NONAME_2_TWIQ : public U8G2 {
+public:
+	U8G2_SH1106_128X64_NONAME_2_TWIQ(const u8g2_cb_t* rotation) : U8G2() {
+		u8g2_Setup_sh1106_i2c_128x64_noname_2(&u8g2, rotation, u8x8_byte_twi_queue, u8x8_gpio_and_delay_arduino);
+	}
+};
+
+#endif // TWI_QUEUE
+
+#endif // _DISPLAY_H_
@@ -0,0 +1,78 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#ifndef _ESTIMATOR_H_
+#define _ESTIMATOR_H_
+
+#include <stdint.h>
+
+/**
+ * Final value of a first order (exponential) response
+ * 
+ * Galvanic cells approach a new O2 fraction as y(t) = F + (y0 - F).e^(-t/tau).
+ * With three readings y0, y1, y2 taken T apart, a = e^(-T/tau) and
+ *     F = y2 + (y2 - y1).G   with G = a / (1 - a)
+ * G is first derived from the configured time constant, then refined from
+ * the ratio (y2 - y1) / (y1 - y0) = a while the change is large enough for
+ * it to be meaningful.
+ * 
+ * No floats: G is Q8, a is Q15.
+ */
+class ExponentialEstimator {
+public:
+	/**
+	 * @param span readings between the 3 points of the fit (T = span x update period)
+	 * @param period ms between two update() calls
+	 * @param timeConstant cell time constant, ms
+	 */
+	ExponentialEstimator(uint8_t span, uint16_t period, uint16_t timeConstant);
+
+	// forget the readings, keep the learned time constant
+	void reset();
+
+	void update(int16_t value);
+
+	int16_t getPrediction() const { return prediction; }
+
+	/**
+	 * How much the last predictions agree
+	 * @return 0 (none, or not enough readings) to 3
+	 */
+	uint8_t getConfidence() const;
+
+	/**
+	 * @return learned time constant, ms
+	 */
+	uint16_t getTimeConstant() const;
+
+	static const uint8_t MAX_SPAN = 8;
+
+private:
+	int16_t reading(uint8_t age) const;
+
+	uint8_t span;
+	uint16_t period;
+	uint16_t gain;        // G, Q8
+	uint16_t minGain;
+	uint16_t maxGain;
+
+	int16_t history[2 * MAX_SPAN + 1];
+	uint8_t index;
+	uint8_t count;
+
+	int16_t prediction;
+	int16_t predictions[4];
+	uint8_t predictionIndex;
+	uint8_t predictionCount;
+};
+
+#endif // _ESTIMATOR_H_
@@ -0,0 +1,59 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#ifndef _FORMAT_H_
+#define _FORMAT_H_
+
+#include <Arduino.h>
+
+/**
+ * Display string formatting, without printf
+ *
+ * Every function writes at the given position of a caller provided buffer,
+ * NUL terminates it and returns the position of the NUL, so calls chain:
+ *   char* p = formatText(buffer, F("MOD "));
+ *   p = formatFixed<0>(p, 33);
+ *   formatChar(p, 'm');
+ * There is no bounds checking, the buffer must fit the longest string.
+ */
+
+/**
+ * Append a fixed-point number
+ *
+ * @param value in 10^-decimals units, e.g. 2095 with 2 decimals -> "20.95"
+ * @param decimals 0 to 4
+ * @param minDigits minimum number of integer digits, zero padded
+ */
+char* formatFixedPoint(char* buffer, int16_t value, uint8_t decimals, uint8_t minDigits);
+
+/**
+ * Append a fixed-point number, decimal places known at compile time
+ * e.g. formatFixed<1>(buffer, 14) -> "1.4"
+ */
+template <uint8_t DECIMALS>
+inline char* formatFixed(char* buffer, int16_t value, uint8_t minDigits = 1)
+{
+	static_assert(DECIMALS <= 4, "int16_t has 5 digits");
+	return formatFixedPoint(buffer, value, DECIMALS, minDigits);
+}
+
+/**
+ * Append a string stored in flash
+ */
+char* formatText(char* buffer, const __FlashStringHelper* text);
+
+/**
+ * Append a character
+ */
+char* formatChar(char* buffer, char c);
+
+#endif // _FORMAT_H_
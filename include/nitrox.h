@@ -15,17 +15,57 @@
 
 #include <stdint.h>
 
+/**
+ * Gas calculations, with integer units to keep precision and avoid floats:
+ * - oxygen fraction in 0.01%, e.g. 20,95% -> fO2 = 2095
+ * - partial pressure in mbar, e.g. 1,6bar -> pO2 = 1600
+ * - depth in cm of sea water, 10m = 1bar
+ *
+ * There is no runtime division: divisions by the O2 fraction or by the
+ * absolute pressure go through reciprocal tables built at compile time and
+ * stored in flash, with linear interpolation between entries. Results are
+ * rounded, within 1 unit of the exact formula over the whole input range
+ * (MOD: 2 units for pO2 limits above 2400 mbar, EAD: 2 units deeper than
+ * 200m), see test/test_nitrox.
+ */
+
 /**
  * Calculate MOD, given O2 fraction and O2 max partial pressure
  *
- * To keep precision and avoid using floats, units are not SI
- * 
  * @param fO2 oxygen fraction in 0.01%
- *            e.g. 20,95% -> fO2 = 2095
- * @param pO2_max max allowed oxygen partial pressure, in mbar
- *                e.g. 1,6bar -> pO2_max = 1600
- * @return MOD in cm
+ * @param pO2_max max allowed oxygen partial pressure, in mbar, up to 3000
+ * @return MOD in cm, 0 if the mix is not breathable at the surface
+ *         UINT16_MAX if fO2 = 0 or deeper than 655.35m
  */
 uint16_t calc_mod(uint16_t fO2, uint16_t pO2_max = 1600u);
 
-#endif // _NITROX_H_
\ No newline at end of file
+/**
+ * Calculate EAD (equivalent air depth), the depth at which air has the
+ * same nitrogen partial pressure as the mix at the given depth
+ *
+ * @param fO2 oxygen fraction in 0.01%
+ * @param depth in cm
+ * @return EAD in cm, 0 if shallower than the surface, at most UINT16_MAX
+ */
+uint16_t calc_ead(uint16_t fO2, uint16_t depth);
+
+/**
+ * Calculate the best mix for a target depth, the richest one which does
+ * not exceed the O2 max partial pressure at that depth
+ *
+ * @param depth in cm
+ * @param pO2_max max allowed oxygen partial pressure, in mbar, up to 3000
+ * @return O2 fraction in 0.01%, at most 10000
+ */
+uint16_t calc_best_mix(uint16_t depth, uint16_t pO2_max = 1400u);
+
+/**
+ * Calculate the O2 partial pressure at a given depth
+ *
+ * @param fO2 oxygen fraction in 0.01%
+ * @param depth in cm
+ * @return pO2 in mbar
+ */
+uint16_t calc_po2(uint16_t fO2, uint16_t depth);
+
+#endif // _NITROX_H_
@@ -0,0 +1,43 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#ifndef _POWER_H_
+#define _POWER_H_
+
+/**
+ * CPU sleep between two scheduled tasks (POWER_ENABLE)
+ * 
+ * powerSleep() idles the CPU until the next interrupt: timer 0 (millis(),
+ * every 2 ms at 8 MHz), an encoder or button edge, ALERT/RDY of the
+ * ADS1115, the end of a TWI or UART byte. loop() runs once per wake-up and
+ * sleeps again if no task is due. Idle mode keeps every peripheral
+ * clocked, millis(), the bus, the UART and the buzzer work as usual:
+ * power-save mode would stop timer 0, millis() and with it the scheduler.
+ */
+
+/**
+ * Turn off the unused peripherals
+ */
+void powerBegin();
+
+/**
+ * Sleep until the next interrupt
+ */
+void powerSleep();
+
+/**
+ * Hardware port, power.cpp provides the AVR one
+ */
+void powerPortBegin();
+void powerPortSleep();
+
+#endif // _POWER_H_
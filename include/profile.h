@@ -0,0 +1,77 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <Arduino.h>
+
+/**
+ * Execution time of code sections, built with -D PROFILE
+ *
+ * PROFILE_SCOPE(section) at the top of a block times it with micros() until
+ * the end of the block (8 µs resolution at 8 MHz). Without PROFILE it
+ * expands to nothing.
+ *
+ * Each section keeps min / max / mean and a histogram with log2 buckets:
+ * bucket i counts durations in [2^i, 2^(i+1)) µs, bucket 0 also counts 0.
+ * Durations are clamped to 65535 µs, histogram buckets saturate at 65535.
+ */
+
+enum profile_section_t {
+	PROFILE_LOOP,           // one loop() pass
+	PROFILE_RENDER,         // renderDisplay()
+	PROFILE_ADS_READ,       // reading a conversion result
+	PROFILE_BATTERY,        // battery conversion start, sleeps through it when idle
+	PROFILE_ENCODER_ISR,    // encoderIsr(), an A / B edge
+	PROFILE_SECTIONS
+};
+
+#ifdef PROFILE
+
+#define PROFILE_BUCKETS 16
+
+struct ProfileStats {
+	uint32_t count;
+	uint16_t min;                         // µs
+	uint16_t max;                         // µs
+	uint32_t total;                       // µs
+	uint16_t histogram[PROFILE_BUCKETS];
+};
+
+void profileRecord(uint8_t section, uint16_t duration);
+void profileGet(uint8_t section, ProfileStats* stats);
+void profileDump(Print& out);
+
+class ProfileScope {
+public:
+	ProfileScope(uint8_t section) : section(section), start(micros()) {}
+	~ProfileScope()
+	{
+		uint32_t duration = micros() - start;
+		profileRecord(section, duration > UINT16_MAX ? UINT16_MAX : duration);
+	}
+
+private:
+	uint8_t section;
+	uint32_t start;
+};
+
+#define PROFILE_SCOPE(section) ProfileScope profileScope(section)
+
+#else
+
+#define PROFILE_SCOPE(section)
+
+#endif // PROFILE
+
+#endif // _PROFILE_H_
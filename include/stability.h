@@ -0,0 +1,64 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#ifndef _STABILITY_H_
+#define _STABILITY_H_
+
+#include <stdint.h>
+
+/**
+ * Tells when a reading has settled
+ * 
+ * A reading is stable once it stayed within +/- tolerance of the value it
+ * had at the start of the period for the whole settle time, while:
+ * - its average slope over that period is below maxSlope (the cell is not
+ *   still slowly approaching the final value)
+ * - the spread of the averaged samples is below maxSpread (noisy cell)
+ * Any violation restarts the period from the current value.
+ */
+class StabilityDetector {
+public:
+	/**
+	 * @param tolerance in the unit of the readings
+	 * @param settleTime ms
+	 * @param maxSlope in the unit of the readings per minute
+	 * @param maxSpread in the unit of the readings
+	 */
+	StabilityDetector(int16_t tolerance, uint16_t settleTime, int16_t maxSlope, uint16_t maxSpread);
+
+	void reset();
+
+	/**
+	 * Feed a new reading
+	 * 
+	 * @param value reading
+	 * @param spread standard deviation of the samples behind the reading
+	 * @param now ms
+	 * @return true if the reading is stable
+	 */
+	bool update(int16_t value, uint16_t spread, uint32_t now);
+
+	bool isStable() const { return stable; }
+
+private:
+	int16_t tolerance;
+	uint16_t settleTime;
+	int16_t maxSlope;
+	uint16_t maxSpread;
+
+	bool started;
+	bool stable;
+	int16_t reference;
+	uint32_t since;
+};
+
+#endif // _STABILITY_H_
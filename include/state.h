@@ -13,6 +13,8 @@
 #ifndef _STATE_H_
 #define _STATE_H_
 
+#include <stdint.h>
+
 enum state_t {
 	STATE_START_SCREEN,
 	STATE_ANALYZE,
@@ -20,8 +22,89 @@ enum state_t {
 	STATE_CALIBRATE_MENU,
 	STATE_CALIBRATE,
 	STATE_ERROR,
+	STATE_COUNT,
+};
+
+// inputs of the UI state machine
+enum event_t {
+	EVENT_CLICKED,
+	EVENT_HELD,
+	EVENT_DOUBLE_CLICKED,
+	EVENT_ENCODER_UP,
+	EVENT_ENCODER_DOWN,
+	EVENT_TIMER,                // timer of the state expired (splash, calibration check)
+	EVENT_REFRESH,              // time to refresh the readout
+	EVENT_SAMPLE,               // new ADC sample
+	EVENT_STABLE,               // the reading settled (auto hold)
+	EVENT_CONFIRM,              // dialog answered YES
+	EVENT_CANCEL,               // dialog answered NO
+	EVENT_CALIBRATION_DONE,
+	EVENT_CALIBRATION_FAILED,
+	EVENT_UNCALIBRATED,         // no valid calibration at power up
+	EVENT_GAS_CHANGED,          // the ADC comparator saw the held reading change (WATCH_ENABLE)
+	EVENT_COUNT,
+	EVENT_NONE = EVENT_COUNT,
 };
 
+/**
+ * UI state machine, see state.cpp
+ *
+ * A transition table indexed by [state][event], in flash. Each entry holds
+ * the next state (or STAY), the regions it can change and an action, which
+ * may return a follow-up event. States have entry and exit hooks.
+ */
+typedef event_t (*action_t)(void);
+
+struct transition_t {
+	uint8_t next;       // state_t, or STAY
+	uint8_t redraw;     // regions the transition can change, 0: nothing to draw, no render
+	action_t action;    // can be NULL
+};
+
+#define STAY 0xFF
+
+extern state_t state;
+
+/**
+ * Process an event, and the ones the actions chain to it
+ * Constant time lookup, the table is in flash
+ */
+void dispatch(event_t event);
+
+// entry of the transition table
+transition_t getTransition(state_t from, event_t event);
+
+// state entry / exit hooks, in main.cpp
+void enterAnalyze();
+void enterHold();
+void enterCalibrateMenu();
+void enterCalibrate();
+void exitCalibrate();
+void enterError();
+
+// transition actions, in main.cpp
+event_t beepSplash();
+event_t beepClick();
+event_t nextModDisplay();
+event_t previousModDisplay();
+event_t refreshFooter();
+event_t refreshReading();
+event_t autoHold();
+event_t predictSample();
+event_t printDebug();       // DEBUG or PROFILE
+event_t dumpLog();          // BATCH_ENABLE without TELEMETRY_ENABLE
+event_t selectNext();
+event_t selectPrevious();
+event_t answerDialog();
+event_t calibrationSample();
+event_t checkCalibration();
+event_t saveCalibration();
+event_t reportCalibrationFailure();
+
+// called by dispatch(), in main.cpp
+void requestRender();
+void wakeDisplay();
+
 enum state_ppo2_t {
 	PPO2_1_4,
 	PPO2_1_5,
@@ -34,8 +117,10 @@ enum state_ppo2_t {
 inline state_ppo2_t operator++(state_ppo2_t &p, int)  {  return p = state_ppo2_t((p == PPO2_ENUM_MAX - 1) ? 0 : (p + 1));  }  
 inline state_ppo2_t operator--(state_ppo2_t &p, int)  {  return p = state_ppo2_t((p == 0) ? (PPO2_ENUM_MAX - 1) : (p - 1));  }  
 
+// choices of the calibration menu, left to right
 enum state_dialog_t {
-	YES,
+	YES_AIR,
+	YES_O2,
 	NO,
 };
 
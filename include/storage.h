@@ -0,0 +1,87 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#ifndef _STORAGE_H_
+#define _STORAGE_H_
+
+#include <Arduino.h>
+
+#include "acquisition.h"
+#include "calibration.h"
+#include "config.h"
+
+/**
+ * Calibrations kept in EEPROM
+ * 
+ * Each calibration is appended to a wear-levelled, CRC protected journal
+ * (lib/EepromJournal) at EEPROM_CALIBRATION_ADDRESS. At boot the newest
+ * valid record is used: one interrupted by a power loss is ignored, and
+ * the previous calibration is kept.
+ * With DUAL_CELL_ENABLE the record holds both cells and the slots are
+ * larger: recalibrate after switching between single and dual cell builds.
+ * 
+ * With BATCH_ENABLE, the analyzed cylinders go to a second journal at
+ * EEPROM_LOG_ADDRESS: a ring of the last records, numbered by the
+ * sequence number of the journal (the cylinder number).
+ */
+
+struct calibration_record_t {
+	calibration_model_t model[CELL_COUNT];
+	uint16_t noise;       // std dev of the samples of the noisiest cell at the last calibration, nV
+};
+
+struct analysis_record_t {
+	uint16_t concentration; // 0.01 % O2
+	uint16_t mod;           // cm, at pO2 1.4
+	int16_t cellVoltage;    // first cell, 0.01 mV
+	uint16_t uptime;        // s since boot, wraps after 18 h
+};
+
+#ifdef EEPROM_ENABLE
+
+/**
+ * Find the last calibration, once at boot
+ * 
+ * @return false if the journal is empty or corrupt
+ */
+bool storageLoadCalibration(calibration_record_t* record);
+
+void storageSaveCalibration(const calibration_record_t* record);
+
+#ifdef BATCH_ENABLE
+
+/**
+ * Find the last analysis, once at boot
+ * 
+ * @return number of records in the log
+ */
+uint8_t storageBeginLog();
+
+/**
+ * Append an analysis, the oldest one is overwritten once the log is full
+ * Blocks for ~3.4 ms per byte that changes, ~40 ms
+ * 
+ * @return its cylinder number
+ */
+uint16_t storageLogAnalysis(const analysis_record_t* record);
+
+/**
+ * Write the whole log as CSV, oldest first
+ * Blocks until the last line is in the Serial buffer
+ */
+void storageDumpLog(Print& out);
+
+#endif // BATCH_ENABLE
+
+#endif // EEPROM_ENABLE
+
+#endif // _STORAGE_H_
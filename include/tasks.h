@@ -0,0 +1,32 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#ifndef _TASKS_H_
+#define _TASKS_H_
+
+#include <Scheduler.h>
+
+// scheduled tasks, index in the task table of main.cpp
+enum task_id_t {
+	TASK_SAMPLING,      // periodic: collect ADC samples
+	TASK_BATTERY,       // periodic: measure the battery
+	TASK_SPLASH,        // one-shot: leave the start screen
+	TASK_REFRESH,       // periodic: compute the O2 reading to display
+	TASK_CALIBRATION,   // periodic while calibrating
+	TASK_RENDER,        // one-shot: redraw the screen
+	TASK_DIM,           // one-shot: dim the display after DISPLAY_DIM_DELAY
+	TASK_COUNT
+};
+
+extern Scheduler scheduler;
+
+#endif // _TASKS_H_
@@ -0,0 +1,79 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <stdint.h>
+
+#include "config.h"
+
+/**
+ * Binary sample stream on Serial, built with -D TELEMETRY_ENABLE
+ * Decoded on the host by tools/telemetry.py
+ *
+ * Frame, before encoding:
+ *   type   uint8
+ *   seq    uint8, +1 for every frame, dropped ones included
+ *   payload
+ *   crc    uint16, CRC-16/XMODEM of type..payload
+ * Multi-byte values are little endian. Each frame is COBS encoded and
+ * followed by a 0x00 delimiter, so the host resynchronizes on the next one
+ * after a corrupted or lost byte.
+ *
+ * Frames are encoded into a ring buffer, from interrupts or the main loop;
+ * telemetryFlush() moves what fits into the Serial transmit buffer and never
+ * waits for the UART. When the ring is full the frame is dropped: its
+ * sequence number is skipped and the drop counter incremented.
+ */
+
+#define TELEMETRY_RAW     0x01  // int16 conversion result, 7.8125 µV/count (PGA 16)
+#define TELEMETRY_STATUS  0x02  // see telemetryStatus()
+
+#ifdef TELEMETRY_ENABLE
+
+void telemetryBegin();
+
+/**
+ * Queue a conversion result, before any averaging
+ * Safe to call from an interrupt
+ */
+void telemetryRaw(int16_t conversion);
+
+/**
+ * Queue the processed values, once per averaged sample
+ * 
+ * @param average rolling average, nvPerCount nV per count
+ * @param fO2 0.01 %
+ * @param gain calibration gain, 0.01 % per count, Q14
+ * @param offset calibration offset, counts
+ * @param battery mV
+ * @param state state_t
+ * @param nvPerCount resolution of average
+ * Also carries the drop counter.
+ */
+void telemetryStatus(int16_t average, int16_t fO2, uint16_t gain, int16_t offset, int16_t battery,
+	uint8_t state, uint16_t nvPerCount);
+
+/**
+ * Send what the Serial transmit buffer can take, to be called from loop()
+ */
+void telemetryFlush();
+
+/**
+ * Frames lost because the ring was full, since power-up
+ */
+uint16_t telemetryDropped();
+
+#endif // TELEMETRY_ENABLE
+
+#endif // _TELEMETRY_H_
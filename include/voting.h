@@ -0,0 +1,73 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#ifndef _VOTING_H_
+#define _VOTING_H_
+
+#include <stdint.h>
+
+#define VOTING_MAX_CELLS 3
+
+/**
+ * Cross-checks the readings of several O2 cells
+ * 
+ * A cell disagrees when it is more than tolerance away from the median of
+ * the cells. With two cells the median is their mean: both disagree, there
+ * is no telling which one is wrong. With three, the odd one out is found.
+ * 
+ * The reading is the mean of the cells that agree, or with two cells that
+ * disagree the highest one: the shallowest MOD. The cells only become
+ * suspect once they disagreed for the whole persistence time, so that two
+ * cells settling at slightly different speeds after a gas change are not
+ * flagged.
+ */
+class CellVoter {
+public:
+	/**
+	 * @param cells 1 to VOTING_MAX_CELLS
+	 * @param tolerance in the unit of the readings
+	 * @param persistence ms
+	 */
+	CellVoter(uint8_t cells, int16_t tolerance, uint16_t persistence);
+
+	void reset();
+
+	/**
+	 * Feed the readings of all the cells
+	 * 
+	 * @param values one per cell
+	 * @param now ms
+	 * @return the voted reading
+	 */
+	int16_t update(const int16_t* values, uint32_t now);
+
+	/**
+	 * The voted reading alone, the flags are left as they are
+	 */
+	int16_t combine(const int16_t* values) const;
+
+	// bit i set: cell i disagreed for the persistence time
+	uint8_t getSuspects() const { return suspects; }
+
+private:
+	int16_t vote(const int16_t* values, uint8_t* outliers) const;
+
+	uint8_t cells;
+	int16_t tolerance;
+	uint16_t persistence;
+
+	uint8_t disagreeing;
+	uint8_t suspects;
+	uint32_t since;
+};
+
+#endif // _VOTING_H_
@@ -16,40 +16,25 @@
 #include "ADS1115.h"
 
 #include <Arduino.h>
+#include <util/atomic.h>
+#ifdef TWI_QUEUE
+#include <TwiQueue.h>
+#else
 #include <Wire.h>
+#endif
 
 #define ADS1115_CONFIG_EMPTY 0x0000
-
-/**
- *  Write 16-bits to the specified destination register
- */
-static void writeRegister(uint8_t address, uint8_t reg, uint16_t value)
-{
-	Wire.beginTransmission(address);
-	Wire.write(reg);
-	Wire.write((uint8_t)(value >> 8));
-	Wire.write((uint8_t)(value & 0xFF));
-	Wire.endTransmission();
-}
-
-/**
- * Read & return the specified 16-bits register
- */
-static uint16_t readRegister(uint8_t address, uint8_t reg)
-{
-	Wire.beginTransmission(address);
-	Wire.write(reg);
-	Wire.endTransmission();
-	Wire.requestFrom(address, (uint8_t)2);
-	return (((uint16_t)Wire.read() << 8) | Wire.read());
-}
+#define ADS1115_POINTER_UNKNOWN 0xFF
 
 /**
  * Constructor
  */
-ADS1115::ADS1115(uint8_t address = ADS1115_ADDRESS) :
+ADS1115::ADS1115(uint8_t address) :
 	address(address),
-	config(ADS1115_CONFIG_EMPTY)
+	config(ADS1115_CONFIG_EMPTY),
+	pointer(ADS1115_POINTER_UNKNOWN),
+	caching(false),
+	transactions(0)
 {
 	// this->address = address;
 	// this->config = ADS1115_CONFIG_EMPTY;
@@ -69,6 +54,12 @@ void ADS1115::begin()
  */
 bool ADS1115::isBusy()
 {
+	if (this->caching
+		&& (this->config & ADS1115_REG_CONFIG_MODE_MASK) == ADS1115_REG_CONFIG_MODE_CONTIN)
+	{
+		// continuous mode was set by this driver, no need to ask the device
+		return false;
+	}
 	(void) this->readConfig();
 	if ((this->config & ADS1115_REG_CONFIG_MODE_MASK) != 0
 		&& !((this->config & ADS1115_REG_CONFIG_OS_MASK) != 0))
@@ -101,6 +92,19 @@ void ADS1115::startContinuousConversion()
 	this->writeConfig();
 }
 
+/**
+ * Leave the continuous conversion mode
+ * 
+ * The device powers down once the current conversion is over, until the
+ * next start*Conversion()
+ */
+void ADS1115::stopContinuousConversion()
+{
+	this->config |= ADS1115_REG_CONFIG_MODE_SINGLE;
+	this->config &= ~ADS1115_REG_CONFIG_OS_MASK; // don't start a conversion
+	this->writeConfig();
+}
+
 /**
  * Read & return the result of the last conversion
  * 
@@ -114,7 +118,104 @@ int16_t ADS1115::readLastConversion()
 	{
 		delay(1);
 	}
-	return (int16_t)readRegister(this->address, ADS1115_REG_POINTER_CONVERT);
+	return (int16_t)this->readRegister(ADS1115_REG_POINTER_CONVERT);
+}
+
+/**
+ * Read & return the CONVERSION register, without checking the busy state
+ * 
+ * To be used when the ALERT/RDY pin reported that a conversion is ready
+ */
+int16_t ADS1115::readConversion()
+{
+	return (int16_t)this->readRegister(ADS1115_REG_POINTER_CONVERT);
+}
+
+/**
+ * Use the ALERT/RDY pin as conversion-ready signal
+ * 
+ * Setting the MSB of Hi_thresh to 1 and the MSB of Lo_thresh to 0 turns the
+ * comparator into a conversion-ready output: in continuous mode the pin pulses
+ * for ~8µs at the end of each conversion, in single-shot mode it stays asserted
+ * until the next conversion is started.
+ * Takes effect on the next writeConfig() / start*Conversion()
+ */
+void ADS1115::enableConversionReady()
+{
+	this->writeRegister(ADS1115_REG_POINTER_LOWTHRESH, 0x0000);
+	this->writeRegister(ADS1115_REG_POINTER_HITHRESH, 0x8000);
+	// active low, non-latching, in case the window comparator was used
+	this->config &= ~(ADS1115_REG_CONFIG_CMODE_MASK | ADS1115_REG_CONFIG_CPOL_MASK
+		| ADS1115_REG_CONFIG_CLAT_MASK | ADS1115_REG_CONFIG_CQUE_MASK);
+	this->config |= ADS1115_REG_CONFIG_CQUE_1CONV;
+}
+
+/**
+ * Use the ALERT/RDY pin as window comparator output (active low)
+ * 
+ * The pin asserts once queue conversions in a row are above high or below
+ * low. Latching: it stays asserted until the CONVERSION register is read,
+ * a single edge whatever the signal does next. Non-latching: it follows
+ * the signal, and deasserts as soon as a conversion is back in the window.
+ * Thresholds are in counts at the current gain, see microVoltsToCounts().
+ * Takes effect on the next writeConfig() / start*Conversion()
+ */
+void ADS1115::enableWindowComparator(int16_t low, int16_t high, adsComparatorQueue_t queue, bool latching)
+{
+	this->setThresholds(low, high);
+	this->config &= ~(ADS1115_REG_CONFIG_CMODE_MASK | ADS1115_REG_CONFIG_CPOL_MASK
+		| ADS1115_REG_CONFIG_CLAT_MASK | ADS1115_REG_CONFIG_CQUE_MASK);
+	this->config |= ADS1115_REG_CONFIG_CMODE_WINDOW | ADS1115_REG_CONFIG_CPOL_ACTVLOW
+		| (latching ? ADS1115_REG_CONFIG_CLAT_LATCH : ADS1115_REG_CONFIG_CLAT_NONLAT)
+		| (uint16_t)queue;
+}
+
+/**
+ * Write the comparator thresholds, in counts (low <= high)
+ * 
+ * Takes effect right away, e.g. to move the window of a running comparator
+ */
+void ADS1115::setThresholds(int16_t low, int16_t high)
+{
+	this->writeRegister(ADS1115_REG_POINTER_LOWTHRESH, (uint16_t)low);
+	this->writeRegister(ADS1115_REG_POINTER_HITHRESH, (uint16_t)high);
+}
+
+/**
+ * Disable the comparator, ALERT/RDY pin goes high-impedance
+ * 
+ * Takes effect on the next writeConfig() / start*Conversion()
+ */
+void ADS1115::disableComparator()
+{
+	this->config |= ADS1115_REG_CONFIG_CQUE_NONE;
+}
+
+// full scale range = 256 mV x FSR_UNITS[PGA bits], 6.144 V is 24 x 256 mV
+static const uint8_t FSR_UNITS[8] = {24, 16, 8, 4, 2, 1, 1, 1};
+
+/**
+ * Convert a voltage to counts at the current gain, saturated to the range
+ * 
+ * One count is FSR / 32768, FSR = 256 mV x n: counts = µV x 16 / (125 x n)
+ * Stays within 32 bits up to the 6.144 V range
+ */
+int16_t ADS1115::microVoltsToCounts(int32_t microVolts)
+{
+	uint8_t n = FSR_UNITS[(this->config & ADS1115_REG_CONFIG_PGA_MASK) >> 9];
+	int32_t limit = 256000L * n;
+	if (microVolts >= limit) return INT16_MAX;
+	if (microVolts <= -limit) return INT16_MIN;
+	return (int16_t)(microVolts * 16 / (125L * n));
+}
+
+/**
+ * Convert counts at the current gain to a voltage, µV
+ */
+int32_t ADS1115::countsToMicroVolts(int16_t counts)
+{
+	uint8_t n = FSR_UNITS[(this->config & ADS1115_REG_CONFIG_PGA_MASK) >> 9];
+	return (int32_t)counts * (125L * n) / 16;
 }
 
 /**
@@ -173,13 +274,13 @@ adsMux_t ADS1115::getMux(void)
  */
 void ADS1115::writeConfig()
 {
-	writeRegister(this->address, ADS1115_REG_POINTER_CONFIG, this->config);
+	this->writeRegister(ADS1115_REG_POINTER_CONFIG, this->config);
 }
 
 void ADS1115::writeConfig(uint16_t config)
 {
 	this->config = config;
-	writeRegister(this->address, ADS1115_REG_POINTER_CONFIG, this->config);
+	this->writeRegister(ADS1115_REG_POINTER_CONFIG, this->config);
 }
 
 /**
@@ -187,6 +288,217 @@ void ADS1115::writeConfig(uint16_t config)
  */
 uint16_t ADS1115::readConfig()
 {
-	this->config = readRegister(this->address, ADS1115_REG_POINTER_CONFIG);
+	this->config = this->readRegister(ADS1115_REG_POINTER_CONFIG);
 	return this->config;
 }
+
+/**
+ * Enable/disable register caching
+ * 
+ * When enabled, the pointer register is only written when it does not
+ * already target the register to read, and isBusy() trusts the MODE bit of
+ * the cached configuration instead of reading CONFIG.
+ * A continuous mode sample then costs a single I2C read transaction.
+ * 
+ * WARNING: only valid if nothing else talks to the device
+ * (no other master, no general call reset)
+ */
+void ADS1115::setCaching(bool enable)
+{
+	this->caching = enable;
+	this->pointer = ADS1115_POINTER_UNKNOWN;
+}
+
+/**
+ * Number of I2C transactions (address + data, START to STOP) since last reset
+ */
+uint32_t ADS1115::getTransactionCount(void)
+{
+	uint32_t count;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		count = this->transactions;
+	}
+	return count;
+}
+
+void ADS1115::resetTransactionCount(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		this->transactions = 0;
+	}
+}
+
+/**
+ * Before a blocking register access: the cached pointer is unknown until
+ * it is over, a read queued meanwhile by an interrupt writes it again
+ * (it may run before or after this access).
+ * Returns the cached pointer.
+ */
+uint8_t ADS1115::beginAccess(void)
+{
+	uint8_t current;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		current = this->pointer;
+		this->pointer = ADS1115_POINTER_UNKNOWN;
+		this->transactions++;
+	}
+	return current;
+}
+
+/**
+ * After a blocking register access to reg: the device points to it,
+ * unless a queued read may have moved it in the meantime
+ */
+void ADS1115::endAccess(uint8_t reg)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (this->pointer == ADS1115_POINTER_UNKNOWN) this->pointer = reg;
+		else this->pointer = ADS1115_POINTER_UNKNOWN;
+	}
+}
+
+/**
+ *  Write 16-bits to the specified destination register
+ */
+void ADS1115::writeRegister(uint8_t reg, uint16_t value)
+{
+	(void) this->beginAccess();
+#ifdef TWI_QUEUE
+	uint8_t data[3] = {reg, (uint8_t)(value >> 8), (uint8_t)(value & 0xFF)};
+	twiQueue.transfer(this->address, data, sizeof(data));
+#else
+	Wire.beginTransmission(this->address);
+	Wire.write(reg);
+	Wire.write((uint8_t)(value >> 8));
+	Wire.write((uint8_t)(value & 0xFF));
+	Wire.endTransmission();
+#endif
+	this->endAccess(reg);
+}
+
+/**
+ * Read & return the specified 16-bits register
+ */
+uint16_t ADS1115::readRegister(uint8_t reg)
+{
+#ifdef TWI_QUEUE
+	// pointer write and read in a single transaction (repeated START)
+	uint8_t data[2];
+	uint8_t current = this->beginAccess();
+	bool setPointer = !this->caching || current != reg;
+	twiQueue.transfer(this->address, &reg, setPointer ? 1 : 0, data, sizeof(data));
+	this->endAccess(reg);
+	return (((uint16_t)data[0] << 8) | data[1]);
+#else
+	uint8_t current = this->beginAccess();
+	if (!this->caching || current != reg) {
+		Wire.beginTransmission(this->address);
+		Wire.write(reg);
+		Wire.endTransmission();
+		this->transactions++; // no queued reads without TWI_QUEUE
+	}
+	Wire.requestFrom(this->address, (uint8_t)2);
+	this->endAccess(reg);
+	return (((uint16_t)Wire.read() << 8) | Wire.read());
+#endif
+}
+
+#ifdef TWI_QUEUE
+static const uint8_t pointerConvert = ADS1115_REG_POINTER_CONVERT;
+
+/**
+ * Queue a read of the CONVERSION register on the shared TWI queue
+ * 
+ * Safe to call from an interrupt (e.g. ALERT/RDY), also during a register
+ * access of the main code: the pointer is written again then, see
+ * beginAccess(). t->readData must point to 2 bytes,
+ * get the result with conversionResult(t) once t->status == TWIQ_DONE.
+ * Returns false if the previous read with this descriptor is still pending.
+ */
+bool ADS1115::queueReadConversion(TwiTransaction* t, bool urgent)
+{
+	if (t->status == TWIQ_PENDING) return false;
+	t->address = this->address;
+	t->writeData = &pointerConvert;
+	t->writeLength = (this->caching && this->pointer == ADS1115_REG_POINTER_CONVERT) ? 0 : 1;
+	t->readLength = 2;
+	this->pointer = ADS1115_REG_POINTER_CONVERT;
+	this->transactions++;
+	return twiQueue.submit(t, urgent);
+}
+
+/**
+ * Queue a write of the CONFIG register, e.g. after setMux() from an interrupt
+ * 
+ * Same rules as queueReadConversion(), but the main code must not change the
+ * configuration at the same time. data must point to 3 bytes that stay
+ * valid until t->status != TWIQ_PENDING, they are filled from the cached
+ * configuration. In continuous mode, the conversion in progress completes
+ * with the previous settings: the next one is the first with the new ones.
+ * Returns false if the previous transfer with this descriptor is still pending.
+ */
+bool ADS1115::queueWriteConfig(TwiTransaction* t, uint8_t* data, bool urgent)
+{
+	if (t->status == TWIQ_PENDING) return false;
+	data[0] = ADS1115_REG_POINTER_CONFIG;
+	data[1] = (uint8_t)(this->config >> 8);
+	data[2] = (uint8_t)(this->config & 0xFF);
+	t->address = this->address;
+	t->writeData = data;
+	t->writeLength = 3;
+	t->readLength = 0;
+	this->pointer = ADS1115_REG_POINTER_CONFIG;
+	this->transactions++;
+	return twiQueue.submit(t, urgent);
+}
+
+int16_t ADS1115::conversionResult(const TwiTransaction* t)
+{
+	return (int16_t)(((uint16_t)t->readData[0] << 8) | t->readData[1]);
+}
+#endif
+
+
+ADS1115ReadyPulse::ADS1115ReadyPulse() :
+	lastLevel(HIGH),
+	riseCounted(false)
+{
+}
+
+/**
+ * Pin change of ALERT/RDY in conversion-ready mode, from the interrupt
+ * 
+ * The pin pulses low for ~8µs: both edges can be over when the interrupt
+ * reads it. A pulse is counted if the pin is low, or if it is still high
+ * after being high on the last call. The rising edge can also land after
+ * the vector was entered (which clears its flag) but before the read: the
+ * pulse is counted on a high level, and the edge raised the flag again.
+ * The call it causes is then not a new pulse.
+ * 
+ * @param level of the pin, read in the interrupt
+ * @param flagRaised the pin change flag of the vector, read after the pin
+ * @param otherPin true if another pin of the vector changed: only a new
+ * low level is a pulse then
+ * @return true once per pulse
+ */
+bool ADS1115ReadyPulse::update(uint8_t level, bool flagRaised, bool otherPin)
+{
+	bool pulse;
+	if (otherPin) pulse = level == LOW && lastLevel == HIGH;
+	else pulse = level == LOW || (lastLevel == HIGH && !riseCounted);
+	riseCounted = pulse && level == HIGH && flagRaised;
+	lastLevel = level;
+	return pulse;
+}
+
+/**
+ * Pin change of ALERT/RDY as latching comparator output: true on a new
+ * low level, a single falling edge
+ */
+bool ADS1115ReadyPulse::falling(uint8_t level)
+{
+	bool edge = level == LOW && lastLevel == HIGH;
+	riseCounted = false;
+	lastLevel = level;
+	return edge;
+}
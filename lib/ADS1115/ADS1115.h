@@ -21,9 +21,10 @@
  * - support for ADS1115 only
  * - allows continuous conversion mode
  * - explicit access functions for gain, sampling rate & mux
- * 
- * TODO:
- * - Comparator mode is not implemented
+ * - conversion-ready signal on the ALERT/RDY pin, pulses counted from a pin change interrupt
+ * - window comparator on the ALERT/RDY pin, thresholds in counts or µV
+ * - optional pointer/config caching, to save I2C transactions
+ * - asynchronous reads and CONFIG writes through TwiQueue, when built with TWI_QUEUE
  *
  ******************************************************************************/
 
@@ -31,6 +32,9 @@
 #define _ADS1115_H_
 
 #include <Arduino.h>
+#ifdef TWI_QUEUE
+#include <TwiQueue.h>
+#endif
 
 #define ADS1115_ADDRESS_GND             0x48    // 0b1001000 - ADDR = GND
 #define ADS1115_ADDRESS_VDD             0x49    // 0b1001001 - ADDR = VDD
@@ -138,6 +142,14 @@ typedef enum {
 } adsMux_t;
 
 
+// consecutive conversions out of the thresholds before ALERT/RDY asserts
+typedef enum {
+	COMP_QUEUE_1   = ADS1115_REG_CONFIG_CQUE_1CONV,
+	COMP_QUEUE_2   = ADS1115_REG_CONFIG_CQUE_2CONV,
+	COMP_QUEUE_4   = ADS1115_REG_CONFIG_CQUE_4CONV,
+} adsComparatorQueue_t;
+
+
 class ADS1115
 {
 public:
@@ -147,7 +159,16 @@ public:
 	bool      isBusy(void);
 	void      startSingleConversion(void);
 	void      startContinuousConversion(void);
+	void      stopContinuousConversion(void);
 	int16_t   readLastConversion(void);
+	int16_t   readConversion(void);
+	void      enableConversionReady(void);
+	void      enableWindowComparator(int16_t low, int16_t high,
+		adsComparatorQueue_t queue = COMP_QUEUE_1, bool latching = true);
+	void      setThresholds(int16_t low, int16_t high);
+	void      disableComparator(void);
+	int16_t   microVoltsToCounts(int32_t microVolts);
+	int32_t   countsToMicroVolts(int16_t counts);
 	void      setGain(adsGain_t gain);
 	adsGain_t getGain(void);
 	void      setDataRate(adsDataRate_t rate);
@@ -157,10 +178,42 @@ public:
 	void      writeConfig(void);
 	void      writeConfig(uint16_t config);
 	uint16_t  readConfig(void);
+	void      setCaching(bool enable);
+	uint32_t  getTransactionCount(void);
+	void      resetTransactionCount(void);
+#ifdef TWI_QUEUE
+	bool      queueReadConversion(TwiTransaction* t, bool urgent = true);
+	bool      queueWriteConfig(TwiTransaction* t, uint8_t* data, bool urgent = true);
+	static int16_t conversionResult(const TwiTransaction* t);
+#endif
 
 private:
+	void      writeRegister(uint8_t reg, uint16_t value);
+	uint16_t  readRegister(uint8_t reg);
+	uint8_t   beginAccess(void);
+	void      endAccess(uint8_t reg);
+
 	uint8_t   address;
 	uint16_t  config;
+	// also updated by queueRead*() from interrupts
+	volatile uint8_t  pointer;
+	bool      caching;
+	volatile uint32_t transactions;
+};
+
+
+// conversion-ready pulses of ALERT/RDY, from a pin change interrupt
+class ADS1115ReadyPulse
+{
+public:
+	ADS1115ReadyPulse(void);
+
+	bool      update(uint8_t level, bool flagRaised, bool otherPin);
+	bool      falling(uint8_t level);
+
+private:
+	uint8_t   lastLevel;
+	bool      riseCounted;
 };
 
 
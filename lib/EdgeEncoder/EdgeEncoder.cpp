@@ -0,0 +1,125 @@
+/**
+ * This file is part of
+ *
+ * EdgeEncoder
+ * Interrupt driven rotary encoder with push button
+ *
+ * MIT License
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include "EdgeEncoder.h"
+
+#include <util/atomic.h>
+
+// [previous A B][current A B] -> step, 0 for no or an invalid transition
+// clockwise: B falls first, A B = 11 -> 10 -> 00 -> 01 -> 11, as ClickEncoder
+static const int8_t QUADRATURE_STEPS[16] PROGMEM = {
+	 0,  1, -1,  0,
+	-1,  0,  0,  1,
+	 1,  0,  0, -1,
+	 0, -1,  1,  0,
+};
+
+EdgeEncoder::EdgeEncoder(uint8_t pinA, uint8_t pinB, uint8_t pinButton, uint8_t stepsPerNotch,
+	uint16_t debounceTime, uint16_t holdTime, uint16_t doubleClickTime) :
+	pinA(pinA),
+	pinB(pinB),
+	pinButton(pinButton),
+	stepsPerNotch(stepsPerNotch),
+	debounceTime(debounceTime),
+	holdTime(holdTime),
+	doubleClickTime(doubleClickTime),
+	quadrature(0x03),
+	steps(0),
+	rawPressed(false),
+	edgeTime(0),
+	pressed(false),
+	clickPending(false),
+	pressTime(0),
+	releaseTime(0),
+	button(Open)
+{
+}
+
+void EdgeEncoder::begin(void)
+{
+	pinMode(pinA, INPUT_PULLUP);
+	pinMode(pinB, INPUT_PULLUP);
+	pinMode(pinButton, INPUT_PULLUP);
+	quadrature = (digitalRead(pinA) == HIGH ? 0x02 : 0) | (digitalRead(pinB) == HIGH ? 0x01 : 0);
+	rawPressed = digitalRead(pinButton) == LOW;
+	pressed = rawPressed;
+}
+
+void EdgeEncoder::quadratureChange(void)
+{
+	uint8_t current = (digitalRead(pinA) == HIGH ? 0x02 : 0) | (digitalRead(pinB) == HIGH ? 0x01 : 0);
+	steps += (int8_t)pgm_read_byte(&QUADRATURE_STEPS[(quadrature << 2) | current]);
+	quadrature = current;
+}
+
+bool EdgeEncoder::buttonChange(void)
+{
+	bool level = digitalRead(pinButton) == LOW;
+	if (level == rawPressed) return false;
+	rawPressed = level;
+	edgeTime = (uint16_t)millis();
+	return true;
+}
+
+int16_t EdgeEncoder::getValue(void)
+{
+	int16_t notches;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		// the remainder stays, for the rest of the notch
+		notches = steps / stepsPerNotch;
+		steps -= notches * stepsPerNotch;
+	}
+	return notches;
+}
+
+EdgeEncoder::Button EdgeEncoder::getButton(void)
+{
+	bool level;
+	uint16_t edge;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		level = rawPressed;
+		edge = edgeTime;
+	}
+	uint16_t now = (uint16_t)millis();
+
+	if (level != pressed && (uint16_t)(now - edge) >= debounceTime) {
+		pressed = level;
+		if (pressed) {
+			pressTime = edge;
+		}
+		else if (button == Held) {
+			button = Released;
+		}
+		else if (clickPending) {
+			clickPending = false;
+			button = DoubleClicked;
+		}
+		else {
+			clickPending = true;
+			releaseTime = edge;
+		}
+	}
+	if (pressed && button != Held && (uint16_t)(now - pressTime) >= holdTime) {
+		clickPending = false;
+		button = Held;
+	}
+	if (clickPending && !pressed && (uint16_t)(now - releaseTime) >= doubleClickTime) {
+		clickPending = false;
+		button = Clicked;
+	}
+
+	Button b = button;
+	if (button != Held) {
+		button = Open;
+	}
+	return b;
+}
@@ -0,0 +1,96 @@
+/**
+ * EdgeEncoder
+ * Interrupt driven rotary encoder with push button
+ *
+ * MIT License
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ * Nothing runs while the knob is not touched: the sketch calls
+ * quadratureChange() from the interrupts of both edges of A and B (INT0 /
+ * INT1, or pin change), and buttonChange() from the pin change interrupt
+ * of the button.
+ *
+ * Each A / B edge is decoded by a quadrature state table. Transitions
+ * where both contacts changed (a missed edge) count for nothing, and the
+ * bounce of one contact cancels itself out, step after step back.
+ *
+ * The button interrupt only records the level with a timestamp, getButton()
+ * debounces it: a level counts once it has been stable for the debounce
+ * time. It must be called more often than the shortest press (~50 ms).
+ * Same events as ClickEncoder: Clicked once the double click time is over
+ * without a second click, DoubleClicked, Held for as long as the button is
+ * down past the hold time, then Released once.
+ */
+
+#ifndef _EDGE_ENCODER_H_
+#define _EDGE_ENCODER_H_
+
+#include <Arduino.h>
+
+class EdgeEncoder {
+public:
+	typedef enum Button_e {
+		Open = 0,
+		Closed,
+		Pressed,
+		Held,
+		Released,
+		Clicked,
+		DoubleClicked
+	} Button;
+
+	/**
+	 * Contacts to ground, with the internal pull-ups
+	 * Times in ms
+	 */
+	EdgeEncoder(uint8_t pinA, uint8_t pinB, uint8_t pinButton, uint8_t stepsPerNotch = 4,
+		uint16_t debounceTime = 5, uint16_t holdTime = 1200, uint16_t doubleClickTime = 600);
+
+	/**
+	 * Configure the pins, the sketch enables the interrupts
+	 */
+	void begin(void);
+
+	/**
+	 * From the interrupts
+	 * buttonChange() returns true if the button level changed, to tell it
+	 * from the other pins sharing a pin change vector
+	 */
+	void quadratureChange(void);
+	bool buttonChange(void);
+
+	/**
+	 * Notches turned since the last call, positive clockwise
+	 */
+	int16_t getValue(void);
+
+	/**
+	 * Last button event, Open if none
+	 */
+	Button getButton(void);
+
+private:
+	uint8_t pinA;
+	uint8_t pinB;
+	uint8_t pinButton;
+	uint8_t stepsPerNotch;
+	uint16_t debounceTime;
+	uint16_t holdTime;
+	uint16_t doubleClickTime;
+
+	// shared with the interrupts
+	volatile uint8_t quadrature;   // last A / B levels
+	volatile int16_t steps;
+	volatile bool rawPressed;
+	volatile uint16_t edgeTime;    // ms, last button edge
+
+	// debounced, main loop only
+	bool pressed;
+	bool clickPending;             // released once, waiting for a second click
+	uint16_t pressTime;
+	uint16_t releaseTime;
+	Button button;
+};
+
+#endif // _EDGE_ENCODER_H_
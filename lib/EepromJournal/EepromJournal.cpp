@@ -0,0 +1,137 @@
+/**
+ * This file is part of
+ *
+ * EepromJournal
+ * Wear-levelled journal of fixed size records in the AVR EEPROM
+ *
+ * MIT License
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include "EepromJournal.h"
+
+#include <EEPROM.h>
+#include <util/crc16.h>
+
+#define JOURNAL_ERASED    0xFFFF  // sequence number of an erased slot, never used
+#define JOURNAL_CRC_INIT  0xFF    // an all-zero slot is not valid either
+
+EepromJournal::EepromJournal(uint16_t start, uint16_t length, uint8_t payloadSize) :
+	start(start),
+	payloadSize(payloadSize),
+	slots(length / (payloadSize + 3) > 255 ? 255 : length / (payloadSize + 3)),
+	newest(0),
+	count(0),
+	sequence(0)
+{
+}
+
+uint16_t EepromJournal::address(uint8_t slot)
+{
+	return start + (uint16_t)slot * (payloadSize + 3);
+}
+
+/**
+ * Read a slot and check it
+ * payload can be NULL to only get the sequence number
+ */
+bool EepromJournal::readSlot(uint8_t slot, void* payload, uint16_t* seq)
+{
+	uint16_t a = address(slot);
+	uint8_t crc = JOURNAL_CRC_INIT;
+	uint8_t* p = (uint8_t*)payload;
+	for (uint8_t i = 0; i < payloadSize; i++) {
+		uint8_t b = EEPROM.read(a++);
+		crc = _crc8_ccitt_update(crc, b);
+		if (p != NULL) *p++ = b;
+	}
+	uint8_t lo = EEPROM.read(a++);
+	uint8_t hi = EEPROM.read(a++);
+	crc = _crc8_ccitt_update(crc, lo);
+	crc = _crc8_ccitt_update(crc, hi);
+	*seq = ((uint16_t)hi << 8) | lo;
+	return *seq != JOURNAL_ERASED && EEPROM.read(a) == crc;
+}
+
+/**
+ * Sequence number of the record appended age records before the one of seq,
+ * the erased value is skipped
+ */
+static uint16_t olderSequence(uint16_t seq, uint8_t age)
+{
+	return seq >= age ? seq - age : seq - age - 1;
+}
+
+/**
+ * Appends from the record of seq to the newest one, of newestSeq
+ */
+static uint16_t sequenceAge(uint16_t newestSeq, uint16_t seq)
+{
+	uint16_t age = newestSeq - seq;
+	return seq > newestSeq ? age - 1 : age;
+}
+
+uint8_t EepromJournal::begin(void)
+{
+	uint8_t valid = 0;
+	uint16_t oldest = 0;
+	for (uint8_t slot = 0; slot < slots; slot++) {
+		uint16_t seq;
+		if (!readSlot(slot, NULL, &seq)) continue;
+		// sequence numbers wrap, the valid ones are within a lap of each other
+		if (valid == 0 || (int16_t)(seq - sequence) > 0) {
+			newest = slot;
+			sequence = seq;
+		}
+		if (valid == 0 || (int16_t)(seq - oldest) < 0) {
+			oldest = seq;
+		}
+		valid++;
+	}
+	// from the oldest valid record to the newest, corrupt slots in between
+	// included. A record left a lap old by a torn write is past the end.
+	count = 0;
+	if (valid > 0) {
+		uint16_t span = sequenceAge(sequence, oldest) + 1;
+		count = span > slots ? slots : span;
+	}
+	return valid;
+}
+
+bool EepromJournal::read(void* payload, uint8_t age, uint16_t* seq)
+{
+	if (age >= count) return false;
+	uint8_t slot = newest >= age ? newest - age : newest + slots - age;
+	uint16_t slotSeq;
+	if (!readSlot(slot, payload, &slotSeq) || slotSeq != olderSequence(sequence, age)) return false;
+	if (seq != NULL) *seq = slotSeq;
+	return true;
+}
+
+void EepromJournal::append(const void* payload)
+{
+	uint8_t slot = 0;
+	uint16_t seq = 0;
+	if (count > 0) {
+		slot = newest + 1 < slots ? newest + 1 : 0;
+		seq = sequence + 1;
+		if (seq == JOURNAL_ERASED) seq = 0;
+	}
+	uint16_t a = address(slot);
+	uint8_t crc = JOURNAL_CRC_INIT;
+	const uint8_t* p = (const uint8_t*)payload;
+	for (uint8_t i = 0; i < payloadSize; i++) {
+		crc = _crc8_ccitt_update(crc, p[i]);
+		EEPROM.update(a++, p[i]);
+	}
+	crc = _crc8_ccitt_update(crc, seq & 0xFF);
+	crc = _crc8_ccitt_update(crc, seq >> 8);
+	EEPROM.update(a++, seq & 0xFF);
+	EEPROM.update(a++, seq >> 8);
+	EEPROM.update(a, crc);
+	newest = slot;
+	sequence = seq;
+	if (count < slots) count++;
+}
@@ -0,0 +1,79 @@
+/**
+ * EepromJournal
+ * Wear-levelled journal of fixed size records in the AVR EEPROM
+ *
+ * MIT License
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ * The journal owns a region of the EEPROM, split in slots. Each record is
+ * appended to the slot after the newest one, so every slot is rewritten
+ * once per lap and the wear is spread evenly over the region.
+ *
+ * Slot: payload, 16-bit sequence number, CRC-8 (CCITT) of both.
+ * The sequence number is written after the payload and the CRC last: a
+ * write interrupted by a power loss leaves a slot that fails its CRC, or
+ * at worst an old record, and the previous record stays the newest one.
+ * Erased slots (0xFF) are never valid.
+ *
+ * begin() scans the region once to find the newest valid record, reading
+ * it back is then a single slot read. Older records are found by their
+ * position: a corrupt slot in between fails to read, the ones before it
+ * can still be read.
+ */
+
+#ifndef _EEPROM_JOURNAL_H_
+#define _EEPROM_JOURNAL_H_
+
+#include <Arduino.h>
+
+class EepromJournal {
+public:
+	/**
+	 * @param start first EEPROM address of the region
+	 * @param length bytes, the journal holds length / (payloadSize + 3) records
+	 * @param payloadSize bytes per record
+	 */
+	EepromJournal(uint16_t start, uint16_t length, uint8_t payloadSize);
+
+	/**
+	 * Find the newest valid record
+	 * Returns the number of valid records
+	 */
+	uint8_t begin(void);
+
+	/**
+	 * Read a record
+	 *
+	 * @param payload payloadSize bytes
+	 * @param age 0 for the newest record, 1 for the one appended before...
+	 *   up to getCount() - 1
+	 * @param seq if not NULL, the sequence number of the record
+	 * @return false if there is no such record, or it is corrupt
+	 */
+	bool read(void* payload, uint8_t age = 0, uint16_t* seq = NULL);
+
+	/**
+	 * Add a record, it becomes the newest one
+	 * Blocks for ~3.4 ms per byte that changes
+	 */
+	void append(const void* payload);
+
+	uint8_t getSlots(void) { return slots; }
+	// records from the oldest valid one to the newest, corrupt ones included
+	uint8_t getCount(void) { return count; }
+	uint16_t getSequence(void) { return sequence; }  // of the newest record
+
+private:
+	uint16_t address(uint8_t slot);
+	bool readSlot(uint8_t slot, void* payload, uint16_t* seq);
+
+	uint16_t start;
+	uint8_t payloadSize;
+	uint8_t slots;
+	uint8_t newest;
+	uint8_t count;
+	uint16_t sequence;
+};
+
+#endif // _EEPROM_JOURNAL_H_
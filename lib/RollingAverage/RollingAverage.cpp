@@ -29,7 +29,7 @@ RollingAverage::RollingAverage(uint8_t s, int16_t* r) {
 }
 
 void RollingAverage::begin() {
-	for (uint8_t i; i < size; i++) {
+	for (uint8_t i = 0; i < size; i++) {
 		readings[i] = 0;
 	}
 	sum = 0;
@@ -54,3 +54,23 @@ int16_t RollingAverage::getAverage() {
 	if (n_readings == 0) return 0;
 	return (int16_t)(sum / n_readings);	
 }
+
+/**
+ * Integer square root, rounded down
+ */
+uint16_t isqrt32(uint32_t value) {
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+	while (bit > value) bit >>= 2;
+	while (bit != 0) {
+		if (value >= root + bit) {
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return (uint16_t)root;
+}
@@ -32,4 +32,124 @@ private:
 	int32_t sum;
 };
 
+uint16_t isqrt32(uint32_t value);
+
+template <bool C, typename A, typename B> struct RollingSelect { typedef A type; };
+template <typename A, typename B> struct RollingSelect<false, A, B> { typedef B type; };
+
+/**
+ * Rolling average over the last N readings, with variance
+ *
+ * The readings buffer is inline and sized at compile time. When N is a
+ * power of two and the window is full, divisions are shifts.
+ * Variance and standard deviation are O(1): the sum of squares is kept
+ * up to date with the sum.
+ *
+ * BITS bounds the readings to |value| < 2^BITS, they are saturated to it.
+ * When N readings of that size square in 32 bits, the sum of squares and
+ * the variance are computed in 32 bits, else in 64 bits (slow on AVR).
+ *
+ * RollingAverage is not a wrapper of this template: its size is only known
+ * at runtime, the inline buffer and the shifts need it at compile time.
+ */
+template <uint8_t N, typename T = int16_t, uint8_t BITS = 8 * sizeof(T)>
+class FixedRollingAverage {
+	static_assert(N > 0, "empty window");
+	static_assert(sizeof(T) <= 2, "designed for 8 and 16-bit data");
+	static_assert(BITS > 0 && BITS <= 8 * sizeof(T), "BITS out of the range of T");
+
+public:
+	FixedRollingAverage() { begin(); }
+
+	void begin() {
+		for (uint8_t i = 0; i < N; i++) {
+			readings[i] = 0;
+		}
+		sum = 0;
+		sumSquares = 0;
+		index = 0;
+		n_readings = 0;
+	}
+
+	void addReading(T value) {
+		if (SATURATE) {
+			if (value > MAX) value = MAX;
+			else if (value < -MAX) value = -MAX;
+		}
+		if (n_readings < N) {
+			n_readings++;
+		}
+		else {
+			T old = readings[index];
+			sum -= old;
+			sumSquares -= square(old);
+		}
+		sum += value;
+		sumSquares += square(value);
+
+		readings[index] = value;
+		index = (index == N - 1) ? 0 : index + 1;
+	}
+
+	// rounded toward zero, like RollingAverage
+	T getAverage() const {
+		if (n_readings == 0) return 0;
+		if (POW2 && n_readings == N) {
+			return (T)(sum >= 0 ? (sum >> SHIFT) : -((-sum) >> SHIFT));
+		}
+		return (T)(sum / n_readings);
+	}
+
+	// population variance, in squared units of T, rounded down
+	uint32_t getVariance() const {
+		if (n_readings < 2) return 0;
+		if (NARROW) {
+			// n.var = Σx² - (Σx)²/n, with (Σx)²/n = |Σx|.q + |Σx|.r/n
+			// (|Σx| = q.n + r) rounded up: no product exceeds 32 bits
+			uint32_t s = sum >= 0 ? (uint32_t)sum : (uint32_t)-sum;
+			if (POW2 && n_readings == N) {
+				uint32_t c = s * (s >> SHIFT) + ((s * (s & (N - 1)) + N - 1) >> SHIFT);
+				return (uint32_t)(sumSquares - c) >> SHIFT;
+			}
+			uint32_t c = s * (s / n_readings) + (s * (s % n_readings) + n_readings - 1) / n_readings;
+			return (uint32_t)(sumSquares - c) / n_readings;
+		}
+		// n².var = n.Σx² - (Σx)², never negative
+		int64_t scaled = (int64_t)sumSquares * n_readings - (int64_t)sum * sum;
+		if (POW2 && n_readings == N) {
+			return (uint32_t)(scaled >> (2 * SHIFT));
+		}
+		return (uint32_t)(scaled / ((uint16_t)n_readings * n_readings));
+	}
+
+	uint16_t getStdDev() const {
+		return isqrt32(getVariance());
+	}
+
+	uint8_t getCount() const { return n_readings; }
+	bool isFull() const { return n_readings == N; }
+
+private:
+	static constexpr uint8_t log2(uint8_t n) { return n <= 1 ? 0 : 1 + log2(n >> 1); }
+	static constexpr bool POW2 = (N & (N - 1)) == 0;
+	static constexpr uint8_t SHIFT = log2(N);
+	static constexpr bool SATURATE = BITS < 8 * sizeof(T);
+	static constexpr T MAX = SATURATE ? (T)((1UL << BITS) - 1) : 0;
+	// N.(2^BITS)² fits in 32 bits
+	static constexpr bool NARROW = SHIFT + (POW2 ? 0 : 1) + 2 * BITS <= 32;
+	typedef typename RollingSelect<NARROW, uint32_t, uint64_t>::type sum_squares_t;
+
+	static sum_squares_t square(T value) {
+		int32_t v = value;
+		uint32_t magnitude = v < 0 ? -v : v;
+		return (sum_squares_t)(magnitude * magnitude);
+	}
+
+	T readings[N];
+	uint8_t index;
+	uint8_t n_readings;
+	int32_t sum;
+	sum_squares_t sumSquares;
+};
+
 #endif // _ROLLING_AVERAGE_H_
@@ -0,0 +1,92 @@
+/**
+ * This file is part of
+ *
+ * Scheduler
+ * Static cooperative task scheduler for Arduino
+ *
+ * MIT License
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include "Scheduler.h"
+
+Scheduler::Scheduler(Task* tasks, uint8_t count) :
+	tasks(tasks),
+	count(count)
+{
+}
+
+/**
+ * Run a task after delay ms, then every period for periodic tasks
+ * Restarts it if already active
+ */
+void Scheduler::start(uint8_t id, uint16_t delay)
+{
+	tasks[id].deadline = millis() + delay;
+	tasks[id].active = true;
+}
+
+void Scheduler::stop(uint8_t id)
+{
+	tasks[id].active = false;
+}
+
+bool Scheduler::isActive(uint8_t id)
+{
+	return tasks[id].active;
+}
+
+/**
+ * Run the tasks which are due, to be called from loop()
+ */
+void Scheduler::run(void)
+{
+	for (uint8_t i = 0; i < count; i++) {
+		Task* t = &tasks[i];
+		if (!t->active) continue;
+		uint32_t now = millis();
+		int32_t lateness = (int32_t)(now - t->deadline);
+		if (lateness < 0) continue;
+		// next deadline first, the task may stop or restart itself
+		if (t->period == 0) {
+			t->active = false;
+		}
+		else {
+			t->deadline += t->period;
+			if ((int32_t)(now - t->deadline) >= 0) {
+				t->deadline = now + t->period;
+			}
+		}
+		uint32_t start = micros();
+		t->callback();
+		uint32_t runTime = micros() - start;
+		if (t->totalRunTime > UINT32_MAX - runTime) {
+			t->totalRunTime >>= 1;
+			t->runs >>= 1;
+		}
+		t->runs++;
+		t->totalRunTime += runTime;
+		if (runTime > t->maxRunTime) t->maxRunTime = runTime > UINT16_MAX ? UINT16_MAX : runTime;
+		if ((uint32_t)lateness > t->maxLateness) t->maxLateness = lateness > UINT16_MAX ? UINT16_MAX : lateness;
+	}
+}
+
+/**
+ * Time until the next deadline, to know how long the MCU can sleep
+ *
+ * @return ms, 0 if a task is due, SCHEDULER_IDLE if none is active
+ */
+uint16_t Scheduler::timeToNext(void)
+{
+	uint32_t now = millis();
+	uint16_t next = SCHEDULER_IDLE;
+	for (uint8_t i = 0; i < count; i++) {
+		if (!tasks[i].active) continue;
+		int32_t remaining = (int32_t)(tasks[i].deadline - now);
+		if (remaining <= 0) return 0;
+		if (remaining < next) next = remaining;
+	}
+	return next;
+}
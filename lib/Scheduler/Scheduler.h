@@ -0,0 +1,63 @@
+/**
+ * Scheduler
+ * Static cooperative task scheduler for Arduino
+ *
+ * MIT License
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ * Tasks are plain functions in a fixed table owned by the caller. A task is
+ * either periodic, or one-shot (period = 0), and only runs once started.
+ * run() calls every task whose deadline is over, in table order; a task is
+ * never interrupted by another one.
+ *
+ * Deadlines are millis() values compared by difference, they survive the
+ * 49 days overflow. A periodic task keeps its phase, unless it is late by
+ * a whole period: missed runs are skipped, not caught up.
+ */
+
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <Arduino.h>
+
+#define SCHEDULER_IDLE UINT16_MAX  // no task started
+
+typedef void (*task_callback_t)(void);
+
+struct Task {
+	task_callback_t callback;
+	uint16_t period;             // ms, 0 for one-shot tasks
+	bool active;
+	uint32_t deadline;           // millis()
+	// statistics, since power-up (runs and totalRunTime are halved together
+	// before totalRunTime overflows, the average stays right)
+	uint32_t runs;
+	uint16_t maxRunTime;         // µs
+	uint32_t totalRunTime;       // µs
+	uint16_t maxLateness;        // ms
+};
+
+// table entry
+#define SCHEDULER_TASK(callback, period) { callback, period, false, 0, 0, 0, 0, 0 }
+
+class Scheduler {
+public:
+	Scheduler(Task* tasks, uint8_t count);
+
+	void start(uint8_t id, uint16_t delay = 0);
+	void stop(uint8_t id);
+	bool isActive(uint8_t id);
+
+	void run(void);
+	uint16_t timeToNext(void);
+
+	const Task* getTask(uint8_t id) { return &tasks[id]; }
+	uint8_t getCount(void) { return count; }
+
+private:
+	Task* tasks;
+	uint8_t count;
+};
+
+#endif // _SCHEDULER_H_
@@ -0,0 +1,248 @@
+/**
+ * This file is part of
+ *
+ * TwiQueue
+ * Interrupt driven, non-blocking I²C master transaction queue for AVR
+ *
+ * MIT License
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include "TwiQueue.h"
+
+#include <util/atomic.h>
+
+TwiQueue twiQueue;
+
+TwiQueue::TwiQueue() :
+	transactions(0),
+	urgentTransactions(0),
+	maxDepth(0),
+	active(NULL),
+	urgentHead(NULL),
+	urgentTail(NULL),
+	normalHead(NULL),
+	normalTail(NULL),
+	depth(0)
+{
+}
+
+void TwiQueue::begin(uint32_t clock)
+{
+	twiPortBegin(clock);
+}
+
+/**
+ * Queue a transaction, safe to call from an interrupt
+ *
+ * The descriptor and its buffers must stay valid until status != TWIQ_PENDING
+ * Returns false if the descriptor is already queued
+ */
+bool TwiQueue::submit(TwiTransaction* t, bool urgent)
+{
+	bool queued = false;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (t->status != TWIQ_PENDING) {
+			t->status = TWIQ_PENDING;
+			t->next = NULL;
+			if (urgent) {
+				if (urgentTail != NULL) urgentTail->next = t;
+				else urgentHead = t;
+				urgentTail = t;
+				urgentTransactions++;
+			}
+			else {
+				if (normalTail != NULL) normalTail->next = t;
+				else normalHead = t;
+				normalTail = t;
+			}
+			transactions++;
+			if (++depth > maxDepth) maxDepth = depth;
+			if (active == NULL) startNext();
+			queued = true;
+		}
+	}
+	return queued;
+}
+
+/**
+ * Blocking transfer, for initialization code
+ * Returns the final status (TWIQ_DONE on success)
+ */
+uint8_t TwiQueue::transfer(uint8_t address, const uint8_t* writeData, uint8_t writeLength,
+	uint8_t* readData, uint8_t readLength)
+{
+	TwiTransaction t;
+	t.address = address;
+	t.writeData = writeData;
+	t.writeLength = writeLength;
+	t.readData = readData;
+	t.readLength = readLength;
+	t.callback = NULL;
+	t.status = TWIQ_IDLE;
+	this->submit(&t);
+	while (t.status == TWIQ_PENDING) {
+		this->wait();
+	}
+	return t.status;
+}
+
+bool TwiQueue::isBusy(void)
+{
+	return active != NULL;
+}
+
+/**
+ * Give the bus a chance to progress, to be called in busy-wait loops
+ */
+void TwiQueue::wait(void)
+{
+	twiPortWait();
+}
+
+/**
+ * Wait until all queued transactions are done
+ */
+void TwiQueue::flush(void)
+{
+	while (active != NULL) {
+		this->wait();
+	}
+}
+
+/**
+ * End of the active transaction, called from the TWI interrupt
+ */
+void TwiQueue::complete(uint8_t status)
+{
+	TwiTransaction* t = active;
+	active = NULL;
+	depth--;
+	if (t != NULL) {
+		t->status = status;
+		if (t->callback != NULL) t->callback(t);
+	}
+	startNext();
+}
+
+/**
+ * Start the next transaction, urgent ones first
+ * Must be called with interrupts disabled
+ */
+void TwiQueue::startNext(void)
+{
+	if (active != NULL) return;
+	TwiTransaction* t;
+	if (urgentHead != NULL) {
+		t = urgentHead;
+		urgentHead = t->next;
+		if (urgentHead == NULL) urgentTail = NULL;
+	}
+	else if (normalHead != NULL) {
+		t = normalHead;
+		normalHead = t->next;
+		if (normalHead == NULL) normalTail = NULL;
+	}
+	else {
+		return;
+	}
+	active = t;
+	twiPortStart(t);
+}
+
+
+#if defined(__AVR__)
+
+#include <util/twi.h>
+
+#define TWCR_GO (_BV(TWEN) | _BV(TWIE) | _BV(TWINT))
+
+static TwiTransaction* port;
+static uint8_t portIndex;
+static bool portReading;
+
+void twiPortBegin(uint32_t clock)
+{
+	// internal pull-ups on SDA / SCL, as Wire does
+	digitalWrite(SDA, HIGH);
+	digitalWrite(SCL, HIGH);
+	TWSR = 0; // prescaler = 1
+	TWBR = ((F_CPU / clock) - 16) / 2;
+	TWCR = _BV(TWEN) | _BV(TWIE);
+}
+
+void twiPortStart(TwiTransaction* t)
+{
+	port = t;
+	portIndex = 0;
+	portReading = (t->writeLength == 0);
+	TWCR = TWCR_GO | _BV(TWSTA);
+}
+
+void twiPortWait(void)
+{
+	// nothing to do, the TWI interrupt moves things forward
+}
+
+static void portStop(uint8_t status)
+{
+	TWCR = TWCR_GO | _BV(TWSTO);
+	while (TWCR & _BV(TWSTO)) {
+		// STOP is sent within a few SCL cycles
+	}
+	twiQueue.complete(status);
+}
+
+ISR(TWI_vect)
+{
+	switch (TW_STATUS) {
+	case TW_START:
+	case TW_REP_START:
+		TWDR = (port->address << 1) | (portReading ? TW_READ : TW_WRITE);
+		TWCR = TWCR_GO;
+		break;
+	case TW_MT_SLA_ACK:
+	case TW_MT_DATA_ACK:
+		if (portIndex < port->writeLength) {
+			TWDR = port->writeData[portIndex++];
+			TWCR = TWCR_GO;
+		}
+		else if (port->readLength > 0) {
+			portIndex = 0;
+			portReading = true;
+			TWCR = TWCR_GO | _BV(TWSTA); // repeated START
+		}
+		else {
+			portStop(TWIQ_DONE);
+		}
+		break;
+	case TW_MR_SLA_ACK:
+		// ACK all bytes but the last one
+		TWCR = TWCR_GO | (port->readLength > 1 ? _BV(TWEA) : 0);
+		break;
+	case TW_MR_DATA_ACK:
+		port->readData[portIndex++] = TWDR;
+		TWCR = TWCR_GO | (portIndex < port->readLength - 1 ? _BV(TWEA) : 0);
+		break;
+	case TW_MR_DATA_NACK:
+		port->readData[portIndex++] = TWDR;
+		portStop(TWIQ_DONE);
+		break;
+	case TW_MT_SLA_NACK:
+	case TW_MT_DATA_NACK:
+	case TW_MR_SLA_NACK:
+		portStop(TWIQ_NACK);
+		break;
+	case TW_MT_ARB_LOST:
+		// single master bus: only happens on bus errors, release it
+		TWCR = TWCR_GO;
+		twiQueue.complete(TWIQ_ERROR);
+		break;
+	default:
+		portStop(TWIQ_ERROR);
+	}
+}
+
+#endif // __AVR__
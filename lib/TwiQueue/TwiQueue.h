@@ -0,0 +1,85 @@
+/**
+ * TwiQueue
+ * Interrupt driven, non-blocking I²C master transaction queue for AVR
+ *
+ * MIT License
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ * Several drivers can share the bus: each one submits transaction
+ * descriptors, which are run back to back by the TWI interrupt. Urgent
+ * transactions (e.g. reading a sensor sample) jump ahead of the normal ones
+ * (e.g. streaming a display page) at the next transaction boundary.
+ *
+ * A transaction is: START, address + write bytes, then optionally a
+ * repeated START, address + read bytes, and STOP.
+ *
+ * Replaces Wire: both drive the TWI hardware and define TWI_vect, they must
+ * not be linked together.
+ */
+
+#ifndef _TWI_QUEUE_H_
+#define _TWI_QUEUE_H_
+
+#include <Arduino.h>
+
+#define TWIQ_IDLE     0
+#define TWIQ_PENDING  1  // queued or in progress
+#define TWIQ_DONE     2
+#define TWIQ_NACK     3
+#define TWIQ_ERROR    4
+
+struct TwiTransaction;
+typedef void (*twi_callback_t)(TwiTransaction* t);
+
+struct TwiTransaction {
+	uint8_t address;            // 7-bit
+	const uint8_t* writeData;
+	uint8_t writeLength;
+	uint8_t* readData;
+	uint8_t readLength;
+	twi_callback_t callback;    // called from the TWI interrupt when done, can be NULL
+	volatile uint8_t status;
+	TwiTransaction* next;
+};
+
+class TwiQueue {
+public:
+	TwiQueue();
+
+	void begin(uint32_t clock = 400000);
+	bool submit(TwiTransaction* t, bool urgent = false);
+	uint8_t transfer(uint8_t address, const uint8_t* writeData, uint8_t writeLength,
+		uint8_t* readData = NULL, uint8_t readLength = 0);
+	bool isBusy(void);
+	void wait(void);
+	void flush(void);
+
+	// called by the port when the active transaction is over
+	void complete(uint8_t status);
+
+	uint32_t transactions;
+	uint16_t urgentTransactions;
+	uint8_t maxDepth;
+
+private:
+	void startNext(void);
+
+	TwiTransaction* volatile active;
+	TwiTransaction* urgentHead;
+	TwiTransaction* urgentTail;
+	TwiTransaction* normalHead;
+	TwiTransaction* normalTail;
+	uint8_t depth;
+};
+
+extern TwiQueue twiQueue;
+
+/**
+ * Hardware port, TwiQueue.cpp provides the AVR TWI one
+ */
+void twiPortBegin(uint32_t clock);
+void twiPortStart(TwiTransaction* t);
+void twiPortWait(void);
+
+#endif // _TWI_QUEUE_H_
@@ -0,0 +1,134 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include <Arduino.h>
+
+#include "sim.h"
+
+HardwareSerial Serial;
+
+// timer 0 overflow interrupt (millis()), every 256 x 64 CPU clocks:
+// nothing to do but waking up a sleeping CPU
+#define TIMER0_PERIOD (256ull * 64 * 1000000 / F_CPU)
+
+class Timer0 : public sim::Ticker {
+public:
+	virtual uint64_t nextEvent() { return (sim::now() / TIMER0_PERIOD + 1) * TIMER0_PERIOD; }
+	virtual void fire(uint64_t t) { (void) t; }
+} timer0;
+
+// bytes waiting in the transmit buffer
+uint32_t HardwareSerial::buffered()
+{
+	if (baud == 0 || txEnd <= sim::now()) return 0;
+	uint64_t byteTime = 10000000ull / baud;
+	return (uint32_t)((txEnd - sim::now() + byteTime - 1) / byteTime);
+}
+
+int HardwareSerial::availableForWrite()
+{
+	return SERIAL_TX_BUFFER_SIZE - 1 - buffered();
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+	sent++;
+	if (echo) putchar(c);
+	if (capture != NULL) fputc(c, capture);
+	if (baud == 0) return 1;
+	uint64_t byteTime = 10000000ull / baud;
+	if (buffered() >= SERIAL_TX_BUFFER_SIZE - 1) {
+		// wait for room, as the AVR core does
+		uint64_t start = sim::now();
+		sim::advanceTo(txEnd - (SERIAL_TX_BUFFER_SIZE - 2) * byteTime);
+		blockedTime += sim::now() - start;
+	}
+	txEnd = (txEnd > sim::now() ? txEnd : sim::now()) + byteTime;
+	return 1;
+}
+
+void cli(void)
+{
+	sim::setInterruptsEnabled(false);
+}
+
+void sei(void)
+{
+	sim::setInterruptsEnabled(true);
+}
+
+uint32_t millis(void)
+{
+	return (uint32_t)(sim::now() / 1000);
+}
+
+uint32_t micros(void)
+{
+	return (uint32_t)sim::now();
+}
+
+void delay(uint32_t ms)
+{
+	sim::advance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	sim::advance(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+	if (mode == INPUT_PULLUP && sim::getPin(pin) == LOW) {
+		sim::setPin(pin, HIGH);
+	}
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+	sim::setPin(pin, value);
+}
+
+int digitalRead(uint8_t pin)
+{
+	return sim::getPin(pin);
+}
+
+int analogRead(uint8_t pin)
+{
+	// a conversion takes 13 ADC clocks at 125 kHz
+	sim::advance(104);
+	return sim::getAnalog(pin);
+}
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration)
+{
+	(void) pin;
+	(void) duration;
+	sim::tones.count++;
+	sim::tones.lastFrequency = frequency;
+	sim::tones.lastTime = sim::now();
+}
+
+void noTone(uint8_t pin)
+{
+	(void) pin;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode)
+{
+	sim::attachExtInterrupt(interrupt, isr, mode);
+}
+
+void detachInterrupt(uint8_t interrupt)
+{
+	sim::attachExtInterrupt(interrupt, NULL, 0);
+}
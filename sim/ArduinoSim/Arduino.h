@@ -0,0 +1,142 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ * Host stand-in for the Arduino core, used by the `native` environment
+ *
+ * Only what the firmware and its libraries use is provided.
+ * PROGMEM and the *_P functions map to plain memory on the host.
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#ifndef _SIM_ARDUINO_H_
+#define _SIM_ARDUINO_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Print.h"
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A6 20
+#define A7 21
+
+#define F_CPU 8000000UL
+
+// flash strings
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+#define pgm_read_byte(addr)  (*(const uint8_t*)(addr))
+#define pgm_read_word(addr)  (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t*)(addr))
+#define pgm_read_ptr(addr)   (*(void* const*)(addr))
+#define sprintf_P  sprintf
+#define snprintf_P snprintf
+#define strcpy_P   strcpy
+#define strlen_P   strlen
+#define memcpy_P   memcpy
+
+#define _BV(bit) (1 << (bit))
+
+// interrupts
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : -1))
+
+// pin change interrupts, same mapping as the ATmega328P variant
+extern volatile uint8_t PCICR;
+extern volatile uint8_t PCIFR;
+extern volatile uint8_t PCMSK0;
+extern volatile uint8_t PCMSK1;
+extern volatile uint8_t PCMSK2;
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+#define PCIF0 0
+#define PCIF1 1
+#define PCIF2 2
+#define digitalPinToPCICR(p)    (((p) <= 21) ? (&PCICR) : ((volatile uint8_t*)0))
+#define digitalPinToPCICRbit(p) (((p) <= 7) ? 2 : (((p) <= 13) ? 0 : 1))
+#define digitalPinToPCMSK(p)    (((p) <= 7) ? (&PCMSK2) : (((p) <= 13) ? (&PCMSK0) : (((p) <= 21) ? (&PCMSK1) : ((volatile uint8_t*)0))))
+#define digitalPinToPCMSKbit(p) (((p) <= 7) ? (p) : (((p) <= 13) ? ((p) - 8) : ((p) - 14)))
+#define ISR(vector) extern "C" void vector(void); extern "C" void vector(void)
+void cli(void);
+void sei(void);
+#define noInterrupts() cli()
+#define interrupts()   sei()
+
+uint32_t millis(void);
+uint32_t micros(void);
+void delay(uint32_t ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0);
+void noTone(uint8_t pin);
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t interrupt);
+
+/**
+ * Serial port, output is captured and optionally echoed to stdout or saved
+ *
+ * Transmission is timed at the configured baud rate, 10 bits per byte,
+ * through a 64 bytes buffer like the AVR core: write() blocks while the
+ * buffer is full.
+ */
+#define SERIAL_TX_BUFFER_SIZE 64
+
+class HardwareSerial : public Print {
+public:
+	HardwareSerial() : baud(0), echo(false), capture(NULL), sent(0), blockedTime(0), txEnd(0) {}
+	void begin(unsigned long b) { baud = b; }
+	void end() {}
+	int available() { return 0; }
+	int read() { return -1; }
+	int availableForWrite();
+	void flush() {}
+	virtual size_t write(uint8_t c);
+	using Print::write;
+	operator bool() { return true; }
+
+	unsigned long baud;
+	bool echo;
+	FILE* capture;          // raw output, can be NULL
+	uint32_t sent;
+	uint64_t blockedTime;   // µs spent waiting in write()
+
+private:
+	uint32_t buffered();
+	uint64_t txEnd;         // virtual time the last buffered byte is sent
+};
+
+extern HardwareSerial Serial;
+
+#endif // _SIM_ARDUINO_H_
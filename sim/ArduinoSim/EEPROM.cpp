@@ -0,0 +1,53 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include <EEPROM.h>
+
+#include "sim.h"
+
+EEPROMClass EEPROM;
+
+void EEPROMClass::write(int address, uint8_t value)
+{
+	address %= SIM_EEPROM_SIZE;
+	cells[address] = 0xFF;
+	writes[address]++;
+	if (powerLossAfter > 0 && --powerLossAfter == 0 && sim::powerLoss != NULL) {
+		sim::advance(1700);
+		sim::powerLoss();
+	}
+	// erase + write cycle is 3.4 ms and blocks the CPU
+	sim::advance(3400);
+	cells[address] = value;
+}
+
+bool EEPROMClass::load(const char* path)
+{
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) return false;
+	bool ok = fread(cells, 1, sizeof(cells), f) == sizeof(cells);
+	fclose(f);
+	return ok;
+}
+
+bool EEPROMClass::save(const char* path)
+{
+	FILE* f = fopen(path, "wb");
+	if (f == NULL) return false;
+	bool ok = fwrite(cells, 1, sizeof(cells), f) == sizeof(cells);
+	return fclose(f) == 0 && ok;
+}
+
+void EEPROMClass::clear()
+{
+	memset(cells, 0xFF, sizeof(cells));
+	memset(writes, 0, sizeof(writes));
+}
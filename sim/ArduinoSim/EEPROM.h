@@ -0,0 +1,54 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ * 1 KB EEPROM of the ATmega328P, erased cells read 0xFF.
+ * Every cell counts its erase/write cycles so wear can be inspected.
+ * A cell reads erased during its 3.4 ms erase/write cycle: a power loss
+ * then leaves it at 0xFF.
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#ifndef _SIM_EEPROM_H_
+#define _SIM_EEPROM_H_
+
+#include <Arduino.h>
+
+#define SIM_EEPROM_SIZE 1024
+
+class EEPROMClass {
+public:
+	EEPROMClass() : powerLossAfter(0) { clear(); }
+
+	uint8_t read(int address) { return cells[address % SIM_EEPROM_SIZE]; }
+	void write(int address, uint8_t value);
+	void update(int address, uint8_t value) { if (read(address) != value) write(address, value); }
+	uint16_t length() { return SIM_EEPROM_SIZE; }
+
+	template <typename T> T& get(int address, T& t) {
+		uint8_t* p = (uint8_t*)&t;
+		for (size_t i = 0; i < sizeof(T); i++) p[i] = read(address + i);
+		return t;
+	}
+	template <typename T> const T& put(int address, const T& t) {
+		const uint8_t* p = (const uint8_t*)&t;
+		for (size_t i = 0; i < sizeof(T); i++) update(address + i, p[i]);
+		return t;
+	}
+
+	// simulation helpers
+	void clear();
+	bool load(const char* path);   // image file, false if it can not be read
+	bool save(const char* path);
+	uint8_t cells[SIM_EEPROM_SIZE];
+	uint32_t writes[SIM_EEPROM_SIZE];
+	uint32_t powerLossAfter;       // power is lost during the n-th next write, 0: never
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // _SIM_EEPROM_H_
@@ -0,0 +1,58 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include "Print.h"
+
+#include <stdio.h>
+
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+	size_t n = 0;
+	while (size--) {
+		n += write(*buffer++);
+	}
+	return n;
+}
+
+size_t Print::print(const __FlashStringHelper* s)
+{
+	// PROGMEM is a no-op on the host, flash strings are plain strings
+	return write((const char*)s);
+}
+
+size_t Print::print(double n, int digits)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.*f", digits, n);
+	return write(buf);
+}
+
+size_t Print::printSigned(long n, int base)
+{
+	if (base == DEC && n < 0) {
+		return write((uint8_t)'-') + printNumber((unsigned long)(-n), base);
+	}
+	return printNumber((unsigned long)n, base);
+}
+
+size_t Print::printNumber(unsigned long n, int base)
+{
+	char buf[8 * sizeof(long) + 1];
+	char* str = &buf[sizeof(buf) - 1];
+	*str = '\0';
+	if (base < 2) base = 10;
+	do {
+		char c = n % base;
+		n /= base;
+		*--str = c < 10 ? c + '0' : c + 'A' - 10;
+	} while (n);
+	return write(str);
+}
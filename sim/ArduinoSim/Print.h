@@ -0,0 +1,57 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ * Host stand-in for the Arduino core, used by the `native` environment
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#ifndef _SIM_PRINT_H_
+#define _SIM_PRINT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class __FlashStringHelper;
+
+/**
+ * Minimal Print class, same interface as the Arduino core one
+ */
+class Print {
+public:
+	virtual ~Print() {}
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t* buffer, size_t size);
+	size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+	size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+
+	size_t print(const __FlashStringHelper* s);
+	size_t print(const char* s) { return write(s); }
+	size_t print(char c) { return write((uint8_t)c); }
+	size_t print(unsigned char n, int base = DEC) { return printNumber(n, base); }
+	size_t print(int n, int base = DEC) { return printSigned(n, base); }
+	size_t print(unsigned int n, int base = DEC) { return printNumber(n, base); }
+	size_t print(long n, int base = DEC) { return printSigned(n, base); }
+	size_t print(unsigned long n, int base = DEC) { return printNumber(n, base); }
+	size_t print(double n, int digits = 2);
+
+	size_t println(void) { return write("\r\n"); }
+	template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+	template <typename T> size_t println(T value, int mod) { size_t n = print(value, mod); return n + println(); }
+
+private:
+	size_t printSigned(long n, int base);
+	size_t printNumber(unsigned long n, int base);
+};
+
+#endif // _SIM_PRINT_H_
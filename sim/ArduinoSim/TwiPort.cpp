@@ -0,0 +1,76 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ * TWI hardware port for the TwiQueue library: transactions are routed to
+ * sim::I2CDevice instances and complete in the background, after the time
+ * the bus needs for them.
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include <TwiQueue.h>
+
+#include "sim.h"
+
+namespace {
+
+class TwiPort : public sim::Ticker {
+public:
+	TwiPort() : clock(100000), due(SIM_NO_EVENT), status(TWIQ_IDLE) {}
+	virtual uint64_t nextEvent() { return due; }
+	virtual void fire(uint64_t t) { (void) t; due = SIM_NO_EVENT; sim::raiseInterrupt(isr); }
+	static void isr() { twiQueue.complete(port.status); }
+
+	uint32_t clock;
+	uint64_t due;
+	uint8_t status;
+	static TwiPort port;
+};
+
+TwiPort TwiPort::port;
+
+} // namespace
+
+void twiPortBegin(uint32_t clock)
+{
+	TwiPort::port.clock = clock;
+}
+
+void twiPortStart(TwiTransaction* t)
+{
+	TwiPort& port = TwiPort::port;
+	sim::I2CDevice* device = sim::findDevice(t->address);
+	uint32_t duration = 0;
+	bool ack = (device != NULL);
+	if (t->writeLength > 0 || t->readLength == 0) {
+		duration += sim::transferTime(t->writeLength, port.clock);
+		sim::bus.transactions++;
+		sim::bus.bytes += t->writeLength + 1;
+		if (device != NULL) {
+			device->transactions++;
+			device->bytes += t->writeLength;
+			ack = device->receive(t->writeData, t->writeLength);
+		}
+	}
+	if (ack && t->readLength > 0) {
+		// repeated START, same cost as a new transfer
+		duration += sim::transferTime(t->readLength, port.clock);
+		sim::bus.bytes += t->readLength + 1;
+		if (t->writeLength == 0) sim::bus.transactions++;
+		device->bytes += t->readLength;
+		if (t->writeLength == 0) device->transactions++;
+		device->transmit(t->readData, t->readLength);
+	}
+	sim::bus.busyTime += duration;
+	port.status = ack ? TWIQ_DONE : TWIQ_NACK;
+	port.due = sim::now() + duration;
+}
+
+void twiPortWait(void)
+{
+	sim::idle();
+}
@@ -0,0 +1,204 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include <U8g2lib.h>
+#include <Wire.h>
+
+#include "sim.h"
+
+const u8g2_cb_t u8g2_cb_r0 = {0};
+
+const uint8_t u8g2_font_6x13_tr[] = {6, 13, 10};
+const uint8_t u8g2_font_logisoso30_tn[] = {17, 30, 30};
+const uint8_t u8g2_font_inb30_mn[] = {25, 30, 30};
+
+uint32_t U8G2::pageRenderTime = 0;
+void (*U8G2::pageHook)(bool begin) = NULL;
+uint32_t U8G2::bytesSent = 0;
+
+#define SH1106_I2C_ADDRESS    0x78  // 0x3C << 1
+#define SH1106_I2C_CLOCK      400000
+#define SH1106_COLUMN_OFFSET  2
+#define SSD13XX_I2C_CHUNK     24    // data bytes per I2C transfer (u8x8_cad_ssd13xx_i2c)
+
+static void setup_sh1106(u8g2_t* u8g2, uint8_t tile_buf_height, u8x8_msg_cb byte_cb, u8x8_msg_cb gpio_and_delay_cb)
+{
+	memset(u8g2, 0, sizeof(u8g2_t));
+	u8g2->u8x8.byte_cb = byte_cb;
+	u8g2->u8x8.gpio_and_delay_cb = gpio_and_delay_cb;
+	u8g2->u8x8.i2c_address = SH1106_I2C_ADDRESS;
+	u8g2->u8x8.bus_clock = SH1106_I2C_CLOCK;
+	u8g2->tile_buf_height = tile_buf_height;
+}
+
+void u8g2_Setup_sh1106_i2c_128x64_noname_1(u8g2_t* u8g2, const u8g2_cb_t* rotation, u8x8_msg_cb byte_cb, u8x8_msg_cb gpio_and_delay_cb)
+{
+	(void) rotation;
+	setup_sh1106(u8g2, 1, byte_cb, gpio_and_delay_cb);
+}
+
+void u8g2_Setup_sh1106_i2c_128x64_noname_2(u8g2_t* u8g2, const u8g2_cb_t* rotation, u8x8_msg_cb byte_cb, u8x8_msg_cb gpio_and_delay_cb)
+{
+	(void) rotation;
+	setup_sh1106(u8g2, 2, byte_cb, gpio_and_delay_cb);
+}
+
+/**
+ * Same behaviour as U8x8lib.cpp: the bus clock is forced at every transfer
+ */
+uint8_t u8x8_byte_arduino_hw_i2c(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr)
+{
+	switch (msg) {
+	case U8X8_MSG_BYTE_SEND:
+		Wire.write((const uint8_t*)arg_ptr, arg_int);
+		break;
+	case U8X8_MSG_BYTE_INIT:
+		Wire.begin();
+		break;
+	case U8X8_MSG_BYTE_START_TRANSFER:
+		Wire.setClock(u8x8->bus_clock);
+		Wire.beginTransmission(u8x8_GetI2CAddress(u8x8) >> 1);
+		break;
+	case U8X8_MSG_BYTE_END_TRANSFER:
+		Wire.endTransmission();
+		break;
+	default:
+		return 0;
+	}
+	return 1;
+}
+
+uint8_t u8x8_gpio_and_delay_arduino(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr)
+{
+	(void) u8x8; (void) msg; (void) arg_int; (void) arg_ptr;
+	return 1;
+}
+
+U8G2::U8G2() :
+	frames(0),
+	tileRowsSent(0),
+	font(NULL),
+	tx(0),
+	ty(0)
+{
+	memset(&u8g2, 0, sizeof(u8g2));
+}
+
+void U8G2::transfer(const uint8_t* data, uint8_t length)
+{
+	u8x8_t* u8x8 = &u8g2.u8x8;
+	u8x8->byte_cb(u8x8, U8X8_MSG_BYTE_START_TRANSFER, 0, NULL);
+	u8x8->byte_cb(u8x8, U8X8_MSG_BYTE_SEND, length, (void*)data);
+	bytesSent += length;
+	u8x8->byte_cb(u8x8, U8X8_MSG_BYTE_END_TRANSFER, 0, NULL);
+}
+
+void U8G2::sendTileRow(uint8_t row)
+{
+	const uint8_t cmd[] = {
+		0x00,  // control byte: command stream
+		(uint8_t)(0xB0 | row),
+		(uint8_t)(0x10 | (SH1106_COLUMN_OFFSET >> 4)),
+		(uint8_t)(SH1106_COLUMN_OFFSET & 0x0F),
+	};
+	transfer(cmd, sizeof(cmd));
+
+	uint8_t chunk[SSD13XX_I2C_CHUNK + 1];
+	chunk[0] = 0x40;  // control byte: data stream
+	const uint8_t* src = &u8g2.buffer[(row - u8g2.tile_curr_row) * U8G2_SIM_TILE_WIDTH * 8];
+	for (uint8_t col = 0; col < U8G2_SIM_TILE_WIDTH * 8; col += SSD13XX_I2C_CHUNK) {
+		uint8_t n = U8G2_SIM_TILE_WIDTH * 8 - col;
+		if (n > SSD13XX_I2C_CHUNK) n = SSD13XX_I2C_CHUNK;
+		memcpy(&chunk[1], &src[col], n);
+		transfer(chunk, n + 1);
+	}
+	tileRowsSent++;
+}
+
+bool U8G2::begin(void)
+{
+	u8x8_t* u8x8 = &u8g2.u8x8;
+	u8x8->byte_cb(u8x8, U8X8_MSG_BYTE_INIT, 0, NULL);
+	// SH1106 init sequence is 25 command bytes
+	uint8_t init[26] = {0x00};
+	transfer(init, sizeof(init));
+	clearDisplay();
+	setPowerSave(0);
+	return true;
+}
+
+void U8G2::setPowerSave(uint8_t is_enable)
+{
+	const uint8_t cmd[] = {0x00, (uint8_t)(is_enable ? 0xAE : 0xAF)};
+	transfer(cmd, sizeof(cmd));
+}
+
+void U8G2::setContrast(uint8_t value)
+{
+	const uint8_t cmd[] = {0x00, 0x81, value};
+	transfer(cmd, sizeof(cmd));
+}
+
+void U8G2::clearDisplay(void)
+{
+	firstPage();
+	do {
+	} while (nextPage());
+}
+
+void U8G2::clearBuffer(void)
+{
+	if (pageHook != NULL) pageHook(true);
+	memset(u8g2.buffer, 0, sizeof(u8g2.buffer));
+}
+
+void U8G2::sendBuffer(void)
+{
+	sim::advance(pageRenderTime);
+	for (uint8_t i = 0; i < u8g2.tile_buf_height; i++) {
+		uint8_t row = u8g2.tile_curr_row + i;
+		if (row >= U8G2_SIM_TILE_ROWS) break;
+		sendTileRow(row);
+	}
+	if (pageHook != NULL) pageHook(false);
+}
+
+void U8G2::firstPage(void)
+{
+	u8g2.tile_curr_row = 0;
+	clearBuffer();
+}
+
+uint8_t U8G2::nextPage(void)
+{
+	sendBuffer();
+	u8g2.tile_curr_row += u8g2.tile_buf_height;
+	if (u8g2.tile_curr_row >= U8G2_SIM_TILE_ROWS) {
+		u8g2.tile_curr_row = 0;
+		frames++;
+		return 0;
+	}
+	clearBuffer();
+	return 1;
+}
+
+uint16_t U8G2::drawStr(int16_t x, int16_t y, const char* s)
+{
+	setCursor(x, y);
+	return print(s);
+}
+
+size_t U8G2::write(uint8_t c)
+{
+	if (c == '\r' || c == '\n') return 1;
+	tx += font ? font[0] : 0;
+	return 1;
+}
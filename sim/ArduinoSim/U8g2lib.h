@@ -0,0 +1,141 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ * U8g2 page buffer API stand-in.
+ *
+ * Drawing is not rasterized, but every page is pushed through the u8x8 byte
+ * callback exactly like the real SH1106 I2C driver does (command transfer +
+ * 24-byte data transfers per tile row), so bus traffic and timing match.
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#ifndef _SIM_U8G2LIB_H_
+#define _SIM_U8G2LIB_H_
+
+#include <Arduino.h>
+
+#define U8X8_MSG_BYTE_INIT            20
+#define U8X8_MSG_BYTE_SEND            23
+#define U8X8_MSG_BYTE_START_TRANSFER  24
+#define U8X8_MSG_BYTE_END_TRANSFER    25
+#define U8X8_MSG_BYTE_SET_DC          32
+
+#define U8G2_SIM_TILE_ROWS   8
+#define U8G2_SIM_TILE_WIDTH  16
+
+typedef struct u8x8_struct u8x8_t;
+typedef uint8_t (*u8x8_msg_cb)(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr);
+
+struct u8x8_struct {
+	u8x8_msg_cb byte_cb;
+	u8x8_msg_cb gpio_and_delay_cb;
+	uint8_t i2c_address;  // 8-bit form, as in u8x8
+	uint32_t bus_clock;
+	void* user_ptr;
+};
+
+typedef struct u8g2_cb_struct { uint8_t rotation; } u8g2_cb_t;
+
+typedef struct u8g2_struct {
+	u8x8_t u8x8;
+	uint8_t tile_buf_height;
+	uint8_t tile_curr_row;
+	uint8_t buffer[U8G2_SIM_TILE_WIDTH * 8 * 2];
+} u8g2_t;
+
+extern const u8g2_cb_t u8g2_cb_r0;
+#define U8G2_R0 (&u8g2_cb_r0)
+
+// fonts: width, height, ascent
+extern const uint8_t u8g2_font_6x13_tr[];
+extern const uint8_t u8g2_font_logisoso30_tn[];
+extern const uint8_t u8g2_font_inb30_mn[];
+
+uint8_t u8x8_byte_arduino_hw_i2c(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr);
+uint8_t u8x8_gpio_and_delay_arduino(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr);
+#define u8x8_GetI2CAddress(u8x8) ((u8x8)->i2c_address)
+#define u8x8_GetUserPtr(u8x8) ((u8x8)->user_ptr)
+#define u8x8_SetUserPtr(u8x8, p) ((u8x8)->user_ptr = (p))
+
+void u8g2_Setup_sh1106_i2c_128x64_noname_1(u8g2_t* u8g2, const u8g2_cb_t* rotation, u8x8_msg_cb byte_cb, u8x8_msg_cb gpio_and_delay_cb);
+void u8g2_Setup_sh1106_i2c_128x64_noname_2(u8g2_t* u8g2, const u8g2_cb_t* rotation, u8x8_msg_cb byte_cb, u8x8_msg_cb gpio_and_delay_cb);
+
+class U8G2 : public Print {
+public:
+	U8G2();
+
+	u8g2_t* getU8g2() { return &u8g2; }
+	u8x8_t* getU8x8() { return &u8g2.u8x8; }
+
+	bool begin(void);
+	void setPowerSave(uint8_t is_enable);
+	void setContrast(uint8_t value);
+	void clearDisplay(void);
+
+	// page buffer loop
+	void firstPage(void);
+	uint8_t nextPage(void);
+	void clearBuffer(void);
+	void sendBuffer(void);
+	void setBufferCurrTileRow(uint8_t row) { u8g2.tile_curr_row = row; }
+	uint8_t getBufferCurrTileRow(void) { return u8g2.tile_curr_row; }
+	uint8_t getBufferTileHeight(void) { return u8g2.tile_buf_height; }
+	uint8_t* getBufferPtr(void) { return u8g2.buffer; }
+
+	// drawing, only the cursor is tracked
+	void setFont(const uint8_t* f) { font = f; }
+	void setFontMode(uint8_t is_transparent) { (void) is_transparent; }
+	void setDrawColor(uint8_t color) { (void) color; }
+	void setCursor(int16_t x, int16_t y) { tx = x; ty = y; }
+	int16_t getCursorX(void) { return tx; }
+	uint8_t getMaxCharHeight(void) { return font ? font[1] : 0; }
+	uint16_t getStrWidth(const char* s) { return font ? font[0] * strlen(s) : 0; }
+	uint16_t drawStr(int16_t x, int16_t y, const char* s);
+	void drawBox(int16_t x, int16_t y, int16_t w, int16_t h) { (void) x; (void) y; (void) w; (void) h; }
+	void drawFrame(int16_t x, int16_t y, int16_t w, int16_t h) { (void) x; (void) y; (void) w; (void) h; }
+	void drawHLine(int16_t x, int16_t y, int16_t w) { (void) x; (void) y; (void) w; }
+	void drawPixel(int16_t x, int16_t y) { (void) x; (void) y; }
+	virtual size_t write(uint8_t c);
+	using Print::write;
+
+	// simulation
+	static uint32_t pageRenderTime;               // modelled CPU time to rasterize one page, µs
+	static void (*pageHook)(bool begin);           // called around clearBuffer()..sendBuffer() of each page
+	static uint32_t bytesSent;                     // through the byte callback, all instances
+	uint32_t frames;
+	uint32_t tileRowsSent;
+
+protected:
+	u8g2_t u8g2;
+
+private:
+	void sendTileRow(uint8_t row);
+	void transfer(const uint8_t* data, uint8_t length);
+	const uint8_t* font;
+	int16_t tx, ty;
+};
+
+// same switch as U8x8lib.h, to build without Wire
+#ifndef U8X8_NO_HW_I2C
+class U8G2_SH1106_128X64_NONAME_1_HW_I2C : public U8G2 {
+public:
+	U8G2_SH1106_128X64_NONAME_1_HW_I2C(const u8g2_cb_t* rotation) {
+		u8g2_Setup_sh1106_i2c_128x64_noname_1(&u8g2, rotation, u8x8_byte_arduino_hw_i2c, u8x8_gpio_and_delay_arduino);
+	}
+};
+
+class U8G2_SH1106_128X64_NONAME_2_HW_I2C : public U8G2 {
+public:
+	U8G2_SH1106_128X64_NONAME_2_HW_I2C(const u8g2_cb_t* rotation) {
+		u8g2_Setup_sh1106_i2c_128x64_noname_2(&u8g2, rotation, u8x8_byte_arduino_hw_i2c, u8x8_gpio_and_delay_arduino);
+	}
+};
+
+#endif // U8X8_NO_HW_I2C
+
+#endif // _SIM_U8G2LIB_H_
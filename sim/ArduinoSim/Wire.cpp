@@ -0,0 +1,117 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include <Wire.h>
+
+#include "sim.h"
+
+TwoWire Wire;
+
+TwoWire::TwoWire() :
+	clock(100000),
+	txAddress(0),
+	txLength(0),
+	rxIndex(0),
+	rxLength(0)
+{
+}
+
+void TwoWire::begin(void)
+{
+	clock = 100000;
+}
+
+void TwoWire::end(void)
+{
+}
+
+void TwoWire::setClock(uint32_t c)
+{
+	clock = c;
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+	txAddress = address;
+	txLength = 0;
+}
+
+/**
+ * Blocking write: returns 0 on success, 2 on address NACK (as the AVR core)
+ */
+uint8_t TwoWire::endTransmission(bool sendStop)
+{
+	(void) sendStop;
+	uint32_t t = sim::transferTime(txLength, clock);
+	sim::bus.transactions++;
+	sim::bus.bytes += txLength + 1;
+	sim::bus.busyTime += t;
+	sim::I2CDevice* device = sim::findDevice(txAddress);
+	bool ack = false;
+	if (device != NULL) {
+		device->transactions++;
+		device->bytes += txLength;
+		ack = device->receive(txBuffer, txLength);
+	}
+	txLength = 0;
+	sim::advance(t);
+	return ack ? 0 : 2;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, bool sendStop)
+{
+	(void) sendStop;
+	if (quantity > BUFFER_LENGTH) quantity = BUFFER_LENGTH;
+	uint32_t t = sim::transferTime(quantity, clock);
+	sim::bus.transactions++;
+	sim::bus.bytes += quantity + 1;
+	sim::bus.busyTime += t;
+	rxIndex = 0;
+	rxLength = 0;
+	sim::I2CDevice* device = sim::findDevice(address);
+	if (device != NULL) {
+		device->transactions++;
+		device->bytes += quantity;
+		device->transmit(rxBuffer, quantity);
+		rxLength = quantity;
+	}
+	sim::advance(t);
+	return rxLength;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+	if (txLength >= BUFFER_LENGTH) return 0;
+	txBuffer[txLength++] = data;
+	return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t quantity)
+{
+	size_t n = 0;
+	while (n < quantity && write(data[n])) n++;
+	return n;
+}
+
+int TwoWire::available(void)
+{
+	return rxLength - rxIndex;
+}
+
+int TwoWire::read(void)
+{
+	return rxIndex < rxLength ? rxBuffer[rxIndex++] : -1;
+}
+
+int TwoWire::peek(void)
+{
+	return rxIndex < rxLength ? rxBuffer[rxIndex] : -1;
+}
@@ -0,0 +1,52 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ * Blocking TwoWire stand-in, transactions are routed to sim::I2CDevice
+ * instances and the virtual clock advances by the time the bus is busy.
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#ifndef _SIM_WIRE_H_
+#define _SIM_WIRE_H_
+
+#include <Arduino.h>
+
+#define BUFFER_LENGTH 32
+
+class TwoWire : public Print {
+public:
+	TwoWire();
+	void begin(void);
+	void end(void);
+	void setClock(uint32_t clock);
+	uint32_t getClock(void) { return clock; }
+	void beginTransmission(uint8_t address);
+	void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+	uint8_t endTransmission(bool sendStop = true);
+	uint8_t requestFrom(uint8_t address, uint8_t quantity, bool sendStop = true);
+	uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t)address, (uint8_t)quantity); }
+	virtual size_t write(uint8_t data);
+	virtual size_t write(const uint8_t* data, size_t quantity);
+	using Print::write;
+	int available(void);
+	int read(void);
+	int peek(void);
+
+private:
+	uint32_t clock;
+	uint8_t txAddress;
+	uint8_t txBuffer[BUFFER_LENGTH];
+	uint8_t txLength;
+	uint8_t rxBuffer[BUFFER_LENGTH];
+	uint8_t rxIndex;
+	uint8_t rxLength;
+};
+
+extern TwoWire Wire;
+
+#endif // _SIM_WIRE_H_
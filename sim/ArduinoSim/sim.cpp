@@ -0,0 +1,245 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include "sim.h"
+
+#include <Arduino.h>
+
+volatile uint8_t PCICR = 0;
+volatile uint8_t PCIFR = 0;
+volatile uint8_t PCMSK0 = 0;
+volatile uint8_t PCMSK1 = 0;
+volatile uint8_t PCMSK2 = 0;
+
+// default vectors, overridden by the firmware ISR() definitions
+extern "C" {
+__attribute__((weak)) void PCINT0_vect(void) {}
+__attribute__((weak)) void PCINT1_vect(void) {}
+__attribute__((weak)) void PCINT2_vect(void) {}
+}
+
+// entering a pin change vector clears its flag, like the hardware does
+static void pcint0(void) { PCIFR &= ~_BV(PCIF0); PCINT0_vect(); }
+static void pcint1(void) { PCIFR &= ~_BV(PCIF1); PCINT1_vect(); }
+static void pcint2(void) { PCIFR &= ~_BV(PCIF2); PCINT2_vect(); }
+
+namespace sim {
+
+static uint64_t clock_us = 0;
+static Ticker* tickers = NULL;
+static I2CDevice* devices = NULL;
+
+static bool irqEnabled = true;
+static bool inIsr = false;
+static const uint8_t MAX_PENDING = 16;
+static isr_t pending[MAX_PENDING];
+static uint8_t nPending = 0;
+
+static uint8_t pins[SIM_NUM_PINS];
+static uint16_t analog[SIM_NUM_PINS];
+
+struct ExtInterrupt {
+	isr_t isr;
+	int mode;
+};
+static ExtInterrupt extInterrupts[2];
+
+ToneStats tones = {0, 0, 0};
+void (*powerLoss)(void) = NULL;
+BusStats bus = {0, 0, 0};
+
+uint64_t now()
+{
+	return clock_us;
+}
+
+void advanceTo(uint64_t t)
+{
+	for (;;) {
+		Ticker* first = NULL;
+		uint64_t when = SIM_NO_EVENT;
+		for (Ticker* k = tickers; k != NULL; k = k->next) {
+			uint64_t e = k->nextEvent();
+			if (e < when) {
+				when = e;
+				first = k;
+			}
+		}
+		if (first == NULL || when > t) break;
+		if (when > clock_us) clock_us = when;
+		first->fire(clock_us);
+	}
+	if (t > clock_us) clock_us = t;
+}
+
+void warpTo(uint64_t t)
+{
+	if (t > clock_us) clock_us = t;
+}
+
+void advance(uint64_t us)
+{
+	advanceTo(clock_us + us);
+}
+
+void idle()
+{
+	uint64_t when = SIM_NO_EVENT;
+	for (Ticker* k = tickers; k != NULL; k = k->next) {
+		uint64_t e = k->nextEvent();
+		if (e < when) when = e;
+	}
+	// nothing scheduled: let 1 ms go by
+	advanceTo(when != SIM_NO_EVENT ? when : clock_us + 1000);
+}
+
+Ticker::Ticker() : next(tickers)
+{
+	tickers = this;
+}
+
+Ticker::~Ticker()
+{
+	for (Ticker** k = &tickers; *k != NULL; k = &(*k)->next) {
+		if (*k == this) {
+			*k = next;
+			break;
+		}
+	}
+}
+
+void raiseInterrupt(isr_t isr)
+{
+	if (isr == NULL) return;
+	if (!irqEnabled || inIsr) {
+		if (nPending < MAX_PENDING) pending[nPending++] = isr;
+		return;
+	}
+	inIsr = true;
+	isr();
+	inIsr = false;
+	// ISRs raised while this one was running
+	while (nPending > 0 && irqEnabled) {
+		isr_t p = pending[0];
+		for (uint8_t i = 1; i < nPending; i++) pending[i - 1] = pending[i];
+		nPending--;
+		inIsr = true;
+		p();
+		inIsr = false;
+	}
+}
+
+void setInterruptsEnabled(bool enabled)
+{
+	irqEnabled = enabled;
+	if (enabled && !inIsr && nPending > 0) {
+		isr_t p = pending[0];
+		for (uint8_t i = 1; i < nPending; i++) pending[i - 1] = pending[i];
+		nPending--;
+		raiseInterrupt(p);
+	}
+}
+
+bool saveInterrupts()
+{
+	return irqEnabled;
+}
+
+bool interruptsEnabled()
+{
+	return irqEnabled && !inIsr;
+}
+
+void setPin(uint8_t pin, uint8_t level)
+{
+	if (pin >= SIM_NUM_PINS) return;
+	uint8_t prev = pins[pin];
+	pins[pin] = level ? HIGH : LOW;
+	if (prev == pins[pin]) return;
+	// pin change interrupt
+	uint8_t bank = digitalPinToPCICRbit(pin);
+	if ((PCICR & _BV(bank)) && (*digitalPinToPCMSK(pin) & _BV(digitalPinToPCMSKbit(pin)))) {
+		// one flag per vector: edges before the vector runs make one call
+		static const isr_t PCINT_VECTORS[] = {pcint0, pcint1, pcint2};
+		if (!(PCIFR & _BV(bank))) {
+			PCIFR |= _BV(bank);
+			raiseInterrupt(PCINT_VECTORS[bank]);
+		}
+	}
+	// external interrupt
+	int n = digitalPinToInterrupt(pin);
+	if (n < 0 || extInterrupts[n].isr == NULL) return;
+	int mode = extInterrupts[n].mode;
+	if (mode == CHANGE
+		|| (mode == RISING && pins[pin] == HIGH)
+		|| (mode == FALLING && pins[pin] == LOW)) {
+		raiseInterrupt(extInterrupts[n].isr);
+	}
+}
+
+uint8_t getPin(uint8_t pin)
+{
+	return pin < SIM_NUM_PINS ? pins[pin] : LOW;
+}
+
+void setAnalog(uint8_t pin, uint16_t value)
+{
+	if (pin < SIM_NUM_PINS) analog[pin] = value;
+}
+
+uint16_t getAnalog(uint8_t pin)
+{
+	return pin < SIM_NUM_PINS ? analog[pin] : 0;
+}
+
+void attachExtInterrupt(uint8_t n, isr_t isr, int mode)
+{
+	if (n < 2) {
+		extInterrupts[n].isr = isr;
+		extInterrupts[n].mode = mode;
+	}
+}
+
+I2CDevice::I2CDevice(uint8_t address) :
+	address(address),
+	transactions(0),
+	bytes(0),
+	next(devices)
+{
+	devices = this;
+}
+
+I2CDevice::~I2CDevice()
+{
+	for (I2CDevice** d = &devices; *d != NULL; d = &(*d)->next) {
+		if (*d == this) {
+			*d = next;
+			break;
+		}
+	}
+}
+
+I2CDevice* findDevice(uint8_t address)
+{
+	for (I2CDevice* d = devices; d != NULL; d = d->next) {
+		if (d->address == address) return d;
+	}
+	return NULL;
+}
+
+uint32_t transferTime(size_t length, uint32_t clock)
+{
+	// START + STOP ~ 2 clocks, address + data bytes are 8 bits + ACK
+	uint64_t clocks = 2 + 9 * (1 + (uint64_t)length);
+	return (uint32_t)((clocks * 1000000ull + clock - 1) / clock);
+}
+
+} // namespace sim
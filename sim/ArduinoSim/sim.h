@@ -0,0 +1,156 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ *
+ * Simulation kernel: virtual clock, timed events, GPIO and I2C bus model.
+ *
+ * Time only moves forward when the firmware blocks (delay(), I2C transfers)
+ * or when the simulation driver advances it between two loop() calls.
+ * Peripherals register themselves as Tickers and are fired in time order,
+ * which is how conversions complete and timer interrupts are delivered.
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SIM_NO_EVENT UINT64_MAX
+#define SIM_NUM_PINS 22
+
+namespace sim {
+
+/**
+ * Virtual clock, in µs since power-up
+ */
+uint64_t now();
+
+/**
+ * Advance the virtual clock, firing every event due in the meantime
+ */
+void advance(uint64_t us);
+void advanceTo(uint64_t t);
+
+/**
+ * Move the virtual clock forward without firing the events in between, as
+ * if the device had been idle, e.g. to test code around the millis() overflow
+ */
+void warpTo(uint64_t t);
+
+/**
+ * Advance the virtual clock to the next event, as a CPU waiting for an
+ * interrupt would do
+ */
+void idle();
+
+/**
+ * Anything that has to happen at a given virtual time
+ * (ADC conversion, timer overflow, scripted input...)
+ */
+class Ticker {
+public:
+	Ticker();
+	virtual ~Ticker();
+	virtual uint64_t nextEvent() = 0;  // SIM_NO_EVENT if idle
+	virtual void fire(uint64_t t) = 0;
+
+	Ticker* next;
+};
+
+/**
+ * Interrupt delivery: ISRs run immediately unless interrupts are
+ * disabled, in which case they are deferred until interrupts()
+ */
+typedef void (*isr_t)(void);
+void raiseInterrupt(isr_t isr);
+void setInterruptsEnabled(bool enabled);
+bool interruptsEnabled();
+bool saveInterrupts();  // global interrupt flag, as in SREG
+
+/**
+ * GPIO: external stimuli drive input pins, external interrupts
+ * attached with attachInterrupt() fire on the matching edges
+ */
+void setPin(uint8_t pin, uint8_t level);
+uint8_t getPin(uint8_t pin);
+void setAnalog(uint8_t pin, uint16_t value);
+uint16_t getAnalog(uint8_t pin);
+void attachExtInterrupt(uint8_t n, isr_t isr, int mode);
+
+/**
+ * Power loss, from the trace or the EEPROM model: the driver saves what
+ * survives and stops the simulation, it does not return
+ */
+extern void (*powerLoss)(void);
+
+/**
+ * Active buzzer log
+ */
+struct ToneStats {
+	uint32_t count;
+	uint16_t lastFrequency;
+	uint64_t lastTime;
+};
+extern ToneStats tones;
+
+/**
+ * AVR ADC, interrupt driven conversions (analogRead() not included)
+ */
+struct AdcStats {
+	uint32_t conversions;
+	uint32_t sleeps;     // in ADC noise reduction mode
+};
+extern AdcStats adc;
+
+/**
+ * CPU sleep, in any mode: the rest of the time the CPU is running
+ */
+struct PowerStats {
+	uint32_t sleeps;
+	uint64_t sleepTime;  // µs
+};
+extern PowerStats power;
+
+/**
+ * I2C slave device sitting on the simulated bus
+ */
+class I2CDevice {
+public:
+	I2CDevice(uint8_t address);
+	virtual ~I2CDevice();
+	// master write, return false to NACK
+	virtual bool receive(const uint8_t* data, size_t length) = 0;
+	// master read, fill data with length bytes
+	virtual void transmit(uint8_t* data, size_t length) = 0;
+
+	uint8_t address;
+	uint32_t transactions;
+	uint32_t bytes;
+	I2CDevice* next;
+};
+
+I2CDevice* findDevice(uint8_t address);
+
+/**
+ * Bus statistics and timing model
+ * A transaction costs START + address + data bytes (9 clocks each) + STOP
+ */
+struct BusStats {
+	uint32_t transactions;
+	uint32_t bytes;
+	uint64_t busyTime;  // µs
+};
+extern BusStats bus;
+
+uint32_t transferTime(size_t length, uint32_t clock);
+
+} // namespace sim
+
+#endif // _SIM_H_
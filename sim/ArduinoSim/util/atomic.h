@@ -0,0 +1,40 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ * avr-libc <util/atomic.h> stand-in
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#ifndef _SIM_UTIL_ATOMIC_H_
+#define _SIM_UTIL_ATOMIC_H_
+
+#include "../sim.h"
+
+#define ATOMIC_RESTORESTATE 1
+#define ATOMIC_FORCEON      2
+
+namespace sim {
+
+class AtomicGuard {
+public:
+	AtomicGuard(int type) : saved(type == ATOMIC_FORCEON ? true : saveInterrupts()), done(false) {
+		setInterruptsEnabled(false);
+	}
+	~AtomicGuard() { setInterruptsEnabled(saved); }
+	bool once() { bool first = !done; done = true; return first; }
+
+private:
+	bool saved;
+	bool done;
+};
+
+} // namespace sim
+
+#define ATOMIC_BLOCK(type) for (sim::AtomicGuard __atomic_guard(type); __atomic_guard.once(); )
+
+#endif // _SIM_UTIL_ATOMIC_H_
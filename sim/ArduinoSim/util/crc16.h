@@ -0,0 +1,38 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ * avr-libc <util/crc16.h> stand-in
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#ifndef _SIM_UTIL_CRC16_H_
+#define _SIM_UTIL_CRC16_H_
+
+#include <stdint.h>
+
+// CRC-CCITT, polynomial 0x1021, MSB first, as documented by avr-libc
+static inline uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data)
+{
+	crc ^= (uint16_t)data << 8;
+	for (uint8_t i = 0; i < 8; i++) {
+		crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+// CRC-8 CCITT, polynomial 0x07, MSB first, as documented by avr-libc
+static inline uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data)
+{
+	crc ^= data;
+	for (uint8_t i = 0; i < 8; i++) {
+		crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+	}
+	return crc;
+}
+
+#endif // _SIM_UTIL_CRC16_H_
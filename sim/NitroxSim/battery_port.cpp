@@ -0,0 +1,63 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ * AVR ADC port for the battery measurement: a conversion completes 13 ADC
+ * clocks (104 µs at 125 kHz) after it is started, with an interrupt.
+ * Sleeping in ADC noise reduction mode runs the clock to the next event,
+ * the clocks stopped meanwhile (timer 0, UART, TWI) are not modelled.
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+// port of src/battery.cpp, which the unit tests do not link
+#ifndef PIO_UNIT_TESTING
+
+#include <Arduino.h>
+
+#include "battery.h"
+#include "config.h"
+#include "sim.h"
+
+namespace {
+
+class AdcPort : public sim::Ticker {
+public:
+	AdcPort() : due(SIM_NO_EVENT) {}
+	virtual uint64_t nextEvent() { return due; }
+	virtual void fire(uint64_t t) { (void) t; due = SIM_NO_EVENT; sim::raiseInterrupt(isr); }
+	static void isr() { batteryConversion(sim::getAnalog(BATTERY_PIN)); }
+
+	uint64_t due;
+	static AdcPort port;
+};
+
+AdcPort AdcPort::port;
+
+} // namespace
+
+sim::AdcStats sim::adc = {0, 0};
+
+void batteryPortBegin()
+{
+}
+
+void batteryPortStart(bool sleep)
+{
+	AdcPort& port = AdcPort::port;
+	port.due = sim::now() + 104;
+	sim::adc.conversions++;
+	if (sleep) {
+		sim::adc.sleeps++;
+		// until the conversion, or an earlier interrupt
+		uint64_t start = sim::now();
+		sim::idle();
+		sim::power.sleeps++;
+		sim::power.sleepTime += sim::now() - start;
+	}
+}
+
+#endif // PIO_UNIT_TESTING
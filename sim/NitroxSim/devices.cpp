@@ -0,0 +1,388 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include "devices.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <ADS1115.h>
+#include <Arduino.h>
+
+namespace sim {
+
+// full scale range, index is PGA bits
+static const int64_t ADS_LSB_PNV[8] = {  // pV per LSB
+	187500000, 125000000, 62500000, 31250000, 15625000, 7812500, 7812500, 7812500
+};
+static const uint16_t ADS_RATES[8] = {8, 16, 32, 64, 128, 250, 475, 860};
+// input referred noise at +/-0.256V FSR, nV rms (datasheet table 1)
+static const uint32_t ADS_NOISE_NV[8] = {620, 780, 1100, 1400, 1900, 2800, 4400, 7500};
+
+static double gaussian(uint32_t& seed)
+{
+	// xorshift32 + Box-Muller, deterministic from run to run
+	double u[2];
+	for (uint8_t i = 0; i < 2; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		u[i] = (seed + 1.0) / 4294967297.0;
+	}
+	return sqrt(-2.0 * log(u[0])) * cos(2.0 * M_PI * u[1]);
+}
+
+Ads1115Model::Ads1115Model(uint8_t address) :
+	I2CDevice(address),
+	input(NULL),
+	noise(true),
+	alertPin(-1),
+	pointer(0),
+	config(0x8583),
+	converting(0x8583),
+	lowThreshold(0x8000),
+	highThreshold(0x7FFF),
+	conversion(0),
+	due(SIM_NO_EVENT),
+	conversions(0),
+	convertingTime(0),
+	conversionReads(0),
+	configReads(0),
+	pointerWrites(0),
+	collected(0),
+	dropped(0),
+	duplicated(0),
+	alerts(0),
+	comparatorAlerts(0),
+	latencyTotal(0),
+	latencyMax(0),
+	alertRelease(SIM_NO_EVENT),
+	outOfRange(0),
+	comparatorActive(false),
+	lastRead(0),
+	lastConversion(0),
+	seed(0x2095)
+{
+}
+
+uint32_t Ads1115Model::conversionTime() const
+{
+	return 1000000ul / ADS_RATES[(config & ADS1115_REG_CONFIG_DR_MASK) >> 5];
+}
+
+bool Ads1115Model::conversionReadyMode() const
+{
+	return (highThreshold & 0x8000) && !(lowThreshold & 0x8000)
+		&& (config & ADS1115_REG_CONFIG_CQUE_MASK) != ADS1115_REG_CONFIG_CQUE_NONE;
+}
+
+bool Ads1115Model::comparatorMode() const
+{
+	return !conversionReadyMode()
+		&& (config & ADS1115_REG_CONFIG_CQUE_MASK) != ADS1115_REG_CONFIG_CQUE_NONE;
+}
+
+// comparator, after each conversion
+void Ads1115Model::compare()
+{
+	int16_t low = (int16_t)lowThreshold;
+	int16_t high = (int16_t)highThreshold;
+	bool window = (config & ADS1115_REG_CONFIG_CMODE_MASK) == ADS1115_REG_CONFIG_CMODE_WINDOW;
+	bool latching = (config & ADS1115_REG_CONFIG_CLAT_MASK) == ADS1115_REG_CONFIG_CLAT_LATCH;
+	bool beyond = conversion > high || (window && conversion < low);
+	outOfRange = beyond ? outOfRange + 1 : 0;
+	uint8_t queue = 1 << (config & ADS1115_REG_CONFIG_CQUE_MASK);
+	if (!comparatorActive && outOfRange >= queue) {
+		comparatorActive = true;
+		comparatorAlerts++;
+		setAlert(true);
+	}
+	else if (comparatorActive && !latching && (window ? !beyond : conversion < low)) {
+		comparatorActive = false;
+		setAlert(false);
+	}
+}
+
+void Ads1115Model::setAlert(bool active)
+{
+	if (alertPin < 0) return;
+	bool activeHigh = (config & ADS1115_REG_CONFIG_CPOL_MASK) == ADS1115_REG_CONFIG_CPOL_ACTVHI;
+	setPin(alertPin, active == activeHigh ? HIGH : LOW);
+}
+
+bool Ads1115Model::receive(const uint8_t* data, size_t length)
+{
+	if (length == 0) return true;
+	pointer = data[0] & ADS1115_REG_POINTER_MASK;
+	if (length == 1) {
+		pointerWrites++;
+	}
+	else if (length >= 3) {
+		writeRegister(pointer, ((uint16_t)data[1] << 8) | data[2]);
+	}
+	return true;
+}
+
+void Ads1115Model::transmit(uint8_t* data, size_t length)
+{
+	uint16_t value;
+	switch (pointer) {
+	case ADS1115_REG_POINTER_CONVERT:
+		conversionReads++;
+		if (conversions == lastRead) {
+			if (conversions > 0) duplicated++;
+		}
+		else {
+			collected++;
+			dropped += conversions - lastRead - 1;
+			lastRead = conversions;
+			uint32_t latency = (uint32_t)(now() - lastConversion);
+			latencyTotal += latency;
+			if (latency > latencyMax) latencyMax = latency;
+		}
+		value = (uint16_t)conversion;
+		if (comparatorActive && (config & ADS1115_REG_CONFIG_CLAT_MASK) == ADS1115_REG_CONFIG_CLAT_LATCH) {
+			// the read releases a latched comparator
+			comparatorActive = false;
+			outOfRange = 0;
+			setAlert(false);
+		}
+		break;
+	case ADS1115_REG_POINTER_CONFIG:
+		configReads++;
+		value = config & ~ADS1115_REG_CONFIG_OS_MASK;
+		if ((config & ADS1115_REG_CONFIG_MODE_MASK) == ADS1115_REG_CONFIG_MODE_SINGLE
+			&& due == SIM_NO_EVENT) {
+			value |= ADS1115_REG_CONFIG_OS_NOTBUSY;
+		}
+		break;
+	case ADS1115_REG_POINTER_LOWTHRESH:
+		value = lowThreshold;
+		break;
+	default:
+		value = highThreshold;
+	}
+	for (size_t i = 0; i < length; i++) {
+		data[i] = (i == 0) ? (uint8_t)(value >> 8) : (i == 1) ? (uint8_t)value : 0xFF;
+	}
+}
+
+void Ads1115Model::writeRegister(uint8_t reg, uint16_t value)
+{
+	switch (reg) {
+	case ADS1115_REG_POINTER_CONFIG: {
+		bool running = (config & ADS1115_REG_CONFIG_MODE_MASK) == ADS1115_REG_CONFIG_MODE_CONTIN
+			&& due != SIM_NO_EVENT;
+		config = value & ~ADS1115_REG_CONFIG_OS_MASK;
+		// the comparator starts over, deasserted
+		outOfRange = 0;
+		if (comparatorActive || !conversionReadyMode()) setAlert(false);
+		comparatorActive = false;
+		if ((config & ADS1115_REG_CONFIG_MODE_MASK) == ADS1115_REG_CONFIG_MODE_CONTIN) {
+			// the conversion in progress completes with the previous settings,
+			// the new ones apply from the next one
+			if (!running) {
+				converting = config;
+				due = now() + conversionTime();
+			}
+		}
+		else if (value & ADS1115_REG_CONFIG_OS_SINGLE) {
+			if (due == SIM_NO_EVENT) {
+				converting = config;
+				due = now() + conversionTime();
+			}
+			if (conversionReadyMode()) setAlert(false);
+		}
+		else {
+			due = SIM_NO_EVENT;
+		}
+		break;
+	}
+	case ADS1115_REG_POINTER_LOWTHRESH:
+		lowThreshold = value;
+		break;
+	case ADS1115_REG_POINTER_HITHRESH:
+		highThreshold = value;
+		break;
+	default:
+		// conversion register is read-only
+		break;
+	}
+}
+
+int16_t Ads1115Model::sample(uint64_t t)
+{
+	int64_t nv = input ? input(converting & ADS1115_REG_CONFIG_MUX_MASK, t) : 0;
+	uint8_t pga = (converting & ADS1115_REG_CONFIG_PGA_MASK) >> 9;
+	uint8_t dr = (converting & ADS1115_REG_CONFIG_DR_MASK) >> 5;
+	if (noise) {
+		nv += (int64_t)llround(gaussian(seed) * ADS_NOISE_NV[dr]);
+	}
+	int64_t counts = nv * 1000 / ADS_LSB_PNV[pga];
+	if (counts > 32767) counts = 32767;
+	if (counts < -32768) counts = -32768;
+	return (int16_t)counts;
+}
+
+uint64_t Ads1115Model::nextEvent()
+{
+	return due < alertRelease ? due : alertRelease;
+}
+
+void Ads1115Model::fire(uint64_t t)
+{
+	if (alertRelease <= t) {
+		alertRelease = SIM_NO_EVENT;
+		setAlert(false);
+		if (due > t) return;
+	}
+	conversion = sample(t);
+	conversions++;
+	convertingTime += 1000000ul / ADS_RATES[(converting & ADS1115_REG_CONFIG_DR_MASK) >> 5];
+	lastConversion = t;
+	if ((config & ADS1115_REG_CONFIG_MODE_MASK) == ADS1115_REG_CONFIG_MODE_CONTIN) {
+		converting = config;
+		due = t + conversionTime();
+	}
+	else {
+		due = SIM_NO_EVENT;  // back to power-down
+	}
+	if (conversionReadyMode()) {
+		alerts++;
+		// the end of the pulse is due before the interrupt sees its start
+		if (due != SIM_NO_EVENT) alertRelease = t + 8;
+		setAlert(true);
+	}
+	else if (comparatorMode()) {
+		compare();
+	}
+}
+
+Sh1106Model::Sh1106Model(uint8_t address) :
+	I2CDevice(address),
+	commandBytes(0),
+	dataBytes(0),
+	contrast(0xCF),  // U8g2 init sequence
+	on(false)
+{
+}
+
+bool Sh1106Model::receive(const uint8_t* data, size_t length)
+{
+	if (length == 0) return true;
+	if (data[0] & 0x40) {
+		dataBytes += length - 1;
+		return true;
+	}
+	commandBytes += length - 1;
+	if (length == 3 && data[1] == 0x81) {
+		contrast = data[2];
+	}
+	else if (length == 2 && (data[1] & 0xFE) == 0xAE) {
+		on = data[1] & 0x01;
+	}
+	return true;
+}
+
+void Sh1106Model::transmit(uint8_t* data, size_t length)
+{
+	memset(data, 0, length);
+}
+
+static const uint32_t KNOB_PRESS = 100000;  // µs, a click
+static const uint32_t KNOB_STEP = 5000;     // µs, between quadrature steps
+// contact chatter, % of the bounce time: alternating levels, the last one stays
+static const uint8_t KNOB_BOUNCE[] = {0, 10, 15, 35, 40, 70, 100};
+
+KnobModel::KnobModel(uint8_t pinA, uint8_t pinB, uint8_t pinButton) :
+	bounce(0),
+	quadratureEdges(0),
+	buttonEdges(0),
+	pinA(pinA),
+	pinB(pinB),
+	pinButton(pinButton),
+	busyUntil(0)
+{
+}
+
+void KnobModel::begin()
+{
+	setPin(pinA, HIGH);
+	setPin(pinB, HIGH);
+	setPin(pinButton, HIGH);
+}
+
+uint64_t KnobModel::start()
+{
+	return busyUntil > now() ? busyUntil : now();
+}
+
+void KnobModel::contact(uint64_t t, uint8_t pin, uint8_t level)
+{
+	uint8_t n = bounce > 0 ? sizeof(KNOB_BOUNCE) : 1;
+	for (uint8_t i = 0; i < n; i++) {
+		uint8_t l = ((n - 1 - i) & 1) ? !level : level;
+		edges.insert(std::make_pair(t + (uint64_t)bounce * KNOB_BOUNCE[i] / 100, std::make_pair(pin, l)));
+	}
+	if (t + bounce > busyUntil) busyUntil = t + bounce;
+}
+
+void KnobModel::press(uint32_t ms)
+{
+	uint64_t t = start();
+	contact(t, pinButton, LOW);
+	contact(t + (uint64_t)ms * 1000, pinButton, HIGH);
+}
+
+void KnobModel::click()
+{
+	press(KNOB_PRESS / 1000);
+}
+
+void KnobModel::doubleClick()
+{
+	press(KNOB_PRESS / 1000);
+	busyUntil += KNOB_PRESS;
+	press(KNOB_PRESS / 1000);
+}
+
+void KnobModel::turn(int16_t notches)
+{
+	// clockwise: B falls first, A B = 11 -> 10 -> 00 -> 01 -> 11
+	uint8_t first = notches > 0 ? pinB : pinA;
+	uint8_t second = notches > 0 ? pinA : pinB;
+	uint64_t t = start();
+	for (int16_t i = 0; i < abs(notches); i++) {
+		contact(t, first, LOW);
+		contact(t + KNOB_STEP, second, LOW);
+		contact(t + 2 * KNOB_STEP, first, HIGH);
+		contact(t + 3 * KNOB_STEP, second, HIGH);
+		t += 4 * KNOB_STEP;
+	}
+}
+
+uint64_t KnobModel::nextEvent()
+{
+	return edges.empty() ? SIM_NO_EVENT : edges.begin()->first;
+}
+
+void KnobModel::fire(uint64_t t)
+{
+	(void) t;
+	std::pair<uint8_t, uint8_t> e = edges.begin()->second;
+	edges.erase(edges.begin());
+	if (getPin(e.first) == e.second) return;
+	if (e.first == pinButton) buttonEdges++;
+	else quadratureEdges++;
+	setPin(e.first, e.second);
+}
+
+} // namespace sim
@@ -0,0 +1,162 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ *
+ * Register level models of the I2C chips on the analyzer board, and of the
+ * rotary encoder contacts
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#ifndef _SIM_DEVICES_H_
+#define _SIM_DEVICES_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <utility>
+
+#include "sim.h"
+
+namespace sim {
+
+/**
+ * ADS1115 16-bit ADC
+ *
+ * Conversions complete every 1/DR in continuous mode, or once per OS write
+ * in single-shot mode. The analog input is provided by a callback returning
+ * the differential voltage seen by the selected MUX, in nV.
+ * Intrinsic ADC noise follows the datasheet figures for the selected rate.
+ *
+ * When the thresholds select the conversion-ready function, the ALERT/RDY
+ * pin (open drain, pulled up) is driven on alertPin: a ~8µs pulse after each
+ * conversion in continuous mode, asserted until the next start in single-shot.
+ * Otherwise, unless CQUE disables it, the pin is the comparator output:
+ * traditional (above Hi_thresh, released below Lo_thresh) or window (outside
+ * of the thresholds), after 1, 2 or 4 conversions in a row, latched until
+ * the CONVERSION register is read or following the input. A CONFIG write
+ * restarts the comparator. In continuous mode, the conversion in progress
+ * completes with the settings it started with (MUX, PGA, DR), the written
+ * ones apply from the next conversion on.
+ *
+ * Every conversion is numbered, reads of the CONVERSION register are checked
+ * against it to count samples collected, dropped (never read) and duplicated
+ * (read more than once).
+ */
+class Ads1115Model : public I2CDevice, public Ticker {
+public:
+	typedef int64_t (*input_t)(uint16_t mux, uint64_t t);
+
+	Ads1115Model(uint8_t address = 0x48);
+
+	virtual bool receive(const uint8_t* data, size_t length);
+	virtual void transmit(uint8_t* data, size_t length);
+	virtual uint64_t nextEvent();
+	virtual void fire(uint64_t t);
+
+	uint32_t conversionTime() const;
+	bool conversionReadyMode() const;
+	bool comparatorMode() const;
+
+	input_t input;
+	bool noise;
+	int8_t alertPin;
+
+	uint8_t pointer;
+	uint16_t config;
+	uint16_t converting;        // config the conversion in progress started with
+	uint16_t lowThreshold;
+	uint16_t highThreshold;
+	int16_t conversion;
+
+	uint64_t due;
+	uint32_t conversions;       // number of completed conversions
+	uint64_t convertingTime;    // spent converting by those, µs
+	uint32_t conversionReads;   // reads of the CONVERSION register
+	uint32_t configReads;       // reads of the CONFIG register
+	uint32_t pointerWrites;     // pointer-only writes
+	uint32_t collected;         // conversions read exactly once...
+	uint32_t dropped;           // ...never read
+	uint32_t duplicated;        // ...or read again
+	uint32_t alerts;            // conversion-ready pulses
+	uint32_t comparatorAlerts;  // comparator assertions
+	uint64_t latencyTotal;      // conversion end -> first read, µs
+	uint32_t latencyMax;
+
+private:
+	void writeRegister(uint8_t reg, uint16_t value);
+	void setAlert(bool active);
+	void compare();
+	uint64_t alertRelease;
+	uint8_t outOfRange;         // conversions in a row beyond the thresholds
+	bool comparatorActive;
+	uint32_t lastRead;
+	uint64_t lastConversion;
+	int16_t sample(uint64_t t);
+	uint32_t seed;
+};
+
+/**
+ * SH1106 OLED controller, counts traffic and follows the contrast and
+ * display on/off commands (sent alone in a transfer, as U8g2 does)
+ */
+class Sh1106Model : public I2CDevice {
+public:
+	Sh1106Model(uint8_t address = 0x3C);
+
+	virtual bool receive(const uint8_t* data, size_t length);
+	virtual void transmit(uint8_t* data, size_t length);
+
+	uint32_t commandBytes;
+	uint32_t dataBytes;
+	uint8_t contrast;
+	bool on;
+};
+
+/**
+ * Rotary encoder with push button, contacts to ground on the A, B and
+ * button pins (pulled up)
+ *
+ * Actions are played one after the other, from the time they are asked
+ * for or the end of the previous one: a click is a 100 ms press, a double
+ * click two of them 100 ms apart, a notch 4 quadrature steps 5 ms apart,
+ * B leading A when turning clockwise. With a bounce time, every contact
+ * change chatters: 7 edges over that time, ending on the new level.
+ */
+class KnobModel : public Ticker {
+public:
+	KnobModel(uint8_t pinA, uint8_t pinB, uint8_t pinButton);
+
+	// contacts open, before setup()
+	void begin();
+
+	void click();
+	void doubleClick();
+	void press(uint32_t ms);
+	void turn(int16_t notches);
+
+	virtual uint64_t nextEvent();
+	virtual void fire(uint64_t t);
+
+	uint32_t bounce;             // µs
+	uint32_t quadratureEdges;    // on A and B
+	uint32_t buttonEdges;
+
+private:
+	void contact(uint64_t t, uint8_t pin, uint8_t level);
+	uint64_t start();
+
+	uint8_t pinA;
+	uint8_t pinB;
+	uint8_t pinButton;
+	uint64_t busyUntil;
+	std::multimap<uint64_t, std::pair<uint8_t, uint8_t> > edges;  // time -> pin, level
+};
+
+} // namespace sim
+
+#endif // _SIM_DEVICES_H_
@@ -0,0 +1,29 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ * AVR sleep port: idle mode runs the clock to the next event, every
+ * interrupt source of the simulation being a Ticker.
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include "power.h"
+#include "sim.h"
+
+sim::PowerStats sim::power = {0, 0};
+
+void powerPortBegin()
+{
+}
+
+void powerPortSleep()
+{
+	uint64_t start = sim::now();
+	sim::idle();
+	sim::power.sleeps++;
+	sim::power.sleepTime += sim::now() - start;
+}
@@ -0,0 +1,661 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ *
+ * Simulation driver: runs the unmodified setup()/loop() against a scripted
+ * sensor trace and reports how fast the firmware loop runs.
+ *
+ * With -g, what the screen shows is logged each time it changes, to be
+ * compared with the golden files of sim/golden/ (see sim/golden.sh).
+ * With -e, the EEPROM content is loaded from an image file and saved back
+ * at the end, or on a power loss: several runs make successive boots.
+ *
+ * Two time bases are reported:
+ * - virtual time, as seen by the firmware through millis()/micros(). It
+ *   includes blocking I2C transfers at the configured bus clock plus the
+ *   modelled AVR CPU cost of a loop() pass and of a rendered page.
+ * - host time, measured around the same calls. Only useful to compare two
+ *   builds of the firmware on the same machine.
+ *
+ * The supply current is integrated over virtual time from a model of the
+ * parts (CPU running or asleep, ADS1115 converting, OLED contrast), giving
+ * the energy of an analysis and the battery life, see sim/README.md.
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+// the unit tests (pio test -e native) link the sim libraries without the
+// firmware, and bring their own main()
+#ifndef PIO_UNIT_TESTING
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <math.h>
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <U8g2lib.h>
+
+#include "devices.h"
+#include "sim.h"
+#include "trace.h"
+
+#include "acquisition.h"
+#include "calibration.h"
+#include "config.h"
+#include "profile.h"
+#include "state.h"
+#include "tasks.h"
+
+void setup();
+void loop();
+
+extern int16_t oxygenConcentration;
+extern int16_t displayConcentration;
+extern calibration_model_t calibrationModel[CELL_COUNT];
+extern Calibration calibration[CELL_COUNT];
+extern calibration_status_t calibrationStatus;
+extern uint8_t calibrationCell;
+extern uint8_t cellSuspects;
+#ifdef BATCH_ENABLE
+extern uint16_t batchLogged;
+#endif
+extern state_dialog_t stateCalibMenu;
+extern int16_t batteryVoltage;
+extern bool batteryWarning;
+extern uint8_t batteryCharge;
+extern bool predicting;
+extern uint8_t predictionConfidence;
+extern char displayFooterBuffer[];
+
+namespace {
+
+typedef std::chrono::steady_clock host_clock;
+
+const char* const TASK_NAMES[] = {
+	"sampling",
+	"battery",
+	"splash",
+	"refresh",
+	"calibration",
+	"render",
+	"dim",
+};
+static_assert(sizeof(TASK_NAMES) / sizeof(TASK_NAMES[0]) == TASK_COUNT, "one name per task");
+
+const char* const STATE_NAMES[] = {
+	"START_SCREEN",
+	"ANALYZE",
+	"HOLD",
+	"CALIBRATE_MENU",
+	"CALIBRATE",
+	"ERROR",
+};
+const uint8_t NUM_STATES = sizeof(STATE_NAMES) / sizeof(STATE_NAMES[0]);
+
+struct Section {
+	uint32_t count;
+	uint64_t virtualTime;  // µs
+	uint64_t hostTime;     // ns
+	uint64_t virtualMax;
+};
+
+sim::Trace trace;
+sim::Ads1115Model ads1115;
+sim::Sh1106Model sh1106;
+sim::KnobModel knob(ENC_PIN_A, ENC_PIN_B, ENC_PIN_SW);
+
+Section states[NUM_STATES];
+Section render;
+uint64_t renderBytes;
+uint64_t renderPages;
+
+// pages rendered during the current loop() pass, form one frame
+struct Frame {
+	uint32_t pages;
+	uint64_t virtualTime;
+	uint64_t hostTime;
+	uint32_t bytes;
+	uint64_t virtualStart;
+	host_clock::time_point hostStart;
+} frame = {};
+
+// O2 readout while analyzing, every READOUT_PERIOD
+const uint32_t READOUT_PERIOD = 10000;        // µs
+const uint32_t READOUT_STEADY = 5000000;      // tail of the trace used as final value, µs
+const int16_t READOUT_TOLERANCE = 10;         // settled within +/-0.1% O2
+std::vector<std::pair<uint64_t, int16_t> > readout;
+std::vector<std::pair<uint64_t, int16_t> > shown;  // displayed value, measured or predicted
+uint64_t nextReadout;
+
+// first ANALYZE -> HOLD after the last sensor change
+uint64_t holdTime = 0;
+int16_t holdValue;
+
+// supply current model at 3.3 V, µA
+const double CPU_ACTIVE_UA = 2700;     // ATmega328P at 8 MHz
+const double CPU_SLEEP_UA = 700;       // idle mode, ADC noise reduction is close
+const double ADS_ACTIVE_UA = 150;      // converting, 0.5 µA powered down
+const double OLED_BASE_UA = 400;       // SH1106 with ~15 % of the pixels lit...
+const double OLED_CONTRAST_UA = 7000;  // ...plus this at contrast 255
+const double SUPPLY_VOLTS = 3.3;
+const double BATTERY_MAH = 1000;
+
+// charge drawn since power-up, µC
+struct Charge {
+	double cpu;
+	double ads;
+	double display;
+	double total() const { return cpu + ads + display; }
+} charge = {};
+double chargeAtChange = -1;  // at the last sensor change
+double chargeAtHold;
+uint64_t dimmedTime = 0;
+uint64_t samplingTime = 0;   // with the ADC delivering samples, for the rate per cell
+
+// integrate the supply current over the last loop() pass
+void recordCharge(uint64_t duration, uint64_t sleepTime, uint64_t convertingTime, uint8_t contrast)
+{
+	charge.cpu += ((duration - sleepTime) * CPU_ACTIVE_UA + sleepTime * CPU_SLEEP_UA) / 1e6;
+	charge.ads += convertingTime * ADS_ACTIVE_UA / 1e6;
+	if (sh1106.on) {
+		charge.display += duration * (OLED_BASE_UA + OLED_CONTRAST_UA * contrast / 255) / 1e6;
+		if (contrast != DISPLAY_CONTRAST) dimmedTime += duration;
+	}
+	if (chargeAtChange < 0 && sim::now() >= trace.lastSensorChange()) chargeAtChange = charge.total();
+}
+
+// calibrations: start, duration, outcome
+struct CalibrationRun {
+	uint64_t start;
+	uint64_t duration;
+	state_t next;
+	calibration_status_t status;
+	calibration_gas_t gas;
+	calibration_model_t model;
+};
+std::vector<CalibrationRun> calibrations;
+
+// logged by an automatic HOLD
+struct BatchCylinder {
+	uint16_t number;
+	uint64_t change;  // gas change before it
+	uint64_t saved;
+};
+std::vector<BatchCylinder> cylinders;
+
+void recordReadout()
+{
+	static state_t previous = state;
+	if (previous != STATE_CALIBRATE && state == STATE_CALIBRATE) {
+		CalibrationRun run = {sim::now(), 0, STATE_CALIBRATE, CALIBRATION_BUSY, calibration[0].getGas(), {0, 0}};
+		calibrations.push_back(run);
+	}
+	else if (previous == STATE_CALIBRATE && state != STATE_CALIBRATE && !calibrations.empty()) {
+		CalibrationRun& run = calibrations.back();
+		run.duration = sim::now() - run.start;
+		run.next = state;
+		run.status = calibrationStatus;
+		run.model = calibrationModel[0];
+	}
+#ifdef BATCH_ENABLE
+	static uint16_t logged = 0;
+	if (batchLogged != 0 && batchLogged != logged) {
+		BatchCylinder cylinder = {batchLogged, trace.sensorChangeBefore(sim::now()), sim::now()};
+		cylinders.push_back(cylinder);
+	}
+	logged = batchLogged;
+#endif
+	if (previous == STATE_ANALYZE && state == STATE_HOLD && holdTime == 0
+		&& sim::now() >= trace.lastSensorChange()) {
+		holdTime = sim::now();
+		holdValue = oxygenConcentration;
+		chargeAtHold = charge.total();
+	}
+	previous = state;
+
+	if (sim::now() < nextReadout) return;
+	nextReadout = sim::now() + READOUT_PERIOD;
+	if (state == STATE_ANALYZE) {
+		readout.push_back(std::make_pair(sim::now(), oxygenConcentration));
+		shown.push_back(std::make_pair(sim::now(), displayConcentration));
+	}
+}
+
+// what the analyzer shows once the cell has fully settled, 0.01%
+double settledConcentration()
+{
+	double counts = trace.finalMicroVolts() * 1000.0 / ADS_NV_PER_COUNT;
+	return (counts - calibrationModel[0].offset) * calibrationModel[0].gain / (1 << CALIBRATION_GAIN_SHIFT);
+}
+
+/**
+ * Readout noise and settling time after the last sensor change
+ * Final value and noise come from the last READOUT_STEADY of the trace
+ */
+void reportReadout()
+{
+	uint64_t change = trace.lastSensorChange();
+	if (holdTime != 0 && calibrationModel[0].gain != 0) {
+		double expected = settledConcentration();
+		printf("\nHOLD             %.2f s after the last sensor change, %.2f %% (settled %.2f %%)\n",
+			(holdTime - change) / 1e6, holdValue / 100.0, expected / 100);
+	}
+	if (calibrationModel[0].gain != 0 && !readout.empty()) {
+		// accuracy vs time after the change, against a fully settled cell
+		double expected = settledConcentration();
+		static const uint32_t AFTER[] = {1, 2, 3, 4, 5, 7, 10, 15, 20, 30};
+		printf("\n%-16s %10s %10s\n", "error after", "measured", "displayed");
+		size_t i = 0;
+		for (uint8_t k = 0; k < sizeof(AFTER) / sizeof(AFTER[0]); k++) {
+			uint64_t t = change + AFTER[k] * 1000000ull;
+			while (i < readout.size() && readout[i].first < t) i++;
+			if (i == readout.size() || readout[i].first - t > READOUT_PERIOD) break;
+			printf("%13u s %8.2f %% %8.2f %%\n", AFTER[k],
+				(readout[i].second - expected) / 100, (shown[i].second - expected) / 100);
+		}
+	}
+	uint64_t steady = sim::now() > READOUT_STEADY ? sim::now() - READOUT_STEADY : 0;
+	double sum = 0, squares = 0;
+	uint32_t n = 0;
+	for (size_t i = 0; i < readout.size(); i++) {
+		if (readout[i].first < steady) continue;
+		sum += readout[i].second;
+		squares += (double)readout[i].second * readout[i].second;
+		n++;
+	}
+	if (n < 2 || steady < change) return;
+	double mean = sum / n;
+	double rms = sqrt(squares / n - mean * mean);
+	uint64_t settled = change;
+	for (size_t i = 0; i < readout.size(); i++) {
+		if (readout[i].first >= change && fabs(readout[i].second - mean) > READOUT_TOLERANCE) {
+			settled = readout[i].first;
+		}
+	}
+	printf("\nO2 readout       %.2f %% final, %.4f %% rms noise", mean / 100, rms / 100);
+	printf(", settled within 0.%u %% %.2f s after the last sensor change\n",
+		READOUT_TOLERANCE / 10, (settled - change) / 1e6);
+}
+
+/**
+ * Cylinders logged by automatic HOLDs: analysis time of each one, from the
+ * gas change to the saved record, and the throughput over the whole trace
+ * (knob free handling of the cylinders included)
+ */
+void reportBatch()
+{
+	if (cylinders.empty()) return;
+	uint64_t total = 0, longest = 0;
+	for (size_t i = 0; i < cylinders.size(); i++) {
+		uint64_t t = cylinders[i].saved - cylinders[i].change;
+		total += t;
+		if (t > longest) longest = t;
+	}
+	double average = total / 1e6 / cylinders.size();
+	printf("\nbatch            %zu cylinders (%u to %u), %.2f s avg, %.2f s max from the gas change to the saved record\n",
+		cylinders.size(), cylinders.front().number, cylinders.back().number, average, longest / 1e6);
+	printf("  throughput     %.0f cylinders/h at most", 3600 / average);
+	if (cylinders.size() > 1) {
+		double span = (cylinders.back().saved - cylinders.front().change) / 1e6;
+		printf(", %.0f cylinders/h over the trace (%.1f s per cylinder with the handling)",
+			cylinders.size() * 3600 / span, span / cylinders.size());
+	}
+	printf("\n");
+}
+
+int64_t adsInput(uint16_t mux, uint64_t t)
+{
+	// the cell sits between AIN0 and AIN1, the second one between AIN2 and AIN3
+	if (mux == 0x0000) return llround(trace.sensorMicroVolts(t, 0) * 1000.0);
+#ifdef DUAL_CELL_ENABLE
+	if (mux == 0x3000) return llround(trace.sensorMicroVolts(t, 1) * 1000.0);
+#endif
+	return 0;
+}
+
+// screen contents, one line per change
+FILE* golden = NULL;
+const char* eepromPath = NULL;
+uint64_t loops = 0;
+host_clock::time_point hostStart;
+
+void recordScreen()
+{
+	static char previous[80];
+	char line[80];
+	int n = snprintf(line, sizeof(line), "%s", state < NUM_STATES ? STATE_NAMES[state] : "?");
+	switch (state) {
+	case STATE_START_SCREEN:
+		n += snprintf(line + n, sizeof(line) - n, " battery %d mV", batteryVoltage);
+		break;
+	case STATE_ANALYZE:
+	case STATE_HOLD:
+		n += snprintf(line + n, sizeof(line) - n, " %d.%02d %s | %s", displayConcentration / 100,
+			displayConcentration % 100, predicting ? (predictionConfidence > 2 ? "***" :
+			predictionConfidence > 1 ? "**." : "*..") : "   ", displayFooterBuffer);
+		if (cellSuspects != 0) {
+			n += snprintf(line + n, sizeof(line) - n, " check cells 0x%x", cellSuspects);
+		}
+#ifdef BATCH_ENABLE
+		if (state == STATE_HOLD && batchLogged != 0) {
+			n += snprintf(line + n, sizeof(line) - n, " cylinder %u", batchLogged);
+		}
+#endif
+		break;
+	case STATE_CALIBRATE_MENU:
+		n += snprintf(line + n, sizeof(line) - n, " %s", stateCalibMenu == YES_AIR ? "AIR" : stateCalibMenu == YES_O2 ? "O2" : "NO");
+		break;
+	case STATE_ERROR:
+		n += snprintf(line + n, sizeof(line) - n, " calibration status %d", calibrationStatus);
+#ifdef DUAL_CELL_ENABLE
+		n += snprintf(line + n, sizeof(line) - n, " cell %u", calibrationCell + 1);
+#endif
+		break;
+	default:
+		break;
+	}
+	// battery badge, as drawn by drawScreen()
+	if (state != STATE_ERROR || batteryWarning) {
+		snprintf(line + n, sizeof(line) - n, batteryWarning ? " [%u%% low]" : " [%u%%]", batteryCharge);
+	}
+	if (strcmp(line, previous) == 0) return;
+	strcpy(previous, line);
+	fprintf(golden, "%10.3f %s\n", sim::now() / 1e3, line);
+}
+
+void pageHook(bool begin)
+{
+	if (begin) {
+		if (frame.pages == 0) frame.bytes = U8G2::bytesSent;
+		frame.virtualStart = sim::now();
+		frame.hostStart = host_clock::now();
+		return;
+	}
+	frame.pages++;
+	frame.virtualTime += sim::now() - frame.virtualStart;
+	frame.hostTime += std::chrono::duration_cast<std::chrono::nanoseconds>(host_clock::now() - frame.hostStart).count();
+}
+
+void endFrame()
+{
+	if (frame.pages > 0) {
+		render.count++;
+		render.virtualTime += frame.virtualTime;
+		render.hostTime += frame.hostTime;
+		if (frame.virtualTime > render.virtualMax) render.virtualMax = frame.virtualTime;
+		renderBytes += U8G2::bytesSent - frame.bytes;
+		renderPages += frame.pages;
+	}
+	frame = Frame();
+}
+
+void usage(const char* argv0)
+{
+	fprintf(stderr,
+		"usage: %s [options] [trace]\n"
+		"  -t <ms>   simulated duration (default: end of trace)\n"
+		"  -l <us>   modelled CPU time of one loop() pass (default 100)\n"
+		"  -p <us>   modelled CPU time to render one page (default 2500)\n"
+		"  -s        echo Serial output\n"
+		"  -o <file> save Serial output\n"
+		"  -g <file> log the screen contents, see sim/golden/\n"
+		"  -e <file> EEPROM image, loaded if it exists and saved at the end\n", argv0);
+}
+
+std::string eepromWear()
+{
+	uint32_t total = 0, most = 0, cells = 0;
+	for (uint16_t i = 0; i < SIM_EEPROM_SIZE; i++) {
+		total += EEPROM.writes[i];
+		if (EEPROM.writes[i] > most) most = EEPROM.writes[i];
+		if (EEPROM.writes[i] > 0) cells++;
+	}
+	char text[80];
+	snprintf(text, sizeof(text), "%u writes to %u cells, %u at most per cell", total, cells, most);
+	return text;
+}
+
+void report(uint64_t loops, uint64_t hostNs)
+{
+	double seconds = sim::now() / 1e6;
+	printf("trace            %s\n", trace.name.c_str());
+	printf("simulated time   %.3f s\n", seconds);
+	printf("host time        %.3f s (%.0fx real time)\n", hostNs / 1e9, seconds / (hostNs / 1e9));
+	printf("loop iterations  %llu\n", (unsigned long long)loops);
+	printf("loop rate        %.1f /s simulated, %.0f /s host\n", loops / seconds, loops / (hostNs / 1e9));
+
+	printf("\n%-16s %10s %12s %12s %12s\n", "state", "loops", "sim time", "sim/loop", "host/loop");
+	for (uint8_t i = 0; i < NUM_STATES; i++) {
+		const Section& s = states[i];
+		if (s.count == 0) continue;
+		printf("%-16s %10u %10.3f s %9.1f us %9.0f ns\n", STATE_NAMES[i], s.count,
+			s.virtualTime / 1e6, (double)s.virtualTime / s.count, (double)s.hostTime / s.count);
+	}
+
+	printf("\nrenderDisplay    %u frames", render.count);
+	if (render.count > 0) {
+		printf(", %.2f ms avg, %.2f ms max simulated, %.0f ns host\n",
+			render.virtualTime / 1e3 / render.count, render.virtualMax / 1e3,
+			(double)render.hostTime / render.count);
+		printf("  per frame      %.2f pages, %.0f bytes to the display",
+			(double)renderPages / render.count, (double)renderBytes / render.count);
+	}
+	printf("\n");
+
+	printf("\nI2C bus          %u transactions, %u bytes, busy %.1f%%\n",
+		sim::bus.transactions, sim::bus.bytes, 100.0 * sim::bus.busyTime / sim::now());
+	printf("  ADS1115        %u transactions, %u conversions, %u read\n",
+		ads1115.transactions, ads1115.conversions, ads1115.conversionReads);
+	printf("  samples        %u collected, %u dropped, %u duplicated\n",
+		ads1115.collected, ads1115.dropped, ads1115.duplicated);
+	if (ads1115.comparatorAlerts > 0) {
+		printf("  comparator     %u alerts\n", ads1115.comparatorAlerts);
+	}
+	for (uint8_t i = 0; i < CELL_COUNT; i++) {
+		printf("  cell %u         %u samples", i + 1, acquisitionSamples(i));
+		if (samplingTime > 0) printf(", %.2f /s while sampling", acquisitionSamples(i) * 1e6 / samplingTime);
+		printf("\n");
+	}
+	if (ads1115.collected > 0) {
+		printf("  read latency   %.0f us avg, %u us max\n",
+			(double)ads1115.latencyTotal / ads1115.collected, ads1115.latencyMax);
+		printf("  per sample     %.2f transactions (%u config reads, %u pointer writes)\n",
+			(double)ads1115.transactions / ads1115.collected, ads1115.configReads, ads1115.pointerWrites);
+	}
+	printf("  SH1106         %u transactions, %u data bytes\n",
+		sh1106.transactions, sh1106.dataBytes);
+	printf("EEPROM           %s\n", eepromWear().c_str());
+	printf("buzzer           %u beeps\n", sim::tones.count);
+	printf("encoder          %u A / B edges, %u button edges\n", knob.quadratureEdges, knob.buttonEdges);
+	printf("battery ADC      %u conversions, %u in noise reduction sleep\n", sim::adc.conversions, sim::adc.sleeps);
+	printf("serial           %u bytes at %lu baud, blocked %.1f ms\n",
+		Serial.sent, Serial.baud, Serial.blockedTime / 1e3);
+
+	double average = charge.total() / seconds;
+	printf("\npower            CPU asleep %.1f %% (%u sleeps), ADS1115 converting %.1f %%, display dimmed %.1f %%\n",
+		100.0 * sim::power.sleepTime / sim::now(), sim::power.sleeps,
+		100.0 * ads1115.convertingTime / sim::now(), 100.0 * dimmedTime / sim::now());
+	printf("  average        %.2f mA: CPU %.2f, ADS1115 %.3f, display %.2f\n", average / 1e3,
+		charge.cpu / seconds / 1e3, charge.ads / seconds / 1e3, charge.display / seconds / 1e3);
+	printf("  battery life   %.0f h on %.0f mAh\n", BATTERY_MAH * 1e3 / average, BATTERY_MAH);
+	if (holdTime != 0 && chargeAtChange >= 0) {
+		double analysis = chargeAtHold - chargeAtChange;
+		printf("  per analysis   %.1f mC, %.1f mJ, from the last sensor change to HOLD\n",
+			analysis / 1e3, analysis * SUPPLY_VOLTS / 1e3);
+	}
+
+	printf("\ntask                 runs    avg us    max us   late ms\n");
+	for (uint8_t i = 0; i < TASK_COUNT; i++) {
+		const Task* t = scheduler.getTask(i);
+		printf("%-16s %8u %9.0f %9u %9u\n", TASK_NAMES[i], t->runs,
+			t->runs ? (double)t->totalRunTime / t->runs : 0.0, t->maxRunTime, t->maxLateness);
+	}
+#ifdef PROFILE
+	static const char* const SECTION_NAMES[] = {"loop", "render", "ADS read", "battery", "encoder ISR"};
+	static_assert(sizeof(SECTION_NAMES) / sizeof(SECTION_NAMES[0]) == PROFILE_SECTIONS, "one name per section");
+	printf("\nsection              count    min us    avg us    max us   histogram (from us: count)\n");
+	for (uint8_t i = 0; i < PROFILE_SECTIONS; i++) {
+		ProfileStats p;
+		profileGet(i, &p);
+		printf("%-16s %9u %9u %9.0f %9u  ", SECTION_NAMES[i], p.count, p.min,
+			p.count ? (double)p.total / p.count : 0.0, p.max);
+		for (uint8_t b = 0; b < PROFILE_BUCKETS; b++) {
+			if (p.histogram[b] != 0) printf(" %u:%u", b == 0 ? 0 : 1u << b, p.histogram[b]);
+		}
+		printf("\n");
+	}
+#endif
+	static const char* const STATUS_NAMES[] = {"busy", "done", "noisy", "drift", "range", "nonlinear"};
+	for (size_t i = 0; i < calibrations.size(); i++) {
+		const CalibrationRun& run = calibrations[i];
+		printf("%s at %.2f s", i == 0 ? "\ncalibration     " : "                ", run.start / 1e6);
+		if (run.next == STATE_CALIBRATE) {
+			printf(", not finished\n");
+			continue;
+		}
+		printf(" in %s, %.2f s -> %s (%s), gain %u offset %d\n", run.gas == CALIBRATION_O2 ? "O2" : "air",
+			run.duration / 1e6, STATE_NAMES[run.next], STATUS_NAMES[run.status], run.model.gain, run.model.offset);
+	}
+	reportReadout();
+	reportBatch();
+}
+
+void finish()
+{
+	uint64_t hostNs = std::chrono::duration_cast<std::chrono::nanoseconds>(host_clock::now() - hostStart).count();
+	report(loops, hostNs);
+	if (Serial.capture != NULL) fclose(Serial.capture);
+	if (golden != NULL) {
+		fprintf(golden, "%10.3f EEPROM %s\n", sim::now() / 1e3, eepromWear().c_str());
+		fclose(golden);
+	}
+	if (eepromPath != NULL && !EEPROM.save(eepromPath)) perror(eepromPath);
+}
+
+void powerLoss()
+{
+	printf("power lost       at %.3f s\n\n", sim::now() / 1e6);
+	if (golden != NULL) fprintf(golden, "%10.3f POWER LOSS\n", sim::now() / 1e3);
+	finish();
+	exit(0);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	uint64_t duration = 0;
+	uint32_t loopTime = 100;
+	const char* tracePath = NULL;
+
+	U8G2::pageRenderTime = 2500;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			duration = strtoull(argv[++i], NULL, 10) * 1000;
+		}
+		else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+			loopTime = strtoul(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			U8G2::pageRenderTime = strtoul(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "-s") == 0) {
+			Serial.echo = true;
+		}
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			Serial.capture = fopen(argv[++i], "wb");
+			if (Serial.capture == NULL) {
+				perror(argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+			golden = fopen(argv[++i], "w");
+			if (golden == NULL) {
+				perror(argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+			eepromPath = argv[++i];
+		}
+		else if (argv[i][0] == '-') {
+			usage(argv[0]);
+			return 2;
+		}
+		else {
+			tracePath = argv[i];
+		}
+	}
+
+	if (tracePath != NULL) {
+		if (!trace.load(tracePath)) return 1;
+	}
+	else {
+		trace.loadDefault();
+	}
+	if (duration == 0) duration = trace.duration();
+	ads1115.input = adsInput;
+	// a recording already has the noise of the real ADC
+	ads1115.noise = !trace.recorded();
+#ifdef ADS_ALERT_PIN
+	ads1115.alertPin = ADS_ALERT_PIN;
+#endif
+	trace.knob = &knob;
+	U8G2::pageHook = pageHook;
+	sim::powerLoss = powerLoss;
+	if (eepromPath != NULL) EEPROM.load(eepromPath);
+
+	// apply the t = 0 part of the trace (battery, sensor) before setup()
+	sim::advanceTo(0);
+	knob.begin();
+	setup();
+	if (golden != NULL) {
+		fprintf(golden, "# %s\n", trace.name.c_str());
+		if (frame.pages > 0) recordScreen();
+	}
+	endFrame();
+
+	hostStart = host_clock::now();
+	while (sim::now() < duration) {
+		uint8_t s = (uint8_t)state;
+		uint64_t v0 = sim::now();
+		uint64_t sleep0 = sim::power.sleepTime;
+		uint64_t converting0 = ads1115.convertingTime;
+		bool sampling = acquisitionRunning();
+		uint8_t contrast = sh1106.contrast;
+		host_clock::time_point h0 = host_clock::now();
+		loop();
+		if (golden != NULL && frame.pages > 0) recordScreen();
+		if (golden != NULL && sh1106.contrast != contrast) {
+			fprintf(golden, "%10.3f display contrast %u\n", sim::now() / 1e3, sh1106.contrast);
+		}
+		endFrame();
+		recordReadout();
+		sim::advance(loopTime);
+		recordCharge(sim::now() - v0, sim::power.sleepTime - sleep0, ads1115.convertingTime - converting0, contrast);
+		if (sampling) samplingTime += sim::now() - v0;
+		if (s < NUM_STATES) {
+			states[s].count++;
+			states[s].virtualTime += sim::now() - v0;
+			states[s].hostTime += std::chrono::duration_cast<std::chrono::nanoseconds>(host_clock::now() - h0).count();
+		}
+		loops++;
+	}
+	finish();
+	return 0;
+}
+
+#endif // PIO_UNIT_TESTING
@@ -0,0 +1,283 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include "trace.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <Arduino.h>
+#include <EEPROM.h>
+
+namespace sim {
+
+// ADS1115 at PGA 16
+static const double ADC_UV_PER_COUNT = 7.8125;
+
+static const struct {
+	const char* name;
+	Trace::Kind kind;
+} COMMANDS[] = {
+	{"cell", Trace::CELL},
+	{"approach", Trace::APPROACH},
+	{"adc", Trace::ADC},
+	{"noise", Trace::NOISE},
+	{"cell2", Trace::CELL2},
+	{"limit2", Trace::LIMIT2},
+	{"battery", Trace::BATTERY},
+	{"click", Trace::CLICK},
+	{"double", Trace::DOUBLE},
+	{"held", Trace::HELD},
+	{"turn", Trace::TURN},
+	{"bounce", Trace::BOUNCE},
+	{"powerloss", Trace::POWERLOSS},
+	{"end", Trace::END},
+};
+
+Trace::Trace() :
+	knob(NULL),
+	nextIndex(0),
+	sensorIndex(0),
+	recordedPoints(0),
+	end(0),
+	seed(0x1e3d),
+	seed2(0x7a41),
+	noiseRms(0),
+	cell2Permille(1000),
+	cell2Limit(0)
+{
+}
+
+bool Trace::add(uint64_t t, const char* command, const char* args)
+{
+	Point p = {t, CELL, 0, 0, 0.0};
+	size_t i;
+	for (i = 0; i < sizeof(COMMANDS) / sizeof(COMMANDS[0]); i++) {
+		if (strcmp(command, COMMANDS[i].name) == 0) break;
+	}
+	if (i == sizeof(COMMANDS) / sizeof(COMMANDS[0])) return false;
+	p.kind = COMMANDS[i].kind;
+	long a = 0, b = 0;
+	int n = sscanf(args, "%ld %ld", &a, &b);
+	p.value = (int32_t)a;
+	p.arg = (int32_t)b;
+	switch (p.kind) {
+	case CELL:
+	case ADC:
+	case NOISE:
+	case CELL2:
+	case LIMIT2:
+	case BATTERY:
+	case HELD:
+	case TURN:
+	case BOUNCE:
+		if (n < 1) return false;
+		break;
+	case APPROACH:
+		if (n < 2 || b <= 0) return false;
+		break;
+	default:
+		break;
+	}
+	if (p.kind == CELL || p.kind == APPROACH || p.kind == ADC) {
+		if (p.kind == ADC) recordedPoints++;
+		sensor.push_back(p);
+	}
+	else {
+		events.push_back(p);
+	}
+	if (t > end) end = t;
+	return true;
+}
+
+bool Trace::load(const char* path)
+{
+	FILE* f = fopen(path, "r");
+	if (f == NULL) {
+		fprintf(stderr, "cannot open trace %s\n", path);
+		return false;
+	}
+	name = path;
+	char line[256];
+	unsigned lineNumber = 0;
+	bool ok = true;
+	while (fgets(line, sizeof(line), f) != NULL) {
+		lineNumber++;
+		char* hash = strchr(line, '#');
+		if (hash != NULL) *hash = '\0';
+		double ms;
+		char command[16];
+		int consumed = 0;
+		if (sscanf(line, " %lf %15s %n", &ms, command, &consumed) < 2 || ms < 0) {
+			if (strspn(line, " \t\r\n") != strlen(line)) {
+				fprintf(stderr, "%s:%u: syntax error\n", path, lineNumber);
+				ok = false;
+			}
+			continue;
+		}
+		if (!add((uint64_t)llround(ms * 1000), command, line + consumed)) {
+			fprintf(stderr, "%s:%u: bad command '%s'\n", path, lineNumber, command);
+			ok = false;
+		}
+	}
+	fclose(f);
+	prepare();
+	return ok;
+}
+
+/**
+ * Fresh device in air: calibrate, then 20 s of analysis
+ */
+void Trace::loadDefault()
+{
+	name = "default";
+	add(0, "cell", "10000");
+	add(0, "noise", "3");
+	add(0, "battery", "3900");
+	add(3000000, "held", "1000");
+	add(4500000, "click", "");
+	add(30000000, "end", "");
+	prepare();
+}
+
+static bool earlier(const Trace::Point& a, const Trace::Point& b)
+{
+	return a.t < b.t;
+}
+
+void Trace::prepare()
+{
+	std::stable_sort(sensor.begin(), sensor.end(), earlier);
+	std::stable_sort(events.begin(), events.end(), earlier);
+	// starting value of each first order response
+	for (size_t i = 0; i < sensor.size(); i++) {
+		sensor[i].start = (i == 0) ? 0.0 : sensorAt(i - 1, sensor[i].t);
+	}
+	nextIndex = 0;
+	sensorIndex = 0;
+}
+
+double Trace::sensorAt(size_t i, uint64_t t)
+{
+	const Point& p = sensor[i];
+	if (p.kind == ADC) {
+		return p.value * ADC_UV_PER_COUNT;
+	}
+	if (p.kind == APPROACH) {
+		double dt = (double)(t - p.t) / 1000.0;
+		return p.value + (p.start - p.value) * exp(-dt / p.arg);
+	}
+	if (i + 1 < sensor.size() && sensor[i + 1].kind == CELL) {
+		const Point& q = sensor[i + 1];
+		return p.value + (double)(q.value - p.value) * (double)(t - p.t) / (double)(q.t - p.t);
+	}
+	return p.value;
+}
+
+static double gaussianNoise(uint32_t& seed)
+{
+	double u1, u2;
+	seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+	u1 = (seed + 1.0) / 4294967297.0;
+	seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+	u2 = (seed + 1.0) / 4294967297.0;
+	return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+double Trace::sensorMicroVolts(uint64_t t, uint8_t cell)
+{
+	if (sensor.empty() || t < sensor[0].t) return 0.0;
+	// recordings hold millions of points: resume from the last one
+	if (t < sensor[sensorIndex].t) sensorIndex = 0;
+	while (sensorIndex + 1 < sensor.size() && sensor[sensorIndex + 1].t <= t) sensorIndex++;
+	double v = sensorAt(sensorIndex, t);
+	if (cell > 0) {
+		v = v * cell2Permille / 1000.0;
+		if (cell2Limit > 0 && v > cell2Limit) v = cell2Limit;
+	}
+	if (noiseRms > 0) {
+		v += noiseRms * gaussianNoise(cell > 0 ? seed2 : seed);
+	}
+	return v;
+}
+
+uint64_t Trace::sensorChangeBefore(uint64_t t) const
+{
+	uint64_t change = 0;
+	for (size_t i = 0; i < sensor.size() && sensor[i].t <= t; i++) {
+		if (sensor[i].kind != ADC) change = sensor[i].t;
+	}
+	return change;
+}
+
+int32_t Trace::finalMicroVolts() const
+{
+	if (sensor.empty()) return 0;
+	const Point& p = sensor.back();
+	return p.kind == ADC ? (int32_t)lround(p.value * ADC_UV_PER_COUNT) : p.value;
+}
+
+uint64_t Trace::nextEvent()
+{
+	return nextIndex < events.size() ? events[nextIndex].t : SIM_NO_EVENT;
+}
+
+void Trace::fire(uint64_t t)
+{
+	(void) t;
+	const Point& p = events[nextIndex++];
+	switch (p.kind) {
+	case NOISE:
+		noiseRms = p.value;
+		break;
+	case CELL2:
+		cell2Permille = p.value;
+		break;
+	case LIMIT2:
+		cell2Limit = p.value;
+		break;
+	case BATTERY:
+		// 1:2 divider on A0, 3.3 V reference
+		setAnalog(A0, (uint16_t)((p.value / 2) * 1023L / 3300L));
+		break;
+	case CLICK:
+		if (knob) knob->click();
+		break;
+	case DOUBLE:
+		if (knob) knob->doubleClick();
+		break;
+	case HELD:
+		if (knob) knob->press(p.value);
+		break;
+	case TURN:
+		if (knob) knob->turn(p.value);
+		break;
+	case BOUNCE:
+		if (knob) knob->bounce = p.value;
+		break;
+	case POWERLOSS:
+		if (p.value > 0) {
+			EEPROM.powerLossAfter = p.value;
+		}
+		else if (powerLoss != NULL) {
+			powerLoss();
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+} // namespace sim
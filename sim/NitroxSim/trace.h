@@ -0,0 +1,114 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - native simulation
+ *
+ * Scripted sensor traces
+ *
+ * A trace is a text file, one command per line:
+ *
+ *     # comment
+ *     <ms> cell     <µV>            sensor output, linear between cell points
+ *     <ms> adc      <counts>        recorded conversion result (7.8125 µV/count),
+ *                                   held until the next sensor point
+ *     <ms> approach <µV> <tau ms>   first order response towards <µV>
+ *     <ms> noise    <µV rms>        gaussian noise added to the sensor
+ *     <ms> cell2    <permille>      second cell output, relative to the first one
+ *                                   (DUAL_CELL_ENABLE), 1000 by default
+ *     <ms> limit2   <µV>            second cell output capped (current limited),
+ *                                   0 for no limit
+ *     <ms> battery  <mV>            battery voltage
+ *     <ms> click | double | held <ms> | turn <notches>
+ *                                   knob actions, played one after the other
+ *     <ms> bounce   <µs>            contact bounce of the next knob actions
+ *     <ms> powerloss [<n>]          power is lost, or during the n-th next EEPROM write
+ *     <ms> end                      end of the simulation
+ *
+ * Times can have a fractional part (e.g. 2.105), for recorded conversions.
+ * A trace with adc points replays a recording: the ADC model does not add
+ * its own noise on top of it.
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#ifndef _SIM_TRACE_H_
+#define _SIM_TRACE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "devices.h"
+#include "sim.h"
+
+namespace sim {
+
+class Trace : public Ticker {
+public:
+	enum Kind {
+		CELL,
+		APPROACH,
+		ADC,
+		NOISE,
+		CELL2,
+		LIMIT2,
+		BATTERY,
+		CLICK,
+		DOUBLE,
+		HELD,
+		TURN,
+		BOUNCE,
+		POWERLOSS,
+		END,
+	};
+
+	struct Point {
+		uint64_t t;  // µs
+		Kind kind;
+		int32_t value;
+		int32_t arg;
+		double start;  // sensor value when an approach starts, µV
+	};
+
+	Trace();
+	bool load(const char* path);
+	void loadDefault();
+
+	double sensorMicroVolts(uint64_t t, uint8_t cell = 0);
+	uint64_t duration() const { return end; }
+	uint64_t lastSensorChange() const { return sensor.empty() ? 0 : sensor.back().t; }
+	uint64_t sensorChangeBefore(uint64_t t) const;  // last cell or approach point
+	int32_t finalMicroVolts() const;
+	bool recorded() const { return recordedPoints > 0; }
+
+	virtual uint64_t nextEvent();
+	virtual void fire(uint64_t t);
+
+	std::string name;
+	KnobModel* knob;
+
+private:
+	bool add(uint64_t t, const char* command, const char* args);
+	void prepare();
+	double sensorAt(size_t index, uint64_t t);
+
+	std::vector<Point> sensor;   // cell, approach and adc points
+	std::vector<Point> events;   // everything else
+	size_t nextIndex;
+	size_t sensorIndex;          // last point used, time only goes forward
+	size_t recordedPoints;
+	uint64_t end;
+	uint32_t seed;
+	uint32_t seed2;              // second cell, its noise is independent
+	uint32_t noiseRms;
+	int32_t cell2Permille;
+	int32_t cell2Limit;
+};
+
+} // namespace sim
+
+#endif // _SIM_TRACE_H_
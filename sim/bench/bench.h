@@ -0,0 +1,107 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - benchmarks
+ *
+ * Cost of one call
+ * - native: ns per call, host clock
+ * - AVR: CPU cycles per call, Timer1 running at F_CPU. Run the firmware
+ *   under simavr (or on a board) and read the Serial output.
+ *
+ * A benchmark defines run(), this header provides the entry points.
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <Arduino.h>
+
+#ifdef NATIVE
+#include <stdio.h>
+#include <chrono>
+#define ITERATIONS  1000000ul
+#define UNIT        "ns"
+#else
+#define ITERATIONS  1000ul
+#define UNIT        "cycles"
+#endif
+
+static void run();
+
+#ifdef NATIVE
+
+// ns per call, x10
+template <class F>
+static uint32_t measure(F f)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < ITERATIONS; i++) {
+		f();
+	}
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	return (uint32_t)(ns * 10 / ITERATIONS);
+}
+
+static void report(const char* name, uint32_t value)
+{
+	printf("%-32s %6u.%u %s\n", name, value / 10, value % 10, UNIT);
+}
+
+int main()
+{
+	run();
+	return 0;
+}
+
+#else
+
+static uint16_t overhead;
+
+// cycles per call, x10
+template <class F>
+static uint32_t measure(F f)
+{
+	uint32_t total = 0;
+	for (uint16_t i = 0; i < ITERATIONS; i++) {
+		uint16_t start, end;
+		noInterrupts();
+		start = TCNT1;
+		f();
+		end = TCNT1;
+		interrupts();
+		total += (uint16_t)(end - start);
+	}
+	total = total * 10 / ITERATIONS;
+	return total > overhead ? total - overhead : 0;
+}
+
+static void report(const char* name, uint32_t value)
+{
+	Serial.print(name);
+	for (uint8_t i = strlen(name); i < 33; i++) Serial.print(' ');
+	Serial.print(value / 10); Serial.print('.'); Serial.print(value % 10);
+	Serial.print(' '); Serial.println(F(UNIT));
+}
+
+void setup()
+{
+	Serial.begin(19200);
+	// Timer1 as cycle counter
+	TCCR1A = 0;
+	TCCR1B = _BV(CS10);
+	overhead = measure([] {});
+	run();
+}
+
+void loop()
+{
+}
+
+#endif
+
+#endif // _BENCH_H_
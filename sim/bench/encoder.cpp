@@ -0,0 +1,42 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - benchmarks
+ *
+ * Encoder input: EdgeEncoder interrupt handlers, paid per edge, vs the
+ * ClickEncoder service() it replaces, paid every ms (AVR build only, the
+ * library is not part of the host stand-ins)
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include "bench.h"
+#include <EdgeEncoder.h>
+
+#ifndef NATIVE
+#include <ClickEncoder.h>
+
+static ClickEncoder clickEncoder(2, 3, 4, 4);
+#endif
+
+static EdgeEncoder edgeEncoder(2, 3, 4);
+static volatile int16_t sink;
+
+static void run()
+{
+	edgeEncoder.begin();
+
+	report("EdgeEncoder quadratureChange", measure([] { edgeEncoder.quadratureChange(); }));
+	// ALERT/RDY shares the button interrupt: the button did not change
+	report("EdgeEncoder buttonChange", measure([] { sink = edgeEncoder.buttonChange(); }));
+	report("EdgeEncoder getValue", measure([] { sink = edgeEncoder.getValue(); }));
+	report("EdgeEncoder getButton", measure([] { sink = edgeEncoder.getButton(); }));
+#ifndef NATIVE
+	report("ClickEncoder service", measure([] { clickEncoder.service(); }));
+	report("ClickEncoder getValue", measure([] { sink = clickEncoder.getValue(); }));
+	report("ClickEncoder getButton", measure([] { sink = clickEncoder.getButton(); }));
+#endif
+}
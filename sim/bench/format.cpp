@@ -0,0 +1,83 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - benchmarks
+ *
+ * Display strings of one ANALYZE frame (O2 digits + MOD footer):
+ * sprintf_P vs the fixed-point formatter, cost of one frame.
+ * The host build first checks both produce the same strings.
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include "bench.h"
+#include <format.h>
+
+static char digits[16];
+static char footer[24];
+static int16_t concentration = 2095;
+
+static inline int16_t nextConcentration()
+{
+	concentration = concentration >= 9990 ? 5 : concentration + 7;
+	return concentration;
+}
+
+static void sprintfFrame(int16_t fO2, uint16_t pO2_max, uint16_t mod)
+{
+	sprintf_P(digits, PSTR("%02d.%02d"), fO2 / 100, fO2 % 100);
+	sprintf_P(footer, PSTR("pO2 %d.%d > MOD %dm"),
+		(uint8_t)(pO2_max / 1000),
+		(uint8_t)((pO2_max % 1000) / 100),
+		(uint8_t)(mod / 100));
+}
+
+static void formatFrame(int16_t fO2, uint16_t pO2_max, uint16_t mod)
+{
+	formatFixed<2>(digits, fO2, 2);
+	char* p = formatText(footer, F("pO2 "));
+	p = formatFixed<1>(p, pO2_max / 100);
+	p = formatText(p, F(" > MOD "));
+	p = formatFixed<0>(p, mod / 100);
+	formatChar(p, 'm');
+}
+
+#ifdef NATIVE
+
+#include <string.h>
+
+static void checkOutput()
+{
+	uint32_t mismatches = 0;
+	for (int16_t fO2 = 0; fO2 <= 10000; fO2++) {
+		char expected[sizeof(digits) + sizeof(footer)];
+		uint16_t mod = (uint16_t)(fO2 * 3) % 25600;
+		sprintfFrame(fO2, 1400, mod);
+		strcpy(expected, digits);
+		strcat(expected, footer);
+		formatFrame(fO2, 1400, mod);
+		if (strncmp(expected, digits, strlen(digits)) != 0 || strcmp(expected + strlen(digits), footer) != 0) {
+			if (mismatches++ == 0) printf("mismatch: %s / %s%s\n", expected, digits, footer);
+		}
+	}
+	printf("%-32s %u mismatches\n", "formatter vs sprintf_P", mismatches);
+}
+
+#else
+
+static void checkOutput()
+{
+}
+
+#endif
+
+static void run()
+{
+	checkOutput();
+
+	report("sprintf_P frame", measure([] { sprintfFrame(nextConcentration(), 1400, 3300); }));
+	report("formatter frame", measure([] { formatFrame(nextConcentration(), 1400, 3300); }));
+}
@@ -0,0 +1,107 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - benchmarks
+ *
+ * Gas calculations: reciprocal tables vs 32-bit division, cost of one call.
+ * The host build also checks every table driven function against the exact
+ * formula over its whole input range.
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include "bench.h"
+#include <nitrox.h>
+
+static const uint16_t pO2Limits[] = { 1400, 1500, 1600 };
+
+static volatile uint16_t sink;
+static uint16_t fO2 = 2095;
+static uint16_t depth = 0;
+
+// the former calc_mod()
+static uint16_t divisionMod(uint16_t fO2, uint16_t pO2_max)
+{
+	if (fO2 == 0) return UINT16_MAX;
+	return (uint16_t)(((uint32_t)pO2_max * 10000ul) / (uint32_t)fO2) - 1000ul;
+}
+
+// sweep the inputs, so that table lookups do not always hit the same entry
+static inline uint16_t nextFO2()
+{
+	fO2 = fO2 >= 9990 ? 2095 : fO2 + 7;
+	return fO2;
+}
+
+static inline uint16_t nextDepth()
+{
+	depth = depth >= 6000 ? 0 : depth + 13;
+	return depth;
+}
+
+#ifdef NATIVE
+
+#include <math.h>
+
+template <class F, class E>
+static void check(const char* name, uint16_t from, uint16_t to, F f, E exact)
+{
+	double worst = 0;
+	uint16_t worstInput = from;
+	for (uint32_t x = from; x <= to; x++) {
+		double error = fabs(f(x) - exact(x));
+		if (error > worst) {
+			worst = error;
+			worstInput = x;
+		}
+	}
+	printf("%-32s max error %.3f at %u\n", name, worst, worstInput);
+}
+
+static void checkAccuracy()
+{
+	for (uint16_t pO2 : pO2Limits) {
+		char name[32];
+		snprintf(name, sizeof(name), "calc_mod(%u) cm", pO2);
+		check(name, 2048, 10000,
+			[pO2](uint16_t f) { return (double)calc_mod(f, pO2); },
+			[pO2](uint16_t f) { return pO2 * 10000.0 / f - 1000.0; });
+		snprintf(name, sizeof(name), "calc_best_mix(%u) 0.01%%", pO2);
+		check(name, pO2 - 1000, 9000,
+			[pO2](uint16_t d) { return (double)calc_best_mix(d, pO2); },
+			[pO2](uint16_t d) { return pO2 * 10000.0 / (d + 1000.0); });
+	}
+	for (uint16_t f = 2100; f <= 4000; f += 100) {
+		char name[32];
+		snprintf(name, sizeof(name), "calc_ead(%u) cm", f);
+		check(name, 0, 6000,
+			[f](uint16_t d) { return (double)calc_ead(f, d); },
+			[f](uint16_t d) { return fmax(0, (d + 1000.0) * (10000 - f) / 7900.0 - 1000.0); });
+		snprintf(name, sizeof(name), "calc_po2(%u) mbar", f);
+		check(name, 0, 10000,
+			[f](uint16_t d) { return (double)calc_po2(f, d); },
+			[f](uint16_t d) { return f * (d + 1000.0) / 10000.0; });
+	}
+}
+
+#else
+
+static void checkAccuracy()
+{
+}
+
+#endif
+
+static void run()
+{
+	checkAccuracy();
+
+	report("division MOD", measure([] { sink = divisionMod(nextFO2(), 1400); }));
+	report("calc_mod", measure([] { sink = calc_mod(nextFO2(), 1400); }));
+	report("calc_ead", measure([] { sink = calc_ead(nextFO2(), 3000); }));
+	report("calc_best_mix", measure([] { sink = calc_best_mix(nextDepth(), 1400); }));
+	report("calc_po2", measure([] { sink = calc_po2(3200, nextDepth()); }));
+}
@@ -0,0 +1,76 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - benchmarks
+ *
+ * RollingAverage vs FixedRollingAverage, cost of one call
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include "bench.h"
+#include <RollingAverage.h>
+
+#define NUM_SAMPLES 64
+
+static int16_t samples[NUM_SAMPLES];
+static uint8_t next;
+static volatile int32_t sink;
+
+// ~10 mV cell read at PGA 16 with a few LSB of noise
+static void fillSamples()
+{
+	uint16_t seed = 0xACE1;
+	for (uint8_t i = 0; i < NUM_SAMPLES; i++) {
+		seed ^= seed << 7;
+		seed ^= seed >> 9;
+		seed ^= seed << 8;
+		samples[i] = 1280 + (int16_t)(seed & 0x0F) - 8;
+	}
+}
+
+static inline int16_t sample()
+{
+	next = (next + 1) & (NUM_SAMPLES - 1);
+	return samples[next];
+}
+
+static int16_t legacyBuffer20[20];
+static int16_t legacyBuffer16[16];
+static RollingAverage legacy20(20, legacyBuffer20);
+static RollingAverage legacy16(16, legacyBuffer16);
+static FixedRollingAverage<20> fixed20;
+static FixedRollingAverage<16> fixed16;
+static FixedRollingAverage<16, int16_t, 14> narrow16; // as in the firmware
+
+static void run()
+{
+	fillSamples();
+	legacy20.begin();
+	legacy16.begin();
+	for (uint8_t i = 0; i < NUM_SAMPLES; i++) {
+		legacy20.addReading(samples[i]);
+		legacy16.addReading(samples[i]);
+		fixed20.addReading(samples[i]);
+		fixed16.addReading(samples[i]);
+		narrow16.addReading(samples[i]);
+	}
+
+	report("RollingAverage(20) add", measure([] { legacy20.addReading(sample()); }));
+	report("RollingAverage(20) average", measure([] { sink = legacy20.getAverage(); }));
+	report("RollingAverage(16) add", measure([] { legacy16.addReading(sample()); }));
+	report("RollingAverage(16) average", measure([] { sink = legacy16.getAverage(); }));
+	report("FixedRollingAverage<20> add", measure([] { fixed20.addReading(sample()); }));
+	report("FixedRollingAverage<20> average", measure([] { sink = fixed20.getAverage(); }));
+	report("FixedRollingAverage<20> variance", measure([] { sink = fixed20.getVariance(); }));
+	report("FixedRollingAverage<16> add", measure([] { fixed16.addReading(sample()); }));
+	report("FixedRollingAverage<16> average", measure([] { sink = fixed16.getAverage(); }));
+	report("FixedRollingAverage<16> variance", measure([] { sink = fixed16.getVariance(); }));
+	report("FixedRollingAverage<16> std dev", measure([] { sink = fixed16.getStdDev(); }));
+	report("FixedRollingAvg<16,14> add", measure([] { narrow16.addReading(sample()); }));
+	report("FixedRollingAvg<16,14> variance", measure([] { sink = narrow16.getVariance(); }));
+	report("FixedRollingAvg<16,14> std dev", measure([] { sink = narrow16.getStdDev(); }));
+}
@@ -0,0 +1,55 @@
+#!/bin/sh
+#
+# This file is part of
+#
+# NITROX ANALYZER - native simulation
+#
+# Replay every trace of sim/traces/ and compare the screen contents with
+# sim/golden/<trace>.golden. With -u, the golden files are rewritten
+# instead: review the diff before committing them.
+#
+# Traces named <name>.<n>.trace are successive boots of the same device:
+# they run in order and share an EEPROM image.
+#
+# A set of traces for another build lives in sim/traces/<set>/, with its
+# golden files in sim/golden/<set>/ (e.g. dual, for the native_dual env).
+#
+# usage: sim/golden.sh [-u] [program [set]]   (default .pio/build/native/program)
+#
+# MIT License, see LICENSE file
+#
+# Copyright © 2020 Charles Fourneau
+#
+
+update=0
+if [ "$1" = "-u" ]; then
+	update=1
+	shift
+fi
+program=${1:-.pio/build/native/program}
+subdir=${2:+$2/}
+cd "$(dirname "$0")/.." || exit 2
+[ -x "$program" ] || { echo "$program not found, run: pio run -e native" >&2; exit 2; }
+
+out=$(mktemp -d) || exit 2
+trap 'rm -rf "$out"' EXIT
+failed=0
+for trace in sim/traces/$subdir*.trace; do
+	name=$(basename "$trace" .trace)
+	golden=sim/golden/$subdir$name.golden
+	if ! "$program" -g "$out/$name.golden" -e "$out/${name%%.*}.eeprom" "$trace" > "$out/$name.report"; then
+		echo "FAIL $name: simulation error" >&2
+		failed=1
+		continue
+	fi
+	if [ $update -eq 1 ]; then
+		cp "$out/$name.golden" "$golden"
+		echo "updated $golden"
+	elif ! diff -u "$golden" "$out/$name.golden"; then
+		echo "FAIL $name" >&2
+		failed=1
+	else
+		echo "ok   $name"
+	fi
+done
+exit $failed
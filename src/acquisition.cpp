@@ -0,0 +1,395 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#include "acquisition.h"
+
+#include <Arduino.h>
+
+#include "config.h"
+#include "profile.h"
+#include "telemetry.h"
+
+#if defined(ADS_OVERSAMPLING) && !(defined(ADS_ALERT_PIN) && defined(TWI_QUEUE))
+#error "ADS_OVERSAMPLING needs ADS_ALERT_PIN and TWI_QUEUE"
+#endif
+#if defined(WATCH_ENABLE) && !defined(ADS_ALERT_PIN)
+#error "WATCH_ENABLE needs ADS_ALERT_PIN"
+#endif
+#if defined(DUAL_CELL_ENABLE) && !defined(ADS_OVERSAMPLING)
+#error "DUAL_CELL_ENABLE needs ADS_OVERSAMPLING, the TWI interrupt switches the cells"
+#endif
+
+ADS1115 ads;
+
+// input of each cell
+static const adsMux_t CELL_MUX[CELL_COUNT] = {
+	MUX_DIFF_0_1,  // sensor is connected between AIN0 (P) and AIN1 (N)
+#ifdef DUAL_CELL_ENABLE
+	MUX_DIFF_2_3,  // second cell between AIN2 (P) and AIN3 (N)
+#endif
+};
+
+// returned by acquisitionRead(), per cell
+uint32_t adsSamples[CELL_COUNT];
+
+#ifdef ADS_ALERT_PIN
+volatile uint16_t adsOverruns = 0;
+
+#ifdef WATCH_ENABLE
+// ALERT/RDY is the window comparator output, no conversion is read
+volatile bool adsWatching = false;
+volatile bool adsChanged = false;
+// the comparator configuration is loaded, acquisitionStart() restores conversion-ready
+bool adsWindow = false;
+#endif
+
+#ifdef TWI_QUEUE
+// samples read by the TWI interrupt, waiting for the main loop
+#define ADS_FIFO_SIZE 8 // power of 2
+TwiTransaction adsTransaction;
+uint8_t adsBuffer[2];
+volatile int16_t adsFifo[ADS_FIFO_SIZE];
+volatile uint8_t adsFifoHead = 0;
+volatile uint8_t adsFifoTail = 0;
+
+#ifdef DUAL_CELL_ENABLE
+volatile uint8_t adsFifoCell[ADS_FIFO_SIZE];
+// MUX switches, queued by the TWI interrupt between two blocks
+TwiTransaction adsConfigTransaction;
+uint8_t adsConfigBuffer[3];
+volatile bool adsSwitching = false;  // cleared while the main loop writes CONFIG
+volatile uint8_t adsCell = 0;        // of the conversions read now
+volatile uint8_t adsDiscard = 0;     // conversions left to drop after a switch
+#endif
+
+#ifdef ADS_OVERSAMPLING
+#if (ADS_DECIMATION & (ADS_DECIMATION - 1)) != 0
+#error "ADS_DECIMATION must be a power of 2"
+#endif
+// boxcar decimator: sum of the last conversions, dumped every ADS_DECIMATION
+int32_t adsAccumulator = 0;
+uint8_t adsAccumulated = 0;
+#define ADS_DECIMATION_SHIFT (__builtin_ctz(ADS_DECIMATION) - ADS_OVERSAMPLING_BITS)
+#endif
+
+#ifdef DUAL_CELL_ENABLE
+// Block of a cell complete, from the TWI interrupt: switch to the next one.
+// The write lands during the conversion running now, which completes on the
+// previous input, and is dropped with the ADS_MUX_DISCARD ones.
+static void adsNextCell()
+{
+	uint8_t cell = adsCell + 1 < CELL_COUNT ? adsCell + 1 : 0;
+	ads.setMux(CELL_MUX[cell]);
+	if (!ads.queueWriteConfig(&adsConfigTransaction, adsConfigBuffer)) {
+		// still writing the previous switch (bus stuck): one more block here
+		ads.setMux(CELL_MUX[adsCell]);
+		adsOverruns++;
+		return;
+	}
+	adsCell = cell;
+	adsDiscard = ADS_MUX_DISCARD;
+}
+#endif
+
+void adsReadComplete(TwiTransaction* t)
+{
+	// the bus transfer itself runs in the background
+	PROFILE_SCOPE(PROFILE_ADS_READ);
+	if (t->status != TWIQ_DONE) {
+		adsOverruns++;
+		return;
+	}
+	int16_t value = ADS1115::conversionResult(t);
+#ifdef DUAL_CELL_ENABLE
+	if (adsDiscard > 0) {
+		adsDiscard--;
+		return;
+	}
+#endif
+#ifdef TELEMETRY_ENABLE
+#ifdef DUAL_CELL_ENABLE
+	// the stream carries the first cell
+	if (adsCell == 0) telemetryRaw(value);
+#else
+	telemetryRaw(value);
+#endif
+#endif
+#ifdef ADS_OVERSAMPLING
+	adsAccumulator += value;
+	if (++adsAccumulated < ADS_DECIMATION) return;
+	value = (int16_t)(adsAccumulator >> ADS_DECIMATION_SHIFT);
+	adsAccumulator = 0;
+	adsAccumulated = 0;
+#endif
+#ifdef DUAL_CELL_ENABLE
+	uint8_t cell = adsCell;
+	if (adsSwitching) adsNextCell();
+#endif
+	uint8_t next = (adsFifoHead + 1) & (ADS_FIFO_SIZE - 1);
+	if (next == adsFifoTail) {
+		adsOverruns++;
+		return;
+	}
+	adsFifo[adsFifoHead] = value;
+#ifdef DUAL_CELL_ENABLE
+	adsFifoCell[adsFifoHead] = cell;
+#endif
+	adsFifoHead = next;
+}
+#else
+volatile uint8_t adsPending = 0;
+#endif
+
+// both the conversion-ready pulses and the latched comparator
+ADS1115ReadyPulse adsAlert;
+
+void acquisitionAlert(bool otherPin)
+{
+	uint8_t level = digitalRead(ADS_ALERT_PIN);
+#ifdef WATCH_ENABLE
+	if (adsWatching) {
+		if (adsAlert.falling(level)) adsChanged = true;
+		return;
+	}
+#endif
+	// an edge since the vector was entered runs it again
+	bool flagRaised = PCIFR & _BV(digitalPinToPCICRbit(ADS_ALERT_PIN));
+	if (adsAlert.update(level, flagRaised, otherPin)) {
+#ifdef TWI_QUEUE
+		// jump ahead of display transfers
+		if (!ads.queueReadConversion(&adsTransaction, true)) {
+			adsOverruns++;
+		}
+#else
+		adsPending++;
+#endif
+	}
+}
+#else
+uint32_t analyzeTimer = 0;
+#endif
+
+// false while the ADC is powered down, or watching
+bool adsRunning = false;
+
+static void setSamplingRate()
+{
+#ifdef ADS_OVERSAMPLING
+	ads.setDataRate(DR_475SPS); // decimated in adsReadComplete()
+#else
+	ads.setDataRate(DR_16SPS); // 16 sps
+#endif
+}
+
+void acquisitionBegin()
+{
+	ads.begin();
+	ads.setCaching(true);      // single I2C read per sample in continuous mode
+	ads.setGain(GAIN_SIXTEEN); // +/- 256mV FSR = 7.812µV resolution
+	setSamplingRate();
+	ads.setMux(CELL_MUX[0]);
+#ifdef ADS_ALERT_PIN
+#ifdef TWI_QUEUE
+	adsTransaction.readData = adsBuffer;
+	adsTransaction.callback = adsReadComplete;
+#endif
+	ads.enableConversionReady();
+	// ALERT/RDY is open drain
+	pinMode(ADS_ALERT_PIN, INPUT_PULLUP);
+	*digitalPinToPCMSK(ADS_ALERT_PIN) |= _BV(digitalPinToPCMSKbit(ADS_ALERT_PIN));
+	*digitalPinToPCICR(ADS_ALERT_PIN) |= _BV(digitalPinToPCICRbit(ADS_ALERT_PIN));
+#endif
+	ads.writeConfig();
+#ifdef DEBUG
+	Serial.print(F("ADS config: "));
+	Serial.println(ads.readConfig());
+#endif
+	ads.startContinuousConversion();
+#ifdef DUAL_CELL_ENABLE
+	adsDiscard = ADS_MUX_DISCARD;
+	adsSwitching = true;
+#endif
+	adsRunning = true;
+}
+
+void acquisitionStart()
+{
+	if (adsRunning) return;
+#ifdef WATCH_ENABLE
+	adsWatching = false;
+	if (adsWindow) {
+		if (digitalRead(ADS_ALERT_PIN) == LOW) {
+			(void) ads.readConversion(); // releases the latched comparator
+		}
+		setSamplingRate();
+		ads.enableConversionReady();
+		adsWindow = false;
+	}
+#endif
+#ifdef DUAL_CELL_ENABLE
+	// from the first cell, the MUX may still be on another one
+	ads.setMux(CELL_MUX[0]);
+#endif
+	ads.startContinuousConversion();
+#if defined(ADS_ALERT_PIN) && defined(TWI_QUEUE)
+	// a read queued before the start completes in the background: let it
+	// land in the FIFO first (the first new conversion is ~2 ms away)
+	twiQueue.flush();
+#endif
+	// drop what was left from before the stop
+	noInterrupts();
+#ifdef ADS_ALERT_PIN
+#ifdef TWI_QUEUE
+	adsFifoTail = adsFifoHead;
+#ifdef ADS_OVERSAMPLING
+	adsAccumulator = 0;
+	adsAccumulated = 0;
+#endif
+#ifdef DUAL_CELL_ENABLE
+	adsCell = 0;
+	adsDiscard = ADS_MUX_DISCARD;
+	adsSwitching = true;
+#endif
+#else
+	adsPending = 0;
+#endif
+#endif
+	interrupts();
+	adsRunning = true;
+}
+
+void acquisitionStop()
+{
+#ifdef DUAL_CELL_ENABLE
+	// the TWI interrupt leaves the configuration alone from now on
+	noInterrupts();
+	adsSwitching = false;
+	interrupts();
+#endif
+#ifdef WATCH_ENABLE
+	if (adsWatching) {
+		adsWatching = false;
+		ads.stopContinuousConversion();
+	}
+#endif
+	if (!adsRunning) return;
+	adsRunning = false;
+	ads.stopContinuousConversion();
+}
+
+#ifdef WATCH_ENABLE
+void acquisitionWatch(int16_t value, int16_t band)
+{
+	acquisitionStop();
+	// the comparator sees raw conversions
+#ifdef ADS_OVERSAMPLING
+	value >>= ADS_OVERSAMPLING_BITS;
+	band >>= ADS_OVERSAMPLING_BITS;
+#endif
+	int32_t low = (int32_t)value - band;
+	int32_t high = (int32_t)value + band;
+	if (low < INT16_MIN) low = INT16_MIN;
+	if (high > INT16_MAX) high = INT16_MAX;
+	ads.setDataRate(DR_8SPS); // lowest noise, the gas does not change that fast
+#ifdef DUAL_CELL_ENABLE
+	ads.setMux(CELL_MUX[0]);
+#endif
+	ads.enableWindowComparator((int16_t)low, (int16_t)high, COMP_QUEUE_2);
+	adsWindow = true;
+	adsChanged = false;
+	adsWatching = true;
+	ads.startContinuousConversion();
+}
+
+bool acquisitionChanged()
+{
+	if (!adsChanged) return false;
+	adsChanged = false;
+	return true;
+}
+#endif
+
+bool acquisitionRunning()
+{
+	return adsRunning;
+}
+
+static bool readSample(int16_t* value, uint8_t* cell)
+{
+#if !(defined(DUAL_CELL_ENABLE) && defined(ADS_ALERT_PIN) && defined(TWI_QUEUE))
+	(void) cell; // one cell at a time, acquisitionRead() set it
+#endif
+	if (!adsRunning) return false;
+#ifdef ADS_ALERT_PIN
+#ifdef TWI_QUEUE
+	if (adsFifoTail == adsFifoHead) return false;
+	*value = adsFifo[adsFifoTail];
+#ifdef DUAL_CELL_ENABLE
+	*cell = adsFifoCell[adsFifoTail];
+#endif
+	adsFifoTail = (adsFifoTail + 1) & (ADS_FIFO_SIZE - 1);
+	return true;
+#else
+	if (adsPending == 0) return false;
+	noInterrupts();
+	uint8_t pending = adsPending;
+	adsPending = 0;
+	interrupts();
+	// only the last conversion is still in the register
+	adsOverruns += pending - 1;
+	{
+		PROFILE_SCOPE(PROFILE_ADS_READ);
+		*value = ads.readConversion();
+	}
+#ifdef TELEMETRY_ENABLE
+	telemetryRaw(*value);
+#endif
+	return true;
+#endif
+#else
+	if (millis() - analyzeTimer < ANALYZE_INTERVAL) return false;
+	{
+		PROFILE_SCOPE(PROFILE_ADS_READ);
+		*value = ads.readLastConversion();
+	}
+#ifdef TELEMETRY_ENABLE
+	telemetryRaw(*value);
+#endif
+	analyzeTimer = millis();
+	return true;
+#endif
+}
+
+bool acquisitionRead(int16_t* value, uint8_t* cell)
+{
+	*cell = 0;
+	if (!readSample(value, cell)) return false;
+	adsSamples[*cell]++;
+	return true;
+}
+
+uint32_t acquisitionSamples(uint8_t cell)
+{
+	return adsSamples[cell];
+}
+
+uint16_t acquisitionOverruns()
+{
+#ifdef ADS_ALERT_PIN
+	noInterrupts();
+	uint16_t overruns = adsOverruns;
+	interrupts();
+	return overruns;
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,147 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#include "battery.h"
+
+#include <Arduino.h>
+#include <RollingAverage.h>
+#include <util/atomic.h>
+#ifdef TWI_QUEUE
+#include <TwiQueue.h>
+#endif
+
+#include "config.h"
+
+// 1:2 divider, AVcc reference: mV = ADC * BATTERY_FULL_SCALE / 1024
+#define BATTERY_FULL_SCALE (2L * BATTERY_VREF)
+
+// Li-ion discharge curve at rest, mV at 0, 10, ... 100 %
+static const int16_t BATTERY_CURVE[] PROGMEM = {
+	3300, 3690, 3730, 3770, 3800, 3840, 3870, 3950, 4020, 4110, 4200
+};
+#define BATTERY_CURVE_POINTS (sizeof(BATTERY_CURVE) / sizeof(BATTERY_CURVE[0]))
+
+// conversions collected by the interrupt
+static volatile uint16_t batterySum = 0;
+static volatile uint8_t batteryConversions = 0;
+static volatile bool batteryBusy = false;
+
+static FixedRollingAverage<BATTERY_AVERAGE, int16_t, 13> batteryReadings; // mV < 8192
+
+static int16_t toMilliVolts(uint16_t value)
+{
+	return (int16_t)(((uint32_t)value * BATTERY_FULL_SCALE) >> 10);
+}
+
+void batteryBegin()
+{
+	// first value right away, for the splash screen
+	batteryConversion(analogRead(BATTERY_PIN));
+	batteryPortBegin();
+}
+
+void batteryStart()
+{
+	if (batteryBusy) return;
+	batteryBusy = true;
+	// the bus and the UART are clocked by clkIO, halted while sleeping
+	bool sleep = Serial.availableForWrite() == SERIAL_TX_BUFFER_SIZE - 1;
+#ifdef TWI_QUEUE
+	sleep = sleep && !twiQueue.isBusy();
+#endif
+	batteryPortStart(sleep);
+}
+
+bool batteryRead(int16_t* voltage)
+{
+	uint16_t sum;
+	uint8_t conversions;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		sum = batterySum;
+		conversions = batteryConversions;
+		batterySum = 0;
+		batteryConversions = 0;
+	}
+	if (conversions == 0) return false;
+	batteryReadings.addReading(toMilliVolts(sum / conversions));
+	*voltage = batteryReadings.getAverage();
+	return true;
+}
+
+uint8_t batteryStateOfCharge(int16_t voltage)
+{
+	int16_t low = pgm_read_word(&BATTERY_CURVE[0]);
+	if (voltage <= low) return 0;
+	for (uint8_t i = 1; i < BATTERY_CURVE_POINTS; i++) {
+		int16_t high = pgm_read_word(&BATTERY_CURVE[i]);
+		if (voltage < high) {
+			// linear between two points, 10 % apart
+			return (i - 1) * 10 + (uint8_t)((voltage - low) * 10 / (high - low));
+		}
+		low = high;
+	}
+	return 100;
+}
+
+void batteryConversion(uint16_t value)
+{
+	// a few conversions at most between two batteryRead(), batterySum can't overflow
+	if (batteryConversions < 64) {
+		batterySum += value;
+		batteryConversions++;
+	}
+	batteryBusy = false;
+}
+
+
+#if defined(__AVR__)
+
+#include <avr/sleep.h>
+
+void batteryPortBegin()
+{
+	// analogRead() left the ADC on BATTERY_PIN, AVcc reference, 125 kHz clock
+	ADCSRA |= _BV(ADIE);
+}
+
+// HardwareSerial::_written, a byte was written since Serial.begin().
+// TXC0 is clear from reset until a frame has been sent: without a write,
+// it says nothing
+struct SerialWritten : HardwareSerial {
+	static bool get() { return Serial.*(&SerialWritten::_written); }
+};
+
+void batteryPortStart(bool sleep)
+{
+	// the buffer is empty, the last byte may still be in the shift register
+	if (sleep && SerialWritten::get() && !(UCSR0A & _BV(TXC0))) {
+		sleep = false;
+	}
+	if (!sleep) {
+		ADCSRA |= _BV(ADSC);
+		return;
+	}
+	// entering ADC noise reduction mode starts the conversion
+	set_sleep_mode(SLEEP_MODE_ADC);
+	cli();
+	sleep_enable();
+	sei();      // the next instruction runs before any interrupt
+	sleep_cpu();
+	sleep_disable();
+}
+
+ISR(ADC_vect)
+{
+	batteryConversion(ADC);
+}
+
+#endif // __AVR__
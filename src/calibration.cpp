@@ -0,0 +1,126 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#include "calibration.h"
+
+#include <RollingAverage.h>
+
+#include "config.h"
+
+Calibration::Calibration(uint16_t nvPerCount) :
+	nvPerCount(nvPerCount)
+{
+	begin(0);
+}
+
+void Calibration::begin(uint32_t now, calibration_gas_t gas)
+{
+	this->gas = gas;
+	start = now;
+	count = 0;
+	mean = 0;
+	m2 = 0;
+}
+
+void Calibration::addSample(int16_t value)
+{
+	int32_t x = (int32_t)value << 8;
+	count++;
+	int32_t delta = x - mean;
+	mean += delta / (int32_t)count;
+	m2 += (uint64_t)((int64_t)delta * (x - mean));
+}
+
+uint32_t Calibration::variance() const
+{
+	if (count < 2) return 0;
+	uint64_t v = m2 / (count - 1);
+	return v > UINT32_MAX ? UINT32_MAX : (uint32_t)v;
+}
+
+int32_t Calibration::getMicroVolts() const
+{
+	return (int32_t)(((int64_t)mean * nvPerCount) >> 8) / 1000L;
+}
+
+uint32_t Calibration::getNoise() const
+{
+	// isqrt of Q16 is Q8
+	return ((uint32_t)isqrt32(variance()) * nvPerCount) >> 8;
+}
+
+calibration_status_t Calibration::update(int16_t recentAverage, uint32_t now)
+{
+	uint32_t elapsed = now - start;
+	if (elapsed < CALIBRATION_MIN_TIME || count < 2) return CALIBRATION_BUSY;
+
+	// the same range as in air
+	int32_t microVolts = getMicroVolts() * 2095L / getReference();
+	if (microVolts < CALIBRATION_MIN_UV || microVolts > CALIBRATION_MAX_UV) {
+		return CALIBRATION_RANGE;
+	}
+	// a drift also spreads the samples, check it first
+	int32_t drift = (int32_t)(((((int64_t)recentAverage << 8) - mean) * nvPerCount) >> 8); // nV
+	if (drift > CALIBRATION_MAX_DRIFT * 1000L || drift < -CALIBRATION_MAX_DRIFT * 1000L) {
+		return CALIBRATION_DRIFT;
+	}
+	uint32_t noise = getNoise();
+	if (noise > CALIBRATION_MAX_NOISE * 1000ul) {
+		return CALIBRATION_NOISY;
+	}
+	// standard error of the mean = noise / sqrt(n)
+	if ((uint64_t)noise * noise <= (uint64_t)CALIBRATION_MAX_STDERR * CALIBRATION_MAX_STDERR * count) {
+		return CALIBRATION_DONE;
+	}
+	if (elapsed >= CALIBRATION_TIME) return CALIBRATION_NOISY;
+	return CALIBRATION_BUSY;
+}
+
+// counts * gain = concentration, with the gain in Q14 and the counts in Q8
+// (and the other way round)
+static uint32_t gainFor(uint16_t concentration, int32_t counts)
+{
+	if (counts <= 0) return UINT32_MAX;
+	return (((uint64_t)concentration << (CALIBRATION_GAIN_SHIFT + 8)) + counts / 2) / counts;
+}
+
+calibration_status_t Calibration::fit(calibration_model_t* model) const
+{
+	uint32_t gain;
+	int32_t offset = (int32_t)model->offset << 8;
+	if (gas == CALIBRATION_AIR) {
+		// the offset of the cell is stable, only its sensitivity changes
+		gain = gainFor(2095, mean - offset);
+	}
+	else if (model->gain == 0) {
+		// no air point yet: through zero
+		gain = gainFor(10000, mean);
+		offset = 0;
+	}
+	else {
+		int32_t air = offset + (int32_t)gainFor(2095, model->gain);
+		// the air point alone would read this in O2
+		int32_t predicted = (int32_t)(((int64_t)mean * 2095 + air / 2) / air);
+		if (predicted > 10000 + CALIBRATION_MAX_NONLINEARITY
+			|| predicted < 10000 - CALIBRATION_MAX_NONLINEARITY) {
+			return CALIBRATION_NONLINEAR;
+		}
+		gain = gainFor(10000 - 2095, mean - air);
+		if (gain != 0 && gain <= UINT16_MAX) {
+			offset = air - (int32_t)gainFor(2095, gain);
+		}
+	}
+	if (gain == 0 || gain > UINT16_MAX) return CALIBRATION_RANGE;
+	model->gain = (uint16_t)gain;
+	model->offset = (int16_t)((offset + 128) >> 8);
+	return CALIBRATION_DONE;
+}
@@ -0,0 +1,66 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#include "display.h"
+
+#ifdef TWI_QUEUE
+
+#include <TwiQueue.h>
+
+// u8x8 never sends more than 32 bytes per transfer (size of the Wire buffer)
+#define DISPLAY_TWI_SLOT_SIZE 32
+
+struct DisplaySlot {
+	TwiTransaction t;
+	uint8_t data[DISPLAY_TWI_SLOT_SIZE];
+};
+
+static DisplaySlot slots[DISPLAY_TWI_SLOTS];
+static uint8_t slotIndex = 0;
+
+uint8_t u8x8_byte_twi_queue(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr)
+{
+	DisplaySlot* slot = &slots[slotIndex];
+	uint8_t* data;
+
+	switch (msg) {
+	case U8X8_MSG_BYTE_SEND:
+		data = (uint8_t*)arg_ptr;
+		while (arg_int-- > 0 && slot->t.writeLength < DISPLAY_TWI_SLOT_SIZE) {
+			slot->data[slot->t.writeLength++] = *data++;
+		}
+		break;
+	case U8X8_MSG_BYTE_INIT:
+	case U8X8_MSG_BYTE_SET_DC:
+		break;
+	case U8X8_MSG_BYTE_START_TRANSFER:
+		// slots are used in turn, wait for the oldest one to be sent
+		while (slot->t.status == TWIQ_PENDING) {
+			twiQueue.wait();
+		}
+		slot->t.address = u8x8_GetI2CAddress(u8x8) >> 1;
+		slot->t.writeData = slot->data;
+		slot->t.writeLength = 0;
+		slot->t.readLength = 0;
+		slot->t.callback = NULL;
+		break;
+	case U8X8_MSG_BYTE_END_TRANSFER:
+		twiQueue.submit(&slot->t);
+		slotIndex = (slotIndex + 1) % DISPLAY_TWI_SLOTS;
+		break;
+	default:
+		return 0;
+	}
+	return 1;
+}
+
+#endif // TWI_QUEUE
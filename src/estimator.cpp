@@ -0,0 +1,119 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#include "estimator.h"
+
+#include <stdlib.h>
+
+#define HISTORY_SIZE (2 * MAX_SPAN + 1)
+#define PREDICTIONS  (sizeof(predictions) / sizeof(predictions[0]))
+
+// only learn from changes bigger than this (0.01% O2), smaller ones are noise
+#define LEARN_MIN_CHANGE 30
+
+/**
+ * G = 1 / (e^x - 1) for x = T / tau, Q8
+ * Laurent series 1/x - 1/2 + x/12, good to 0.1% for x < 1
+ */
+static uint16_t gainFromTimeConstant(uint32_t T, uint32_t tau)
+{
+	int32_t g = (int32_t)((256ul * tau) / T) - 128 + (int32_t)((256ul * T) / (12ul * tau));
+	return g < 1 ? 1 : (g > UINT16_MAX ? UINT16_MAX : (uint16_t)g);
+}
+
+ExponentialEstimator::ExponentialEstimator(uint8_t span, uint16_t period, uint16_t timeConstant) :
+	span(span > MAX_SPAN ? MAX_SPAN : span),
+	period(period)
+{
+	uint32_t T = (uint32_t)this->span * period;
+	gain = gainFromTimeConstant(T, timeConstant);
+	// learned time constant stays within tau / 4 .. 4 tau
+	minGain = gainFromTimeConstant(T, timeConstant / 4);
+	maxGain = gainFromTimeConstant(T, 4ul * timeConstant);
+	reset();
+}
+
+void ExponentialEstimator::reset()
+{
+	index = 0;
+	count = 0;
+	prediction = 0;
+	predictionIndex = 0;
+	predictionCount = 0;
+}
+
+int16_t ExponentialEstimator::reading(uint8_t age) const
+{
+	int8_t i = (int8_t)index - 1 - (int8_t)age;
+	if (i < 0) i += HISTORY_SIZE;
+	return history[i];
+}
+
+void ExponentialEstimator::update(int16_t value)
+{
+	history[index] = value;
+	index = (index + 1) % HISTORY_SIZE;
+	if (count < HISTORY_SIZE) count++;
+
+	if (count <= 2 * span) {
+		prediction = value;
+		predictionCount = 0;
+		return;
+	}
+
+	int16_t y0 = reading(2 * span);
+	int16_t y1 = reading(span);
+	int16_t d1 = y1 - y0;
+	int16_t d2 = value - y1;
+
+	// learn a = d2 / d1 from a clean approach: same direction, decaying
+	if (abs(d1) >= LEARN_MIN_CHANGE && (int32_t)d1 * d2 > 0 && abs(d2) < abs(d1)) {
+		uint16_t a = (uint16_t)(((int32_t)d2 * 32768L) / d1); // Q15
+		uint32_t g = ((uint32_t)a * 256ul) / (32768ul - a);
+		if (g < minGain) g = minGain;
+		if (g > maxGain) g = maxGain;
+		// smooth it, one noisy ratio should not move it much
+		gain = (uint16_t)(((uint32_t)gain * 3 + g) / 4);
+	}
+
+	int32_t p = value + (((int32_t)d2 * gain) >> 8);
+	if (p < 0) p = 0;
+	if (p > 10000) p = 10000;
+	prediction = (int16_t)p;
+
+	predictions[predictionIndex] = prediction;
+	predictionIndex = (predictionIndex + 1) % PREDICTIONS;
+	if (predictionCount < PREDICTIONS) predictionCount++;
+}
+
+uint8_t ExponentialEstimator::getConfidence() const
+{
+	if (predictionCount < PREDICTIONS) return 0;
+	int16_t lo = predictions[0];
+	int16_t hi = predictions[0];
+	for (uint8_t i = 1; i < PREDICTIONS; i++) {
+		if (predictions[i] < lo) lo = predictions[i];
+		if (predictions[i] > hi) hi = predictions[i];
+	}
+	// spread of the last predictions, 0.01% O2
+	uint16_t spread = hi - lo;
+	if (spread <= 10) return 3;
+	if (spread <= 30) return 2;
+	if (spread <= 100) return 1;
+	return 0;
+}
+
+uint16_t ExponentialEstimator::getTimeConstant() const
+{
+	// inverse of the series above: tau ~ T.(G + 1/2)
+	return (uint16_t)(((uint32_t)span * period * (gain + 128)) >> 8);
+}
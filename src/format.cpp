@@ -0,0 +1,66 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#include "format.h"
+
+#define MAX_DIGITS 5
+
+static const uint16_t powersOfTen[MAX_DIGITS] PROGMEM = { 10000, 1000, 100, 10, 1 };
+
+char* formatFixedPoint(char* buffer, int16_t value, uint8_t decimals, uint8_t minDigits)
+{
+	uint16_t remainder;
+	if (value < 0) {
+		*buffer++ = '-';
+		remainder = -(uint16_t)value;
+	}
+	else {
+		remainder = value;
+	}
+	if (minDigits == 0) minDigits = 1;
+	uint8_t printed = decimals + minDigits; // digits printed even if leading zeros
+	bool leading = true;
+	for (uint8_t i = 0; i < MAX_DIGITS; i++) {
+		// digits by repeated subtraction, much cheaper than a division on AVR
+		uint16_t power = pgm_read_word(&powersOfTen[i]);
+		char digit = '0';
+		while (remainder >= power) {
+			remainder -= power;
+			digit++;
+		}
+		uint8_t position = MAX_DIGITS - i;
+		if (leading && digit == '0' && position > printed) continue;
+		leading = false;
+		if (position == decimals) *buffer++ = '.';
+		*buffer++ = digit;
+	}
+	*buffer = '\0';
+	return buffer;
+}
+
+char* formatText(char* buffer, const __FlashStringHelper* text)
+{
+	const char* p = reinterpret_cast<const char*>(text);
+	char c;
+	while ((c = pgm_read_byte(p++)) != '\0') {
+		*buffer++ = c;
+	}
+	*buffer = '\0';
+	return buffer;
+}
+
+char* formatChar(char* buffer, char c)
+{
+	*buffer++ = c;
+	*buffer = '\0';
+	return buffer;
+}
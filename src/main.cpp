@@ -29,204 +29,999 @@
 #include <Arduino.h>
 
 #include <ADS1115.h>
-#include <ClickEncoder.h>
-#include <EEPROM.h>
+#include <EdgeEncoder.h>
 #include <RollingAverage.h>
 #include <U8g2lib.h>
-#include <TimerOne.h>
+#ifdef TWI_QUEUE
+#include <TwiQueue.h>
+#else
 #include <Wire.h>
+#endif
 
+#include "acquisition.h"
+#include "battery.h"
+#include "calibration.h"
 #include "config.h"
+#include "display.h"
+#include "estimator.h"
 #include "nitrox.h"
+#include "power.h"
+#include "profile.h"
+#include "format.h"
+#include "stability.h"
 #include "state.h"
+#include "storage.h"
+#include "tasks.h"
+#include "telemetry.h"
+#include "voting.h"
+
+#if defined(WATCH_ENABLE) && !defined(POWER_ENABLE)
+#error "WATCH_ENABLE needs POWER_ENABLE, sampling starts and stops with the states"
+#endif
+#if defined(BATCH_ENABLE) && !(defined(AUTO_HOLD_ENABLE) && defined(EEPROM_ENABLE))
+#error "BATCH_ENABLE needs AUTO_HOLD_ENABLE and EEPROM_ENABLE, the settled readings are logged"
+#endif
 
 // LCD
+#ifdef TWI_QUEUE
+U8G2_SH1106_128X64_NONAME_2_TWIQ u8g2(U8G2_R0); // 256 bytes framebuffer, background transfers
+#else
 // U8G2_SH1106_128X64_NONAME_1_HW_I2C u8g2(U8G2_R0); // 128 bytes framebuffer
 U8G2_SH1106_128X64_NONAME_2_HW_I2C u8g2(U8G2_R0); // 256 bytes framebuffer
-
-// ADC
-ADS1115 ads;
+#endif
 
 // ROLLING AVERAGE
-int16_t readingsBuffer[SAMPLE_SIZE];
-RollingAverage readings(SAMPLE_SIZE, readingsBuffer);
+// one per cell
+FixedRollingAverage<SAMPLE_SIZE, int16_t, SAMPLE_BITS> readings[CELL_COUNT];
+
+#ifdef DUAL_CELL_ENABLE
+CellVoter voter(CELL_COUNT, CELL_MAX_DIFFERENCE, CELL_DISAGREE_TIME);
+#endif
+
+#ifdef AUTO_HOLD_ENABLE
+StabilityDetector stability(AUTO_HOLD_TOLERANCE, AUTO_HOLD_TIME, AUTO_HOLD_MAX_SLOPE, AUTO_HOLD_MAX_SPREAD);
+int16_t autoHoldValue = 2095; // last final reading, air at power up
+bool autoHoldArmed = false;
+#endif
+
+#ifdef BATCH_ENABLE
+uint16_t batchLogged = 0; // number of the held cylinder, 0 for a manual HOLD
+#endif
+
+#ifdef PREDICTION_ENABLE
+// fed at a fixed number of samples, the fit needs equally spaced points
+ExponentialEstimator estimator(PREDICTION_SPAN, PREDICTION_SAMPLES * ADS_SAMPLE_PERIOD / 1000, CELL_TIME_CONSTANT);
+uint8_t predictionSamples = 0;
+#endif
 
 // ENCODER
-ClickEncoder encoder(ENC_PIN_A, ENC_PIN_B, ENC_PIN_SW, ENC_STEPS);
+// edges of A and B on INT0 / INT1, the button on a pin change interrupt
+#if !((ENC_PIN_A == 2 && ENC_PIN_B == 3) || (ENC_PIN_A == 3 && ENC_PIN_B == 2))
+#error "ENC_PIN_A and ENC_PIN_B must be the external interrupt pins, 2 and 3"
+#endif
+#if ENC_PIN_SW > 7
+#error "ENC_PIN_SW must be on port D, its pin change interrupt is shared with ADS_ALERT_PIN"
+#endif
+EdgeEncoder encoder(ENC_PIN_A, ENC_PIN_B, ENC_PIN_SW, ENC_STEPS, ENC_DEBOUNCE, ENC_HOLD_TIME, ENC_DOUBLE_CLICK_TIME);
 
 int16_t encPosPrev, encPos;
 int8_t encDelta;
 uint8_t buttonState;
 
-void timerIsr()
+void encoderIsr()
 {
-	encoder.service();
+	PROFILE_SCOPE(PROFILE_ENCODER_ISR);
+	encoder.quadratureChange();
+}
+
+ISR(PCINT2_vect)
+{
+	// shared with ALERT/RDY of the ADS1115
+#ifdef ADS_ALERT_PIN
+	acquisitionAlert(encoder.buttonChange());
+#else
+	encoder.buttonChange();
+#endif
 }
 
 // STATE MACHINE
-state_t state;
 state_dialog_t stateCalibMenu;
 state_ppo2_t stateModDisplay;
-uint32_t displayTimer = 0;
-uint32_t analyzeTimer = 0;
-uint32_t calibrateTimer = 0;
-uint32_t batteryTimer = 0;
+Calibration calibration[CELL_COUNT] = {
+	Calibration(ADS_NV_PER_COUNT),
+#ifdef DUAL_CELL_ENABLE
+	Calibration(ADS_NV_PER_COUNT),
+#endif
+};
+calibration_status_t calibrationStatus = CALIBRATION_BUSY;
+uint8_t calibrationCell = 0; // the one that failed
 
 // OTHER
 int16_t batteryVoltage = 0;
-int16_t calibrationFactor = 0; // unit is [1e-1 µV / %], value should be ~5000
+uint8_t batteryCharge = 0; // %
+calibration_model_t calibrationModel[CELL_COUNT]; // not calibrated: gain 0
+int16_t cellConcentration[CELL_COUNT];
+uint8_t cellSuspects = 0; // bit i: cell i disagrees with the other ones
 int16_t oxygenConcentration = 0;
-int32_t sensorMicroVolts;
+int16_t displayConcentration = 0; // on screen: measured, or predicted while the cell settles
+bool predicting = false;
+uint8_t predictionConfidence = 0;
+int32_t sensorMicroVolts[CELL_COUNT];
 char displayFooterBuffer[24];
 bool batteryWarning = false;
+bool displayDimmed = false;
 
 
-// Main render function
-void renderDisplay()
+// Draw the whole screen, U8g2 clips it to the current page
+void drawScreen()
 {
-	u8g2.firstPage();
-	do {
+	char text[24];
+	char* p;
+	// battery badge, inverted when low
+	// the error title takes the whole line, the badge only shows there when low
+	if (state != STATE_ERROR || batteryWarning) {
+		u8g2.setFont(u8g2_font_6x13_tr);
+		p = formatFixed<0>(text, batteryCharge);
+		formatChar(p, '%');
+		uint8_t width = u8g2.getStrWidth(text);
 		if (batteryWarning) {
-			u8g2.setFont(u8g2_font_6x13_tr);
-			u8g2.drawBox(118,0,10,12);
-			u8g2.setFontMode(1); // transparent background
-			u8g2.setDrawColor(2); // XOR
-			u8g2.setCursor(120,10);
-			u8g2.print(F("B"));
-			// reset drawing modes
-			u8g2.setFontMode(0);
-			u8g2.setDrawColor(1);
+			u8g2.drawBox(126 - width,0,width + 2,12);
 		}
-		switch(state) {
-		case STATE_START_SCREEN:
-			// TODO: Add Graphics ?
-			u8g2.setFont(u8g2_font_6x13_tr);
-			u8g2.setCursor(0,10);
-			u8g2.print(F("Nitrox Analyzer"));
-			u8g2.setCursor(0,20);
-			u8g2.print(F("Starting..."));
-			u8g2.setCursor(0,63);
-			u8g2.print(F("Battery: "));
-			u8g2.print(batteryVoltage/1000);
-			u8g2.print(".");
-			u8g2.print((batteryVoltage % 1000) / 10);
-			u8g2.print("V");
-			break;
-		case STATE_ANALYZE:
-		case STATE_HOLD:
-			u8g2.setFont(u8g2_font_6x13_tr);
-			u8g2.setCursor(0,10);
-			if (state == STATE_HOLD) {
-				u8g2.print(F(">>> HOLD <<<"));
+		u8g2.setFontMode(1); // transparent background
+		u8g2.setDrawColor(2); // XOR
+		u8g2.drawStr(127 - width,10,text);
+		// reset drawing modes
+		u8g2.setFontMode(0);
+		u8g2.setDrawColor(1);
+	}
+	switch(state) {
+	case STATE_START_SCREEN:
+		// TODO: Add Graphics ?
+		u8g2.setFont(u8g2_font_6x13_tr);
+		u8g2.setCursor(0,10);
+		u8g2.print(F("Nitrox Analyzer"));
+		u8g2.setCursor(0,20);
+		u8g2.print(F("Starting..."));
+		p = formatText(text, F("Battery: "));
+		p = formatFixed<2>(p, batteryVoltage / 10);
+		formatChar(p, 'V');
+		u8g2.drawStr(0,63,text);
+		break;
+	case STATE_ANALYZE:
+	case STATE_HOLD:
+		u8g2.setFont(u8g2_font_6x13_tr);
+		u8g2.setCursor(0,10);
+#ifdef DUAL_CELL_ENABLE
+		if (cellSuspects != 0) {
+			// before anything else
+			p = formatText(text, state == STATE_HOLD ? F("HOLD, check cell") : F("Check cell"));
+			if (cellSuspects & (cellSuspects - 1)) {
+				formatChar(p, 's');
 			}
 			else {
-				u8g2.print(F("Analyzing"));	
+				p = formatChar(p, ' ');
+				formatFixed<0>(p, __builtin_ctz(cellSuspects) + 1);
 			}
-			//u8g2.setFont(u8g2_font_inb30_mn);
-			u8g2.setFont(u8g2_font_logisoso30_tn);
-			u8g2.setCursor(20,48);
-			// print O2 as a decimal percentage
-			if ((oxygenConcentration / 100) < 10) {
-				u8g2.print("0");
-			}			
-			u8g2.print(oxygenConcentration / 100);
-			u8g2.print(".");
-			if ((oxygenConcentration % 100) < 10) {
-				u8g2.print("0");
+			u8g2.drawStr(0,10,text);
+		}
+		else
+#endif
+#ifdef BATCH_ENABLE
+		if (state == STATE_HOLD && batchLogged != 0) {
+			p = formatText(text, F("Cyl. "));
+			p = formatFixed<0>(p, batchLogged);
+			formatText(p, F(" saved"));
+			u8g2.drawStr(0,10,text);
+		}
+		else
+#endif
+		if (state == STATE_HOLD && predicting) {
+			u8g2.print(F(">>> HOLD ~ <<<"));
+		}
+		else if (state == STATE_HOLD) {
+			u8g2.print(F(">>> HOLD <<<"));
+		}
+		else if (predicting) {
+			// confidence as 1 to 3 stars
+			u8g2.print(F("Predicted "));
+			for (uint8_t i = 0; i < 3; i++) {
+				u8g2.print(i < predictionConfidence ? '*' : '.');
 			}
-			u8g2.println(oxygenConcentration % 100);
-			// print MOD
-			u8g2.setFont(u8g2_font_6x13_tr);
-			u8g2.drawStr(0,63,displayFooterBuffer);
+		}
+		else {
+			u8g2.print(F("Analyzing"));	
+		}
+		//u8g2.setFont(u8g2_font_inb30_mn);
+		u8g2.setFont(u8g2_font_logisoso30_tn);
+		// print O2 as a decimal percentage
+		formatFixed<2>(text, displayConcentration, 2);
+		u8g2.drawStr(20,48,text);
+		// print MOD
+		u8g2.setFont(u8g2_font_6x13_tr);
+		u8g2.drawStr(0,63,displayFooterBuffer);
+		break;
+	case STATE_CALIBRATE_MENU:
+		u8g2.setFont(u8g2_font_6x13_tr);
+		u8g2.setCursor(0,10);
+		u8g2.print(F("Calibrate ?"));
+		u8g2.setFont(u8g2_font_logisoso30_tn);
+		// reference gas
+		u8g2.drawStr(20,48,stateCalibMenu == YES_O2 ? "100.0" : "20.95");
+		u8g2.setFont(u8g2_font_6x13_tr);
+		u8g2.drawBox(stateCalibMenu * 43,53,42,10);
+		u8g2.setFontMode(1); // transparent background
+		u8g2.setDrawColor(2); // XOR
+		u8g2.setCursor(12,63);
+		u8g2.print(F("AIR"));
+		u8g2.setCursor(58,63);
+		u8g2.print(F("O2"));
+		u8g2.setCursor(101,63);
+		u8g2.print(F("NO"));
+		// reset drawing modes
+		u8g2.setFontMode(0);
+		u8g2.setDrawColor(1);
+		break;
+	case STATE_CALIBRATE:
+		u8g2.setFont(u8g2_font_6x13_tr);
+		u8g2.setCursor(30,10);
+		u8g2.print(F("Calibration"));
+		u8g2.setCursor(30,20);
+		u8g2.print(F("in progress"));
+		u8g2.setCursor(21,40);
+		u8g2.print(F("Please wait..."));
+		break;
+	case STATE_ERROR:
+		u8g2.setFont(u8g2_font_6x13_tr);
+		u8g2.setCursor(0,10);
+#ifdef DUAL_CELL_ENABLE
+		p = formatText(text, F("Cell "));
+		p = formatFixed<0>(p, calibrationCell + 1);
+		formatText(p, F(" calib. failed"));
+		u8g2.drawStr(0,10,text);
+#else
+		u8g2.print(F("Calibration failed"));
+#endif
+		u8g2.setCursor(0,30);
+		switch (calibrationStatus) {
+		case CALIBRATION_NOISY:
+			u8g2.print(F("Sensor is noisy"));
 			break;
-		case STATE_CALIBRATE_MENU:
-			u8g2.setFont(u8g2_font_6x13_tr);
-			u8g2.setCursor(0,10);
-			u8g2.print(F("Calibrate ?"));
-			u8g2.setFont(u8g2_font_logisoso30_tn);
-			u8g2.drawStr(20,48,"20.95");
-			u8g2.setFont(u8g2_font_6x13_tr);
-			if (stateCalibMenu == YES) {
-				u8g2.drawBox(0,53,64,10);
-			}
-			else {
-				u8g2.drawBox(63,53,64,10);
-			}
-			u8g2.setFontMode(1); // transparent background
-			u8g2.setDrawColor(2); // XOR
-			u8g2.setCursor(24,63);
-			u8g2.print(F("YES"));
-			u8g2.setCursor(90,63);
-			u8g2.print(F("NO"));
-			// reset drawing modes
-			u8g2.setFontMode(0);
-			u8g2.setDrawColor(1);
+		case CALIBRATION_DRIFT:
+			u8g2.print(F("Sensor is drifting"));
+			break;
+		case CALIBRATION_RANGE:
+			u8g2.print(F("Sensor out of range"));
+			u8g2.setCursor(0,44);
+			u8g2.print(F("Check cell / wiring"));
 			break;
-		case STATE_CALIBRATE:
-			u8g2.setFont(u8g2_font_6x13_tr);
-			u8g2.setCursor(30,10);
-			u8g2.print(F("Calibration"));
-			u8g2.setCursor(30,20);
-			u8g2.print(F("in progress"));
-			u8g2.setCursor(21,40);
-			u8g2.print(F("Please wait..."));
+		case CALIBRATION_NONLINEAR:
+			u8g2.print(F("Cell is not linear"));
+			u8g2.setCursor(0,44);
+			u8g2.print(F("Replace the cell"));
 			break;
-		default: 
+		default:
 			;
 		}
+		u8g2.setCursor(0,63);
+		u8g2.print(F("Click to continue"));
+		break;
+	default: 
+		;
+	}
+}
+
+#ifdef DISPLAY_PARTIAL_UPDATE
+// What is on screen, to find the regions to redraw
+struct {
+	state_t state;
+	state_dialog_t calibMenu;
+	bool batteryWarning;
+	uint8_t batteryCharge;
+	int16_t batteryVoltage;
+	int16_t displayConcentration;
+	bool predicting;
+	uint8_t predictionConfidence;
+	uint8_t cellSuspects;
+	char footer[sizeof(displayFooterBuffer)];
+} displayed;
+bool displayValid = false;
+
+uint8_t dirtyRegions()
+{
+	uint8_t regions = 0;
+	if (!displayValid || displayed.state != state) {
+		regions = REGION_ALL;
+	}
+	if (displayed.batteryWarning != batteryWarning || displayed.batteryCharge != batteryCharge) {
+		regions |= REGION_HEADER;
+	}
+	switch (state) {
+	case STATE_START_SCREEN:
+		if (displayed.batteryVoltage != batteryVoltage) regions |= REGION_FOOTER;
+		break;
+	case STATE_ANALYZE:
+	case STATE_HOLD:
+		if (displayed.displayConcentration != displayConcentration) regions |= REGION_DIGITS;
+		if (displayed.predicting != predicting || displayed.predictionConfidence != predictionConfidence
+			|| displayed.cellSuspects != cellSuspects) {
+			regions |= REGION_HEADER;
+		}
+		if (strcmp(displayed.footer, displayFooterBuffer) != 0) regions |= REGION_FOOTER;
+		break;
+	case STATE_CALIBRATE_MENU:
+		// the digits show the reference gas
+		if (displayed.calibMenu != stateCalibMenu) regions |= REGION_DIGITS | REGION_FOOTER;
+		break;
+	default:
+		;
+	}
+	displayed.state = state;
+	displayed.calibMenu = stateCalibMenu;
+	displayed.batteryWarning = batteryWarning;
+	displayed.batteryCharge = batteryCharge;
+	displayed.batteryVoltage = batteryVoltage;
+	displayed.displayConcentration = displayConcentration;
+	displayed.predicting = predicting;
+	displayed.predictionConfidence = predictionConfidence;
+	displayed.cellSuspects = cellSuspects;
+	strcpy(displayed.footer, displayFooterBuffer);
+	displayValid = true;
+	return regions;
+}
+#endif
+
+// Main render function
+void renderDisplay()
+{
+	PROFILE_SCOPE(PROFILE_RENDER);
+#ifdef DISPLAY_PARTIAL_UPDATE
+	uint8_t regions = dirtyRegions();
+	uint8_t height = u8g2.getBufferTileHeight();
+	for (uint8_t row = 0; row < 8; row += height) {
+		uint8_t page = ((1 << height) - 1) << row;
+		if (regions & page) {
+			u8g2.setBufferCurrTileRow(row);
+			u8g2.clearBuffer();
+			drawScreen();
+			u8g2.sendBuffer();
+		}
+	}
+#else
+	u8g2.firstPage();
+	do {
+		drawScreen();
 	} while ( u8g2.nextPage() );
+#endif
 }
 
 
-void setup()
+// TASKS
+void taskSampling();
+void taskBattery();
+void taskSplash();
+void taskRefresh();
+void taskCalibration();
+void taskRender();
+void taskDim();
+
+// same order as task_id_t
+Task tasks[TASK_COUNT] = {
+	SCHEDULER_TASK(taskSampling, SAMPLING_INTERVAL),
+	SCHEDULER_TASK(taskBattery, BATTERY_INTERVAL),
+	SCHEDULER_TASK(taskSplash, 0),
+	SCHEDULER_TASK(taskRefresh, DISPLAY_REFRESH_RATE),
+	SCHEDULER_TASK(taskCalibration, CALIBRATION_INTERVAL),
+	SCHEDULER_TASK(taskRender, 0),
+	SCHEDULER_TASK(taskDim, 0),
+};
+Scheduler scheduler(tasks, TASK_COUNT);
+
+// redraw the screen at the end of this loop
+void requestRender()
+{
+	scheduler.start(TASK_RENDER);
+}
+
+void beep(uint16_t frequency, uint16_t duration)
+{
+#ifdef BUZZER_ENABLE
+	tone(BUZZER_PIN, frequency, duration);
+#endif
+}
+
+// ADC samples are only taken in the states that use them
+void startSampling()
+{
+#ifdef POWER_ENABLE
+	if (acquisitionRunning()) return;
+	acquisitionStart();
+	// the averages restart from the gas the cells are in now
+	for (uint8_t i = 0; i < CELL_COUNT; i++) {
+		readings[i].begin();
+	}
+#ifdef DUAL_CELL_ENABLE
+	voter.reset();
+	cellSuspects = 0;
+#endif
+	scheduler.start(TASK_SAMPLING);
+#endif
+}
+
+void stopSampling()
+{
+#ifdef POWER_ENABLE
+	acquisitionStop();
+	scheduler.stop(TASK_SAMPLING);
+#endif
+}
+
+// full brightness, dimmed again after DISPLAY_DIM_DELAY without activity
+void wakeDisplay()
+{
+#ifdef POWER_ENABLE
+	if (displayDimmed) {
+		u8g2.setContrast(DISPLAY_CONTRAST);
+		displayDimmed = false;
+	}
+	scheduler.start(TASK_DIM, DISPLAY_DIM_DELAY);
+#endif
+}
+
+int16_t lastSample; // for the EVENT_SAMPLE actions
+uint8_t lastCell;
+
+// every cell has a model
+bool calibrated()
+{
+	for (uint8_t i = 0; i < CELL_COUNT; i++) {
+		if (calibrationModel[i].gain == 0) return false;
+	}
+	return true;
+}
+
+// UI STATE MACHINE, the transition table is in state.cpp
+
+// state entry / exit
+void enterAnalyze()
+{
+	startSampling();
+	// a new reading starts each time we (re)enter ANALYZE
+#ifdef AUTO_HOLD_ENABLE
+	stability.reset();
+#endif
+#ifdef BATCH_ENABLE
+	batchLogged = 0;
+#endif
+#ifdef PREDICTION_ENABLE
+	estimator.reset();
+	predictionSamples = 0;
+#endif
+}
+
+void enterHold()
+{
+	// the reading is final
+	stopSampling();
+#ifdef WATCH_ENABLE
+	// until the gas changes: the ADC watches it, the CPU sleeps
+	if (calibrated() && readings[0].getCount() > 0) {
+		int16_t band = (int16_t)(((uint32_t)WATCH_BAND << CALIBRATION_GAIN_SHIFT) / calibrationModel[0].gain);
+		acquisitionWatch(readings[0].getAverage(), band);
+	}
+#endif
+}
+
+void enterCalibrateMenu()
+{
+	stopSampling();
+	stateCalibMenu = YES_AIR;
+}
+
+void enterCalibrate()
+{
+	startSampling();
+	for (uint8_t i = 0; i < CELL_COUNT; i++) {
+		calibration[i].begin(millis(), stateCalibMenu == YES_O2 ? CALIBRATION_O2 : CALIBRATION_AIR);
+	}
+	scheduler.start(TASK_CALIBRATION, CALIBRATION_INTERVAL);
+}
+
+void exitCalibrate()
+{
+	scheduler.stop(TASK_CALIBRATION);
+}
+
+void enterError()
+{
+	stopSampling();
+	beep(1000, 1000);
+}
+
+// transition actions, they return the next event to process, if any
+event_t beepSplash()
+{
+	beep(4000, 200);
+	scheduler.start(TASK_REFRESH, DISPLAY_REFRESH_RATE);
+	return calibrated() ? EVENT_NONE : EVENT_UNCALIBRATED;
+}
+
+event_t beepClick()
+{
+	beep(2000, 200);
+	return EVENT_NONE;
+}
+
+void updateFooter()
+{
+	uint16_t pO2_max, mod;
+	if (stateModDisplay == MV) {
+#ifdef DUAL_CELL_ENABLE
+		char* p = formatText(displayFooterBuffer, F("Cells:"));
+		for (uint8_t i = 0; i < CELL_COUNT; i++) {
+			p = formatChar(p, ' ');
+			p = formatFixed<2>(p, (int16_t)(sensorMicroVolts[i] / 10));
+		}
+#else
+		char* p = formatText(displayFooterBuffer, F("Sensor: "));
+		p = formatFixed<2>(p, (int16_t)(sensorMicroVolts[0] / 10));
+#endif
+		formatText(p, F(" mV"));
+	}
+	else {
+		switch(stateModDisplay) {
+		case PPO2_1_4:
+			pO2_max = 1400;
+			break;
+		case PPO2_1_5:
+			pO2_max = 1500;
+			break;
+		case PPO2_1_6:
+			pO2_max = 1600;
+			break;
+		default:
+			pO2_max = 1000; // you should not be here...
+		}
+		mod = calc_mod(displayConcentration, pO2_max);
+		char* p = formatText(displayFooterBuffer, F("pO2 "));
+		p = formatFixed<1>(p, pO2_max / 100);
+		p = formatText(p, F(" > MOD "));
+		p = formatFixed<0>(p, mod / 100);
+		formatChar(p, 'm');
+	}
+}
+
+event_t nextModDisplay()
+{
+	stateModDisplay++;
+	updateFooter();
+	return EVENT_NONE;
+}
+
+event_t previousModDisplay()
+{
+	stateModDisplay--;
+	updateFooter();
+	return EVENT_NONE;
+}
+
+event_t refreshFooter()
+{
+	updateFooter();
+	return EVENT_NONE;
+}
+
+event_t refreshReading()
+{
+	event_t event = EVENT_NONE;
+	// nothing measured yet since the ADC was restarted
+	for (uint8_t i = 0; i < CELL_COUNT; i++) {
+		if (readings[i].getCount() == 0) return event;
+	}
+	for (uint8_t i = 0; i < CELL_COUNT; i++) {
+		int16_t average = readings[i].getAverage();
+		sensorMicroVolts[i] = ((int32_t)average * ADS_UV_PER_COUNT_Q10) >> 10;
+		if (sensorMicroVolts[i] <= 0) {
+			// TODO: ERROR BAD SENSOR
+			// adjust threshold ? ex. 5mV ?
+		}
+		// 0 when not calibrated yet
+		int16_t concentration = calibrationConcentration(calibrationModel[i], average);
+		if (concentration < 0) {
+			// TODO: ask for calibration
+			concentration = 0;
+		}
+		else if (concentration > 10200) {
+			// TODO: ERROR MODE
+		}
+		cellConcentration[i] = concentration;
+	}
+#ifdef DUAL_CELL_ENABLE
+	oxygenConcentration = voter.update(cellConcentration, millis());
+	cellSuspects = voter.getSuspects();
+#else
+	oxygenConcentration = cellConcentration[0];
+#endif
+#ifdef PREDICTION_ENABLE
+	predictionConfidence = estimator.getConfidence();
+	predicting = predictionConfidence > 0
+		&& abs(estimator.getPrediction() - oxygenConcentration) > PREDICTION_SETTLED;
+	displayConcentration = predicting ? estimator.getPrediction() : oxygenConcentration;
+#else
+	displayConcentration = oxygenConcentration;
+#endif
+#ifdef AUTO_HOLD_ENABLE
+	// spread of the samples of the noisiest cell, converted to 0.01% O2
+	uint16_t spread = calibrated() ? 0 : UINT16_MAX;
+	for (uint8_t i = 0; i < CELL_COUNT && spread != UINT16_MAX; i++) {
+		uint16_t cellSpread = (uint16_t)(((uint32_t)readings[i].getStdDev() * calibrationModel[i].gain) >> CALIBRATION_GAIN_SHIFT);
+		if (cellSpread > spread) spread = cellSpread;
+	}
+	// don't hold the same gas again (e.g. air after calibration)
+	if (calibrated() && abs(oxygenConcentration - autoHoldValue) > AUTO_HOLD_ARM) {
+		autoHoldArmed = true;
+	}
+	// nor a reading the cells don't agree on
+	if (stability.update(oxygenConcentration, spread, millis()) && autoHoldArmed && cellSuspects == 0) {
+		event = EVENT_STABLE;
+	}
+#endif
+	updateFooter();
+	return event;
+}
+
+event_t autoHold()
+{
+#ifdef AUTO_HOLD_ENABLE
+	autoHoldValue = oxygenConcentration;
+	autoHoldArmed = false;
+	// the measured value is final
+	predicting = false;
+	displayConcentration = oxygenConcentration;
+	updateFooter();
+#endif
+#ifdef BATCH_ENABLE
+	// on to the next cylinder
+	analysis_record_t record = {
+		(uint16_t)oxygenConcentration,
+		calc_mod(oxygenConcentration, 1400),
+		(int16_t)(sensorMicroVolts[0] / 10),
+		(uint16_t)(millis() / 1000)
+	};
+	batchLogged = storageLogAnalysis(&record);
+#ifdef TELEMETRY_ENABLE
+	// the UART drained during the writes, refill it before the next long pass
+	telemetryFlush();
+#endif
+#endif
+	beep(3000, 200);
+	return EVENT_NONE;
+}
+
+event_t predictSample()
+{
+#ifdef PREDICTION_ENABLE
+	// once per round of the cells
+	if (lastCell != CELL_COUNT - 1) return EVENT_NONE;
+	if (++predictionSamples >= PREDICTION_SAMPLES) {
+		predictionSamples = 0;
+#ifdef DUAL_CELL_ENABLE
+		// the same reading as the one shown
+		int16_t concentrations[CELL_COUNT];
+		for (uint8_t i = 0; i < CELL_COUNT; i++) {
+			concentrations[i] = calibrationConcentration(calibrationModel[i], readings[i].getAverage());
+		}
+		estimator.update(voter.combine(concentrations));
+#else
+		estimator.update(calibrationConcentration(calibrationModel[0], readings[0].getAverage()));
+#endif
+	}
+#endif
+	return EVENT_NONE;
+}
+
+#if defined(DEBUG) || defined(PROFILE)
+void printTaskStatistics()
+{
+	for (uint8_t i = 0; i < TASK_COUNT; i++) {
+		const Task* t = scheduler.getTask(i);
+		Serial.print(F("Task ")); Serial.print(i);
+		Serial.print(F(": runs ")); Serial.print(t->runs);
+		Serial.print(F(", avg ")); Serial.print(t->runs ? t->totalRunTime / t->runs : 0);
+		Serial.print(F(" us, max ")); Serial.print(t->maxRunTime);
+		Serial.print(F(" us, late ")); Serial.print(t->maxLateness); Serial.println(F(" ms"));
+	}
+}
+
+event_t printDebug()
+{
+#ifdef PROFILE
+	profileDump(Serial);
+#else
+	for (uint8_t i = 0; i < CELL_COUNT; i++) {
+		Serial.print(F("Cell:             ")); Serial.println(i + 1);
+		Serial.print(F("ADC samples:      ")); Serial.println(acquisitionSamples(i));
+		Serial.print(F("ADC reading:      ")); Serial.println(readings[i].getAverage());
+		Serial.print(F("ADC std dev:      ")); Serial.println(readings[i].getStdDev());
+		Serial.print(F("Sensor µV:        ")); Serial.println(sensorMicroVolts[i]);
+		Serial.print(F("Calib. gain:      ")); Serial.println(calibrationModel[i].gain);
+		Serial.print(F("Calib. offset:    ")); Serial.println(calibrationModel[i].offset);
+	}
+	Serial.print(F("O2 concentration: ")); Serial.println(oxygenConcentration);
+#ifdef PREDICTION_ENABLE
+	Serial.print(F("O2 predicted:     ")); Serial.println(estimator.getPrediction());
+	Serial.print(F("Cell tau (ms):    ")); Serial.println(estimator.getTimeConstant());
+#endif
+	Serial.print(F("Battery:          ")); Serial.println(batteryVoltage);
+	Serial.print(F("ADC I2C txns:     ")); Serial.println(ads.getTransactionCount());
+	Serial.print(F("ADC overruns:     ")); Serial.println(acquisitionOverruns());
+#endif
+	printTaskStatistics();
+	beep(4000, 500);
+	return EVENT_NONE;
+}
+#endif
+
+#if defined(BATCH_ENABLE) && !defined(TELEMETRY_ENABLE)
+event_t dumpLog()
+{
+	storageDumpLog(Serial);
+#if defined(DEBUG) || defined(PROFILE)
+	// the debug dump of ANALYZE follows, HOLD keeps it
+	return printDebug();
+#else
+	beep(4000, 500);
+	return EVENT_NONE;
+#endif
+}
+#endif
+
+event_t selectNext()
+{
+	if (stateCalibMenu < NO) stateCalibMenu = state_dialog_t(stateCalibMenu + 1);
+	return EVENT_NONE;
+}
+
+event_t selectPrevious()
+{
+	if (stateCalibMenu > YES_AIR) stateCalibMenu = state_dialog_t(stateCalibMenu - 1);
+	return EVENT_NONE;
+}
+
+event_t answerDialog()
+{
+	return stateCalibMenu != NO ? EVENT_CONFIRM : EVENT_CANCEL;
+}
+
+event_t calibrationSample()
 {
+	calibration[lastCell].addSample(lastSample);
+	return EVENT_NONE;
+}
+
+event_t checkCalibration()
+{
+	// all the cells are in the reference gas, done once every one is
+	bool busy = false;
+	for (uint8_t i = 0; i < CELL_COUNT; i++) {
+		calibrationStatus = calibration[i].update(readings[i].getAverage(), millis());
+		if (calibrationStatus == CALIBRATION_BUSY) {
+			busy = true;
+		}
+		else if (calibrationStatus != CALIBRATION_DONE) {
+			calibrationCell = i;
+			return EVENT_CALIBRATION_FAILED;
+		}
+	}
+	if (busy) {
+		calibrationStatus = CALIBRATION_BUSY;
+		return EVENT_NONE;
+	}
+	// the previous models are all kept if one of the new points does not fit
+	calibration_model_t models[CELL_COUNT];
+	for (uint8_t i = 0; i < CELL_COUNT; i++) {
+		models[i] = calibrationModel[i];
+		calibrationStatus = calibration[i].fit(&models[i]);
+		if (calibrationStatus != CALIBRATION_DONE) {
+			calibrationCell = i;
+			return EVENT_CALIBRATION_FAILED;
+		}
+	}
+	memcpy(calibrationModel, models, sizeof(models));
+	return EVENT_CALIBRATION_DONE;
+}
+
+event_t saveCalibration()
+{
+	// the model was fitted by checkCalibration()
+#ifdef DEBUG
+	Serial.println(F("Calibration complete"));
+	for (uint8_t i = 0; i < CELL_COUNT; i++) {
+		Serial.print(F("Sensor: ")); Serial.print(calibration[i].getMicroVolts()); Serial.println(F(" µV"));
+		Serial.print(F("Noise: ")); Serial.print(calibration[i].getNoise()); Serial.println(F(" nV"));
+		Serial.print(F("Samples: ")); Serial.println(calibration[i].getCount());
+		Serial.print(F("Calibration gain: ")); Serial.println(calibrationModel[i].gain);
+		Serial.print(F("Calibration offset: ")); Serial.println(calibrationModel[i].offset);
+	}
+#endif
+#ifdef EEPROM_ENABLE
+	calibration_record_t record;
+	memcpy(record.model, calibrationModel, sizeof(record.model));
+	// the noisiest cell
+	uint32_t noise = 0;
+	for (uint8_t i = 0; i < CELL_COUNT; i++) {
+		if (calibration[i].getNoise() > noise) noise = calibration[i].getNoise();
+	}
+	record.noise = (uint16_t)(noise > UINT16_MAX ? UINT16_MAX : noise);
+	storageSaveCalibration(&record);
+#ifdef TELEMETRY_ENABLE
+	// the UART drained during the writes, refill it before the next long pass
+	telemetryFlush();
+#endif
+	#ifdef DEBUG
+	Serial.println(F("Saved to EEPROM"));
+	#endif
+#endif
+#ifdef AUTO_HOLD_ENABLE
+	// the cell is in the reference gas
+	autoHoldValue = calibration[0].getReference();
+	autoHoldArmed = false;
+#endif
+	beep(3000, 500);
+	return EVENT_NONE;
+}
+
+event_t reportCalibrationFailure()
+{
+	// previous calibration is kept
 #ifdef DEBUG
+	Serial.print(F("Calibration failed: ")); Serial.println(calibrationStatus);
+#ifdef DUAL_CELL_ENABLE
+	Serial.print(F("Cell: ")); Serial.println(calibrationCell + 1);
+#endif
+	Serial.print(F("Sensor: ")); Serial.print(calibration[calibrationCell].getMicroVolts()); Serial.println(F(" µV"));
+	Serial.print(F("Noise: ")); Serial.print(calibration[calibrationCell].getNoise()); Serial.println(F(" nV"));
+#endif
+	return EVENT_NONE;
+}
+
+void taskSampling()
+{
+	while (acquisitionRead(&lastSample, &lastCell)) {
+		readings[lastCell].addReading(lastSample);
+		dispatch(EVENT_SAMPLE);
+#ifdef TELEMETRY_ENABLE
+		// the stream carries the first cell
+		if (lastCell == 0) {
+			telemetryStatus(readings[0].getAverage(), oxygenConcentration, calibrationModel[0].gain,
+				calibrationModel[0].offset, batteryVoltage, state, ADS_NV_PER_COUNT);
+		}
+#endif
+	}
+}
+
+void taskBattery()
+{
+	{
+		PROFILE_SCOPE(PROFILE_BATTERY);
+		// read by the ADC interrupt, at the latest by the next run
+		batteryStart();
+	}
+	int16_t voltage;
+	if (!batteryRead(&voltage)) return;
+	batteryVoltage = voltage;
+	// drops follow the average, rises need BATTERY_HYSTERESIS (charging)
+	// so that the load steps (display, buzzer) don't make it flicker
+	uint8_t charge = batteryStateOfCharge(voltage);
+	if (charge < batteryCharge || charge >= batteryCharge + BATTERY_HYSTERESIS) {
+		batteryCharge = charge;
+		batteryWarning = batteryCharge <= BATTERY_LOW;
+		// the badge is on every screen, not all of them are refreshed
+		requestRender();
+	}
+}
+
+void taskSplash()
+{
+	dispatch(EVENT_TIMER);
+}
+
+void taskRefresh()
+{
+	dispatch(EVENT_REFRESH);
+}
+
+void taskCalibration()
+{
+	dispatch(EVENT_TIMER);
+}
+
+void taskRender()
+{
+	renderDisplay();
+}
+
+void taskDim()
+{
+	u8g2.setContrast(DISPLAY_DIM_CONTRAST);
+	displayDimmed = true;
+}
+
+void setup()
+{
+#if defined(DEBUG) || defined(PROFILE)
 	Serial.begin(19200);
 	Serial.println(F("*\n* Nitrox Analyser - DEBUG\n*"));
+#elif defined(BATCH_ENABLE) && !defined(TELEMETRY_ENABLE)
+	Serial.begin(19200); // log dump
+#endif
+#ifdef TELEMETRY_ENABLE
+	telemetryBegin();
 #endif
+#ifdef TWI_QUEUE
+	twiQueue.begin(400000); // SH1106 and ADS1115 both support fast mode
+#else
 	Wire.begin();
+#endif
 
 	u8g2.begin();
 	u8g2.setFont(u8g2_font_6x13_tr);
 	
-	ads.begin();
-	ads.setGain(GAIN_SIXTEEN); // +/- 256mV FSR = 7.812µV resolution
-	ads.setDataRate(DR_16SPS); // 16 sps
-	ads.setMux(MUX_DIFF_0_1);  // sensor is connected between AIN0 (P) and AIN1 (N)
-	ads.writeConfig();
-#ifdef DEBUG
-	Serial.print(F("ADS config: "));
-	Serial.println(ads.readConfig());
+	acquisitionBegin();
+	batteryBegin();
+#ifdef POWER_ENABLE
+	powerBegin();
 #endif
-	ads.startContinuousConversion();
 
-	// Rolling average
-	readings.begin();
+	// Rolling averages
+	for (uint8_t i = 0; i < CELL_COUNT; i++) {
+		readings[i].begin();
+	}
 	
-	// Input processing and debouncing
-	Timer1.initialize(1000); // 1ms
-	Timer1.attachInterrupt(timerIsr);
+	// Inputs, debounced by the main loop
+	encoder.begin();
+	attachInterrupt(digitalPinToInterrupt(ENC_PIN_A), encoderIsr, CHANGE);
+	attachInterrupt(digitalPinToInterrupt(ENC_PIN_B), encoderIsr, CHANGE);
+	*digitalPinToPCMSK(ENC_PIN_SW) |= _BV(digitalPinToPCMSKbit(ENC_PIN_SW));
+	*digitalPinToPCICR(ENC_PIN_SW) |= _BV(digitalPinToPCICRbit(ENC_PIN_SW));
 
 	// initialize variables
 	encPosPrev = encPos;
 	state = STATE_START_SCREEN;
 	stateCalibMenu = NO;
 	stateModDisplay = PPO2_1_6;
-	displayTimer = millis();			// initialize for splash screen
-	batteryTimer = -BATTERY_INTERVAL; 	// force initial reading
 #ifdef EEPROM_ENABLE
-	// Load last calibration factor
-	EEPROM.get(EEPROM_CALIBRATION_ADDRESS, calibrationFactor);
+	// Load last calibration, none: the calibration menu follows the splash screen
+	calibration_record_t record;
+	if (storageLoadCalibration(&record)) {
+		memcpy(calibrationModel, record.model, sizeof(calibrationModel));
+	}
 #ifdef DEBUG
-	Serial.print(F("EEPROM load: ")); Serial.println(calibrationFactor);
+	Serial.print(F("EEPROM load: ")); Serial.print(calibrationModel[0].gain);
+	Serial.print(F(" / ")); Serial.println(calibrationModel[0].offset);
 #endif
+#ifdef BATCH_ENABLE
+	// numbering goes on from the last logged cylinder
+	storageBeginLog();
 #endif
+#endif
+
+	scheduler.start(TASK_SAMPLING);
+	scheduler.start(TASK_BATTERY); // initial reading for the splash screen
+	scheduler.start(TASK_SPLASH, SPLASH_DELAY);
+	wakeDisplay();
+	requestRender();
 }
 
 
 void loop()
 {
-	static bool updateDisplay = true;
+#ifdef POWER_ENABLE
+	// until the interrupt that brings the next task or input, 2 ms at most (timer 0)
+	if (scheduler.timeToNext() > 0) {
+		powerSleep();
+	}
+#endif
+	PROFILE_SCOPE(PROFILE_LOOP);
 
 	// Handle inputs
 	buttonState = encoder.getButton();
@@ -242,186 +1037,36 @@ void loop()
 	}
 #endif
 
-	// ADC readings
-	if (millis() - analyzeTimer >= ANALYZE_INTERVAL) {
-		readings.addReading(ads.readLastConversion());
-		analyzeTimer = millis();
+	switch (buttonState) {
+	case EdgeEncoder::Clicked:
+		dispatch(EVENT_CLICKED);
+		break;
+	case EdgeEncoder::Held:
+		dispatch(EVENT_HELD);
+		break;
+	case EdgeEncoder::DoubleClicked:
+		dispatch(EVENT_DOUBLE_CLICKED);
+		break;
+	default:
+		;
 	}
-
-	// Battery
-	if (millis() - batteryTimer >= BATTERY_INTERVAL) {
-		batteryVoltage = analogRead(A0);
-		// convert ADC reading to mV
-		// ref = 3.3V -> mV = adc * 100 / 31
-		// + factor 2 from divider
-		batteryVoltage *= (10 * 2);
-		batteryVoltage /= 31;
-		batteryVoltage *= 10;
-		if (batteryVoltage <= BATTERY_THRESHOLD) {
-			batteryWarning = true;
-		}
-		batteryTimer = millis();
+	if (encDelta > 0) {
+		dispatch(EVENT_ENCODER_UP);
 	}
-
-	// State machine
-	switch (state) {
-		case STATE_START_SCREEN:
-			if (millis() - displayTimer >= SPLASH_DELAY) {
-				state = STATE_ANALYZE;
-				updateDisplay = true;
-				displayTimer = millis();
-#ifdef BUZZER_ENABLE
-				tone(BUZZER_PIN,4000,200);
-#endif
-			}
-			break;
-		case STATE_ANALYZE:
-		case STATE_HOLD:
-			// handle inputs
-			switch (buttonState) {
-			case ClickEncoder::Clicked:
-				if (state == STATE_ANALYZE) {
-					state = STATE_HOLD;
-				}
-				else {
-					state = STATE_ANALYZE;
-				}
-#ifdef BUZZER_ENABLE
-				tone(BUZZER_PIN,2000,200);
-#endif
-				break;
-			case ClickEncoder::Held:
-				state = STATE_CALIBRATE_MENU;
-				stateCalibMenu = YES;
-				updateDisplay = true;
-				break;
-#ifdef DEBUG
-			case ClickEncoder::DoubleClicked: //6
-				Serial.print(F("ADC reading:      ")); Serial.println(readings.getAverage());
-				Serial.print(F("Sensor µV:        ")); Serial.println(sensorMicroVolts);
-				Serial.print(F("Calib. factor:    ")); Serial.println(calibrationFactor);
-				Serial.print(F("O2 concentration: ")); Serial.println(oxygenConcentration);
-				Serial.print(F("Battery:          ")); Serial.println(batteryVoltage);
-	#ifdef BUZZER_ENABLE
-				tone(BUZZER_PIN,4000,500);
-	#endif
-				break;
-#endif
-			}
-			if (encDelta != 0) {
-				if (encDelta > 0) {
-					stateModDisplay++;
-				}
-				else if (encDelta < 0) {
-					stateModDisplay--;
-				}
-			}
-			if (millis() - displayTimer >= DISPLAY_REFRESH_RATE) {
-				if (state == STATE_ANALYZE) {
-					sensorMicroVolts = ((int32_t)readings.getAverage() * 7812L) / 1000L;
-					if (sensorMicroVolts <= 0) {
-						// TODO: ERROR BAD SENSOR
-						// adjust threshold ? ex. 5mV ?
-					}
-					oxygenConcentration = (int16_t)((sensorMicroVolts * 1000L) / calibrationFactor);
-					if (oxygenConcentration < 0) {
-						// TODO: ask for calibration
-						oxygenConcentration = 0;
-					}
-					else if (oxygenConcentration > 10200) {
-						// TODO: ERROR MODE
-					}
-				}
-				// MOD calculation
-				uint16_t pO2_max, mod;
-				if (stateModDisplay == MV) {
-					sprintf_P(displayFooterBuffer, PSTR("Sensor: %d.%02d mV"), 
-						(int16_t)(sensorMicroVolts / 1000L),
-						(int8_t)((sensorMicroVolts % 1000L) / 10));
-				}
-				else {
-					switch(stateModDisplay) {
-					case PPO2_1_4:
-						pO2_max = 1400;
-						break;
-					case PPO2_1_5:
-						pO2_max = 1500;
-						break;
-					case PPO2_1_6:
-						pO2_max = 1600;
-						break;
-					default:
-						pO2_max = 1000; // you should not be here...
-					}
-					mod = calc_mod(oxygenConcentration, pO2_max);
-					sprintf_P(displayFooterBuffer, PSTR("pO2 %d.%d > MOD %dm"),
-						(uint8_t)(pO2_max / 1000),
-						(uint8_t)((pO2_max % 1000) / 100),
-						(uint8_t)(mod / 100) );
-				}
-				updateDisplay = true;
-				displayTimer = millis();
-			}
-			break;
-		case STATE_CALIBRATE_MENU:
-			if (encDelta != 0) {
-				if (encDelta > 0) {
-					stateCalibMenu = NO;
-				}
-				else if (encDelta < 0) {
-					stateCalibMenu = YES;
-				}
-				updateDisplay = true;
-			}
-			if (buttonState == ClickEncoder::Clicked) {
-				if (stateCalibMenu == YES) {
-					state = STATE_CALIBRATE;
-					calibrateTimer = millis();
-				}
-				else {
-					state = STATE_ANALYZE;
-				}
-				updateDisplay = true;
-			} 
-			break;
-		case STATE_CALIBRATE:
-			// TODO: handle inputs ?
-			if (millis() - calibrateTimer >= CALIBRATION_TIME) {
-				// TODO: check calibration sample quality (e.g. max deviation)
-				// 7812 is ADS resolution in [nV / LSB] at PGA = 16
-				// 2095 is calibration oxygen concentration (20.95% in air)
-				int32_t sensorMicroVolts = ((int32_t)readings.getAverage() * 7812L) / 1000L;
-				calibrationFactor = (int16_t)((sensorMicroVolts * 1000L) / 2095L);
-#ifdef DEBUG
-				Serial.println(F("Calibration complete"));
-				Serial.print(F("Sensor: ")); Serial.print(sensorMicroVolts); Serial.println(F(" µV"));
-				Serial.print(F("Calibration factor:")); Serial.println(calibrationFactor);
-#endif
-#ifdef EEPROM_ENABLE
-				EEPROM.put(EEPROM_CALIBRATION_ADDRESS, calibrationFactor);
-	#ifdef DEBUG
-				Serial.println(F("Saved to EEPROM"));
-	#endif
-#endif
-				state = STATE_ANALYZE;
-				updateDisplay = true;
-#ifdef BUZZER_ENABLE
-				tone(BUZZER_PIN,3000,500);
-#endif
-			}
-			// render
-			break;
-		case STATE_ERROR:
-#ifdef BUZZER_ENABLE
-//			tone(BUZZER_PIN,1000,1000); // would beep continuously - should be activated when entering error mode
-#endif
-			// TODO
-			break;
+	else if (encDelta < 0) {
+		dispatch(EVENT_ENCODER_DOWN);
 	}
-
-	if (updateDisplay) {
-		renderDisplay();
-		updateDisplay = false;
+	if (buttonState != 0 || encDelta != 0) {
+		wakeDisplay();
+	}
+#ifdef WATCH_ENABLE
+	if (acquisitionChanged()) {
+		dispatch(EVENT_GAS_CHANGED);
 	}
+#endif
 
+	scheduler.run();
+#ifdef TELEMETRY_ENABLE
+	telemetryFlush();
+#endif
 }
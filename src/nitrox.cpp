@@ -12,7 +12,136 @@
 
 #include "nitrox.h"
 
-uint16_t calc_mod(uint16_t fO2, uint16_t pO2_max = 1600u)
+#include <Arduino.h>
+
+#define SURFACE_PRESSURE  1000ul // cm, 1bar
+
+/**
+ * Compile time generated table of 2^SHIFT * 10000 / x,
+ * for x = START + i * 2^STEP_BITS, stored in flash
+ *
+ * 1/x is convex, a linear interpolation always overshoots, by up to
+ * h^2/8 * f''(x) mid-step (h: step). Entries are lowered by half of it,
+ * which centers the interpolation error around zero.
+ */
+template <uint16_t... I> struct Indices {};
+template <uint16_t N, uint16_t... I> struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+template <uint16_t... I> struct MakeIndices<0, I...> { typedef Indices<I...> type; };
+
+template <uint16_t START, uint8_t STEP_BITS, uint8_t SHIFT, class INDICES> struct ReciprocalTable;
+
+template <uint16_t START, uint8_t STEP_BITS, uint8_t SHIFT, uint16_t... I>
+struct ReciprocalTable<START, STEP_BITS, SHIFT, Indices<I...> > {
+	// round(2^SHIFT * 10000 * (8x^2 - h^2) / 8x^3)
+	static constexpr uint32_t entry(uint32_t x)
+	{
+		return (((10000ull << SHIFT) * (8ull * x * x - (1ull << (2 * STEP_BITS)))) + 4ull * x * x * x) / (8ull * x * x * x);
+	}
+	static constexpr uint16_t start = START;
+	static constexpr uint16_t end = START + ((sizeof...(I) - 1) << STEP_BITS);
+	static constexpr uint8_t bits = SHIFT + STEP_BITS;
+	static const uint16_t data[sizeof...(I)];
+
+	/**
+	 * Linear interpolation, x must be in [start, end]
+	 * @return 10000 / x in Q(SHIFT + STEP_BITS)
+	 */
+	static uint32_t at(uint16_t x)
+	{
+		uint16_t offset = x - START;
+		uint16_t i = offset >> STEP_BITS;
+		uint16_t fraction = offset & ((1u << STEP_BITS) - 1);
+		uint16_t a = pgm_read_word(&data[i]);
+		if (fraction == 0) return (uint32_t)a << STEP_BITS;
+		uint16_t b = pgm_read_word(&data[i + 1]);
+		return ((uint32_t)a << STEP_BITS) - (uint16_t)(a - b) * (uint32_t)fraction;
+	}
+};
+
+template <uint16_t START, uint8_t STEP_BITS, uint8_t SHIFT, uint16_t... I>
+const uint16_t ReciprocalTable<START, STEP_BITS, SHIFT, Indices<I...> >::data[sizeof...(I)] PROGMEM = {
+	(uint16_t)entry(START + ((uint32_t)I << STEP_BITS))...
+};
+
+/**
+ * Rounded value * 10000 / x, x must be in [TABLE::start, TABLE::end]
+ * and value * TABLE::at(x) must fit 32 bits
+ */
+template <class TABLE>
+static inline uint32_t divide(uint16_t value, uint16_t x)
+{
+	return ((uint32_t)value * TABLE::at(x) + (1ul << (TABLE::bits - 1))) >> TABLE::bits;
+}
+
+// 1 / fO2, from 20.48% to 100% by 0.32% steps (500 bytes)
+#define FO2_SHIFT      13
+#define FO2_STEP_BITS  5
+typedef ReciprocalTable<2048, FO2_STEP_BITS, FO2_SHIFT, MakeIndices<250>::type> fO2Reciprocal;
+
+// 1 / absolute pressure, from 0 to 10.48m by 16cm steps where 1/x is the
+// most curved, then to 66.56m by 32cm steps (484 bytes)
+typedef ReciprocalTable<SURFACE_PRESSURE, 4, 12, MakeIndices<66>::type> shallowPressureReciprocal;
+typedef ReciprocalTable<shallowPressureReciprocal::end, 5, 13, MakeIndices<176>::type> pressureReciprocal;
+
+static_assert(fO2Reciprocal::entry(fO2Reciprocal::start) <= UINT16_MAX, "fO2 table overflow");
+static_assert(fO2Reciprocal::end >= 10000, "fO2 table too short");
+static_assert(shallowPressureReciprocal::entry(shallowPressureReciprocal::start) <= UINT16_MAX, "pressure table overflow");
+static_assert(pressureReciprocal::entry(pressureReciprocal::start) <= UINT16_MAX, "pressure table overflow");
+
+// fN2 / 0.79 in Q15 = (10000 - fO2) * 2^28 / 7900 >> 13
+static constexpr uint32_t N2_AIR_RATIO = ((1ul << 28) + 7900 / 2) / 7900;
+// absolute pressure in bar Q16 = (depth + 1000) * 2^29 / 10000 >> 13
+static constexpr uint32_t CM_TO_BAR = ((1ul << 29) + 10000 / 2) / 10000;
+
+uint16_t calc_mod(uint16_t fO2, uint16_t pO2_max)
+{
+	if (fO2 == 0) return UINT16_MAX; // no sensor signal / not calibrated
+	uint32_t pressure;
+	if (fO2 >= fO2Reciprocal::start && fO2 <= fO2Reciprocal::end) {
+		// pO2_max <= 3000: fits 32 bits
+		pressure = divide<fO2Reciprocal>(pO2_max, fO2);
+	}
+	else {
+		// hypoxic mix or sensor reading out of range, not worth a table
+		pressure = ((uint32_t)pO2_max * 10000ul + fO2 / 2) / (uint32_t)fO2;
+	}
+	if (pressure < SURFACE_PRESSURE) return 0;
+	if (pressure - SURFACE_PRESSURE > UINT16_MAX) return UINT16_MAX;
+	return (uint16_t)(pressure - SURFACE_PRESSURE);
+}
+
+uint16_t calc_ead(uint16_t fO2, uint16_t depth)
+{
+	if (fO2 > 10000) fO2 = 10000;
+	uint16_t ratio = ((10000ul - fO2) * N2_AIR_RATIO + (1ul << 12)) >> 13;
+	uint32_t pressure = ((depth + SURFACE_PRESSURE) * ratio + (1ul << 14)) >> 15;
+	if (pressure < SURFACE_PRESSURE) return 0;
+	if (pressure - SURFACE_PRESSURE > UINT16_MAX) return UINT16_MAX;
+	return (uint16_t)(pressure - SURFACE_PRESSURE);
+}
+
+uint16_t calc_best_mix(uint16_t depth, uint16_t pO2_max)
+{
+	uint32_t pressure = depth + SURFACE_PRESSURE;
+	uint32_t fO2;
+	if (pressure <= shallowPressureReciprocal::end) {
+		fO2 = divide<shallowPressureReciprocal>(pO2_max, pressure);
+	}
+	else if (pressure <= pressureReciprocal::end) {
+		fO2 = divide<pressureReciprocal>(pO2_max, pressure);
+	}
+	else {
+		// deeper than the MOD of air, not worth a table
+		fO2 = ((uint32_t)pO2_max * 10000ul + pressure / 2) / pressure;
+	}
+	return fO2 > 10000 ? 10000 : (uint16_t)fO2;
+}
+
+uint16_t calc_po2(uint16_t fO2, uint16_t depth)
 {
-	return (uint16_t)(((uint32_t)pO2_max * 10000ul) / (uint32_t)fO2) - 1000ul;
-}
\ No newline at end of file
+	// keeps fO2 * pressure within 32 bits
+	if (fO2 > 10000) fO2 = 10000;
+	if (depth > 60000) depth = 60000;
+	uint32_t pressure = ((depth + SURFACE_PRESSURE) * CM_TO_BAR) >> 13;
+	return (uint16_t)((fO2 * pressure + (1ul << 15)) >> 16);
+}
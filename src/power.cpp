@@ -0,0 +1,51 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#include "power.h"
+
+#include <Arduino.h>
+
+void powerBegin()
+{
+	powerPortBegin();
+}
+
+void powerSleep()
+{
+	powerPortSleep();
+}
+
+
+#if defined(__AVR__)
+
+#include <avr/power.h>
+#include <avr/sleep.h>
+
+void powerPortBegin()
+{
+	// SPI and the analog comparator are not used
+	// timer 2 drives the buzzer, the ADC measures the battery
+	power_spi_disable();
+	ACSR |= _BV(ACD);
+}
+
+void powerPortSleep()
+{
+	// an interrupt between the scheduler check and here only costs the
+	// wait for the next timer 0 overflow, 2.048 ms at most at 8 MHz
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	sleep_enable();
+	sleep_cpu();
+	sleep_disable();
+}
+
+#endif // __AVR__
@@ -0,0 +1,99 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#include "profile.h"
+
+#ifdef PROFILE
+
+#include <util/atomic.h>
+
+static ProfileStats sections[PROFILE_SECTIONS];
+
+static const char nameLoop[] PROGMEM = "loop";
+static const char nameRender[] PROGMEM = "render";
+static const char nameAdsRead[] PROGMEM = "ADS read";
+static const char nameBattery[] PROGMEM = "battery";
+static const char nameEncoderIsr[] PROGMEM = "encoder ISR";
+
+// same order as profile_section_t
+static const char* const names[PROFILE_SECTIONS] PROGMEM = {
+	nameLoop,
+	nameRender,
+	nameAdsRead,
+	nameBattery,
+	nameEncoderIsr,
+};
+
+/**
+ * Add a duration to a section, called from ProfileScope
+ * Sections timed in an interrupt must not be timed in the main loop too
+ */
+void profileRecord(uint8_t section, uint16_t duration)
+{
+	ProfileStats* s = &sections[section];
+	if (s->total > UINT32_MAX - duration) {
+		// ~70 min of busy time: halve, the mean is kept
+		s->count >>= 1;
+		s->total >>= 1;
+	}
+	if (s->count == 0 || duration < s->min) s->min = duration;
+	if (duration > s->max) s->max = duration;
+	s->count++;
+	s->total += duration;
+	uint8_t bucket = 0;
+	while (duration >>= 1) {
+		bucket++;
+	}
+	// buckets saturate, rare long runs must not vanish
+	if (s->histogram[bucket] != UINT16_MAX) s->histogram[bucket]++;
+}
+
+/**
+ * Copy of the statistics of a section, safe against interrupts
+ */
+void profileGet(uint8_t section, ProfileStats* stats)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		*stats = sections[section];
+	}
+}
+
+/**
+ * Print all sections, one line per section, then its non empty buckets
+ * as <from µs>:<count>
+ */
+void profileDump(Print& out)
+{
+	ProfileStats s;
+	out.println(F("section      count    min    avg    max (us)"));
+	for (uint8_t i = 0; i < PROFILE_SECTIONS; i++) {
+		profileGet(i, &s);
+		char name[12];
+		strcpy_P(name, (const char*)pgm_read_ptr(&names[i]));
+		out.print(name);
+		for (uint8_t c = strlen(name); c < 11; c++) out.print(' ');
+		out.print(' '); out.print(s.count);
+		out.print(' '); out.print(s.min);
+		out.print(' '); out.print(s.count ? s.total / s.count : 0);
+		out.print(' '); out.println(s.max);
+		if (s.count == 0) continue;
+		out.print(' ');
+		for (uint8_t b = 0; b < PROFILE_BUCKETS; b++) {
+			if (s.histogram[b] == 0) continue;
+			out.print(' '); out.print(b == 0 ? 0 : 1u << b);
+			out.print(':'); out.print(s.histogram[b]);
+		}
+		out.println();
+	}
+}
+
+#endif // PROFILE
@@ -0,0 +1,53 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#include "stability.h"
+
+StabilityDetector::StabilityDetector(int16_t tolerance, uint16_t settleTime, int16_t maxSlope, uint16_t maxSpread) :
+	tolerance(tolerance),
+	settleTime(settleTime),
+	maxSlope(maxSlope),
+	maxSpread(maxSpread)
+{
+	reset();
+}
+
+void StabilityDetector::reset()
+{
+	started = false;
+	stable = false;
+}
+
+bool StabilityDetector::update(int16_t value, uint16_t spread, uint32_t now)
+{
+	int16_t delta = value - reference;
+	if (!started || delta > tolerance || delta < -tolerance || spread > maxSpread) {
+		started = true;
+		stable = false;
+		reference = value;
+		since = now;
+		return false;
+	}
+	uint32_t elapsed = now - since;
+	if (elapsed < settleTime) return false;
+	// slope over the period, per minute
+	int32_t slope = ((int32_t)delta * 60000L) / (int32_t)elapsed;
+	if (slope > maxSlope || slope < -maxSlope) {
+		// still moving: start over from here
+		stable = false;
+		reference = value;
+		since = now;
+		return false;
+	}
+	stable = true;
+	return true;
+}
@@ -0,0 +1,214 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#include "state.h"
+
+#include <Arduino.h>
+
+#include "config.h"
+#include "display.h"
+
+state_t state;
+
+// double click: the debug dump, the log of the cylinders, or nothing
+#if !defined(DEBUG) && !defined(PROFILE)
+#define printDebug NULL
+#endif
+#if !defined(BATCH_ENABLE) || defined(TELEMETRY_ENABLE)
+#define dumpLog printDebug
+#endif
+
+typedef void (*hook_t)(void);
+
+struct state_hooks_t {
+	hook_t entry;
+	hook_t exit;
+};
+
+#define IGNORE                     { STAY, 0, NULL }
+#define INTERNAL(action, redraw)   { STAY, redraw, action }
+#define GOTO(next, action)         { next, REGION_ALL, action }
+
+// same order as state_t
+constexpr state_hooks_t stateHooks[STATE_COUNT] PROGMEM = {
+	/* START_SCREEN   */ { NULL, NULL },
+	/* ANALYZE        */ { enterAnalyze, NULL },
+	/* HOLD           */ { enterHold, NULL },
+	/* CALIBRATE_MENU */ { enterCalibrateMenu, NULL },
+	/* CALIBRATE      */ { enterCalibrate, exitCalibrate },
+	/* ERROR          */ { enterError, NULL },
+};
+
+// [state][event], same order as state_t and event_t
+constexpr transition_t transitions[STATE_COUNT][EVENT_COUNT] PROGMEM = {
+	{ // START_SCREEN
+		/* CLICKED            */ IGNORE,
+		/* HELD               */ IGNORE,
+		/* DOUBLE_CLICKED     */ IGNORE,
+		/* ENCODER_UP         */ IGNORE,
+		/* ENCODER_DOWN       */ IGNORE,
+		/* TIMER              */ GOTO(STATE_ANALYZE, beepSplash),
+		/* REFRESH            */ IGNORE,
+		/* SAMPLE             */ IGNORE,
+		/* STABLE             */ IGNORE,
+		/* CONFIRM            */ IGNORE,
+		/* CANCEL             */ IGNORE,
+		/* CALIBRATION_DONE   */ IGNORE,
+		/* CALIBRATION_FAILED */ IGNORE,
+		/* UNCALIBRATED       */ IGNORE,
+		/* GAS_CHANGED        */ IGNORE,
+	},
+	{ // ANALYZE
+		/* CLICKED            */ GOTO(STATE_HOLD, beepClick),
+		/* HELD               */ GOTO(STATE_CALIBRATE_MENU, NULL),
+		/* DOUBLE_CLICKED     */ INTERNAL(printDebug, 0),
+		/* ENCODER_UP         */ INTERNAL(nextModDisplay, REGION_FOOTER),
+		/* ENCODER_DOWN       */ INTERNAL(previousModDisplay, REGION_FOOTER),
+		/* TIMER              */ IGNORE,
+		/* REFRESH            */ INTERNAL(refreshReading, REGION_HEADER | REGION_DIGITS | REGION_FOOTER),
+		/* SAMPLE             */ INTERNAL(predictSample, 0),
+		/* STABLE             */ GOTO(STATE_HOLD, autoHold),
+		/* CONFIRM            */ IGNORE,
+		/* CANCEL             */ IGNORE,
+		/* CALIBRATION_DONE   */ IGNORE,
+		/* CALIBRATION_FAILED */ IGNORE,
+		/* UNCALIBRATED       */ GOTO(STATE_CALIBRATE_MENU, NULL),
+		/* GAS_CHANGED        */ IGNORE,
+	},
+	{ // HOLD
+		/* CLICKED            */ GOTO(STATE_ANALYZE, beepClick),
+		/* HELD               */ GOTO(STATE_CALIBRATE_MENU, NULL),
+		/* DOUBLE_CLICKED     */ INTERNAL(dumpLog, 0),
+		/* ENCODER_UP         */ INTERNAL(nextModDisplay, REGION_FOOTER),
+		/* ENCODER_DOWN       */ INTERNAL(previousModDisplay, REGION_FOOTER),
+		/* TIMER              */ IGNORE,
+		/* REFRESH            */ INTERNAL(refreshFooter, REGION_FOOTER),
+		/* SAMPLE             */ IGNORE,
+		/* STABLE             */ IGNORE,
+		/* CONFIRM            */ IGNORE,
+		/* CANCEL             */ IGNORE,
+		/* CALIBRATION_DONE   */ IGNORE,
+		/* CALIBRATION_FAILED */ IGNORE,
+		/* UNCALIBRATED       */ IGNORE,
+		/* GAS_CHANGED        */ GOTO(STATE_ANALYZE, NULL),
+	},
+	{ // CALIBRATE_MENU
+		/* CLICKED            */ INTERNAL(answerDialog, 0),
+		/* HELD               */ IGNORE,
+		/* DOUBLE_CLICKED     */ IGNORE,
+		/* ENCODER_UP         */ INTERNAL(selectNext, REGION_DIGITS | REGION_FOOTER),
+		/* ENCODER_DOWN       */ INTERNAL(selectPrevious, REGION_DIGITS | REGION_FOOTER),
+		/* TIMER              */ IGNORE,
+		/* REFRESH            */ IGNORE,
+		/* SAMPLE             */ IGNORE,
+		/* STABLE             */ IGNORE,
+		/* CONFIRM            */ GOTO(STATE_CALIBRATE, NULL),
+		/* CANCEL             */ GOTO(STATE_ANALYZE, NULL),
+		/* CALIBRATION_DONE   */ IGNORE,
+		/* CALIBRATION_FAILED */ IGNORE,
+		/* UNCALIBRATED       */ IGNORE,
+		/* GAS_CHANGED        */ IGNORE,
+	},
+	{ // CALIBRATE
+		/* CLICKED            */ IGNORE,
+		/* HELD               */ IGNORE,
+		/* DOUBLE_CLICKED     */ IGNORE,
+		/* ENCODER_UP         */ IGNORE,
+		/* ENCODER_DOWN       */ IGNORE,
+		/* TIMER              */ INTERNAL(checkCalibration, 0),
+		/* REFRESH            */ IGNORE,
+		/* SAMPLE             */ INTERNAL(calibrationSample, 0),
+		/* STABLE             */ IGNORE,
+		/* CONFIRM            */ IGNORE,
+		/* CANCEL             */ IGNORE,
+		/* CALIBRATION_DONE   */ GOTO(STATE_ANALYZE, saveCalibration),
+		/* CALIBRATION_FAILED */ GOTO(STATE_ERROR, reportCalibrationFailure),
+		/* UNCALIBRATED       */ IGNORE,
+		/* GAS_CHANGED        */ IGNORE,
+	},
+	{ // ERROR
+		/* CLICKED            */ GOTO(STATE_ANALYZE, NULL),
+		/* HELD               */ IGNORE,
+		/* DOUBLE_CLICKED     */ IGNORE,
+		/* ENCODER_UP         */ IGNORE,
+		/* ENCODER_DOWN       */ IGNORE,
+		/* TIMER              */ IGNORE,
+		/* REFRESH            */ IGNORE,
+		/* SAMPLE             */ IGNORE,
+		/* STABLE             */ IGNORE,
+		/* CONFIRM            */ IGNORE,
+		/* CANCEL             */ IGNORE,
+		/* CALIBRATION_DONE   */ IGNORE,
+		/* CALIBRATION_FAILED */ IGNORE,
+		/* UNCALIBRATED       */ IGNORE,
+		/* GAS_CHANGED        */ IGNORE,
+	},
+};
+
+// Compile time checks of the whole table, test/test_state_machine checks each entry
+constexpr bool validTargets(uint8_t i = 0)
+{
+	return i == STATE_COUNT * EVENT_COUNT
+		|| ((transitions[i / EVENT_COUNT][i % EVENT_COUNT].next == STAY
+			|| transitions[i / EVENT_COUNT][i % EVENT_COUNT].next < STATE_COUNT)
+			&& validTargets(i + 1));
+}
+
+// a state can be left, by an event from the user or from a task
+constexpr bool canLeave(uint8_t state, uint8_t event = 0)
+{
+	return event < EVENT_COUNT
+		&& (transitions[state][event].next != STAY || canLeave(state, event + 1));
+}
+
+constexpr bool noDeadEnd(uint8_t state = 0)
+{
+	return state == STATE_COUNT || (canLeave(state) && noDeadEnd(state + 1));
+}
+
+static_assert(validTargets(), "transition to an unknown state");
+static_assert(noDeadEnd(), "a state can not be left");
+static_assert(transitions[STATE_ERROR][EVENT_CLICKED].next == STATE_ANALYZE, "a click must dismiss errors");
+static_assert(transitions[STATE_HOLD][EVENT_GAS_CHANGED].next == STATE_ANALYZE, "a new gas is analyzed");
+static_assert(transitions[STATE_ANALYZE][EVENT_UNCALIBRATED].next == STATE_CALIBRATE_MENU,
+	"an uncalibrated analyzer asks for a calibration");
+static_assert(transitions[STATE_CALIBRATE_MENU][EVENT_CONFIRM].next == STATE_CALIBRATE
+	&& transitions[STATE_CALIBRATE_MENU][EVENT_CANCEL].next == STATE_ANALYZE, "calibration dialog");
+
+transition_t getTransition(state_t from, event_t event)
+{
+	transition_t t;
+	memcpy_P(&t, &transitions[from][event], sizeof(t));
+	return t;
+}
+
+void dispatch(event_t event)
+{
+	while (event != EVENT_NONE) {
+		transition_t t = getTransition(state, event);
+		if (t.next != STAY) {
+			state_hooks_t hooks;
+			memcpy_P(&hooks, &stateHooks[state], sizeof(hooks));
+			if (hooks.exit != NULL) hooks.exit();
+			state = (state_t)t.next;
+			memcpy_P(&hooks, &stateHooks[state], sizeof(hooks));
+			event = t.action != NULL ? t.action() : EVENT_NONE;
+			if (hooks.entry != NULL) hooks.entry();
+			wakeDisplay();
+		}
+		else {
+			event = t.action != NULL ? t.action() : EVENT_NONE;
+		}
+		// dirtyRegions() finds what actually changed
+		if (t.redraw != 0) requestRender();
+	}
+}
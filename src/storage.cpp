@@ -0,0 +1,83 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#include "storage.h"
+
+#ifdef EEPROM_ENABLE
+
+#include <EepromJournal.h>
+
+#include "format.h"
+
+EepromJournal calibrationJournal(EEPROM_CALIBRATION_ADDRESS, EEPROM_CALIBRATION_SIZE,
+	sizeof(calibration_record_t));
+
+bool storageLoadCalibration(calibration_record_t* record)
+{
+	// a single pass over the journal, ~500 bytes
+	if (calibrationJournal.begin() == 0) return false;
+	if (!calibrationJournal.read(record)) return false;
+	for (uint8_t i = 0; i < CELL_COUNT; i++) {
+		if (record->model[i].gain == 0) return false;
+	}
+	return true;
+}
+
+void storageSaveCalibration(const calibration_record_t* record)
+{
+	calibrationJournal.append(record);
+}
+
+#ifdef BATCH_ENABLE
+
+EepromJournal logJournal(EEPROM_LOG_ADDRESS, EEPROM_LOG_SIZE, sizeof(analysis_record_t));
+
+uint8_t storageBeginLog()
+{
+	return logJournal.begin();
+}
+
+// the first record is number 0 in the journal, cylinder 1 on screen
+uint16_t storageLogAnalysis(const analysis_record_t* record)
+{
+	logJournal.append(record);
+	return logJournal.getSequence() + 1;
+}
+
+void storageDumpLog(Print& out)
+{
+	char text[8];
+	out.println(F("cylinder,o2,mod14,mv,uptime"));
+	for (uint8_t age = logJournal.getCount(); age-- > 0;) {
+		analysis_record_t r;
+		uint16_t seq;
+		// one corrupted by a power loss is left out
+		if (!logJournal.read(&r, age, &seq)) continue;
+		// numbered as storageLogAnalysis() did, across the wrap of the sequence
+		out.print((uint16_t)(seq + 1));
+		out.print(',');
+		formatFixed<2>(text, r.concentration);
+		out.print(text);
+		out.print(',');
+		formatFixed<1>(text, r.mod / 10);
+		out.print(text);
+		out.print(',');
+		formatFixed<2>(text, r.cellVoltage);
+		out.print(text);
+		out.print(',');
+		out.println(r.uptime);
+	}
+}
+
+#endif // BATCH_ENABLE
+
+#endif // EEPROM_ENABLE
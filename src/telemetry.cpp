@@ -0,0 +1,142 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#include "telemetry.h"
+
+#ifdef TELEMETRY_ENABLE
+
+#include <Arduino.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
+
+#if defined(DEBUG) || defined(PROFILE)
+#error "TELEMETRY_ENABLE owns Serial, it can not be combined with DEBUG or PROFILE"
+#endif
+
+#if (TELEMETRY_BUFFER & (TELEMETRY_BUFFER - 1)) != 0 || TELEMETRY_BUFFER > 256
+#error "TELEMETRY_BUFFER must be a power of 2, up to 256"
+#endif
+
+#define TELEMETRY_MASK (TELEMETRY_BUFFER - 1)
+#define TELEMETRY_MAX_FRAME 20 // type + seq + payload + crc, < 254 so COBS adds a single byte
+
+// encoded frames, written by queueFrame() and read by telemetryFlush()
+uint8_t telemetryRing[TELEMETRY_BUFFER];
+volatile uint8_t telemetryHead = 0;
+volatile uint8_t telemetryTail = 0;
+uint8_t telemetrySeq = 0;
+uint16_t telemetryDrops = 0;
+
+static inline uint8_t* put16(uint8_t* p, uint16_t value)
+{
+	*p++ = value & 0xFF;
+	*p++ = value >> 8;
+	return p;
+}
+
+/**
+ * Number the frame, append its CRC and COBS encode it into the ring
+ * 
+ * @param frame type at [0], room for the sequence number at [1] and the CRC after the payload
+ * @param length type + seq + payload
+ */
+static void queueFrame(uint8_t* frame, uint8_t length)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		frame[1] = telemetrySeq++;
+		uint16_t crc = 0;
+		for (uint8_t i = 0; i < length; i++) {
+			crc = _crc_xmodem_update(crc, frame[i]);
+		}
+		put16(frame + length, crc);
+		length += 2;
+
+		// COBS overhead byte + delimiter
+		uint8_t head = telemetryHead;
+		if (((telemetryTail - head - 1) & TELEMETRY_MASK) < length + 2) {
+			telemetryDrops++;
+		}
+		else {
+			// each 0x00 is replaced by the distance to the next one
+			uint8_t code = head;
+			uint8_t run = 1;
+			head = (head + 1) & TELEMETRY_MASK;
+			for (uint8_t i = 0; i < length; i++) {
+				if (frame[i] == 0) {
+					telemetryRing[code] = run;
+					code = head;
+					run = 1;
+				}
+				else {
+					telemetryRing[head] = frame[i];
+					run++;
+				}
+				head = (head + 1) & TELEMETRY_MASK;
+			}
+			telemetryRing[code] = run;
+			telemetryRing[head] = 0;
+			telemetryHead = (head + 1) & TELEMETRY_MASK;
+		}
+	}
+}
+
+void telemetryBegin()
+{
+	Serial.begin(TELEMETRY_BAUD);
+}
+
+void telemetryRaw(int16_t conversion)
+{
+	uint8_t frame[TELEMETRY_MAX_FRAME];
+	frame[0] = TELEMETRY_RAW;
+	uint8_t* p = put16(frame + 2, conversion);
+	queueFrame(frame, p - frame);
+}
+
+void telemetryStatus(int16_t average, int16_t fO2, uint16_t gain, int16_t offset, int16_t battery,
+	uint8_t state, uint16_t nvPerCount)
+{
+	uint8_t frame[TELEMETRY_MAX_FRAME];
+	frame[0] = TELEMETRY_STATUS;
+	uint8_t* p = put16(frame + 2, average);
+	p = put16(p, fO2);
+	p = put16(p, gain);
+	p = put16(p, offset);
+	p = put16(p, battery);
+	*p++ = state;
+	p = put16(p, telemetryDropped());
+	p = put16(p, nvPerCount);
+	queueFrame(frame, p - frame);
+}
+
+void telemetryFlush()
+{
+	// only what fits, Serial.write() would wait for the UART otherwise
+	int room = Serial.availableForWrite();
+	uint8_t tail = telemetryTail;
+	while (room-- > 0 && tail != telemetryHead) {
+		Serial.write(telemetryRing[tail]);
+		tail = (tail + 1) & TELEMETRY_MASK;
+	}
+	telemetryTail = tail;
+}
+
+uint16_t telemetryDropped()
+{
+	uint16_t drops;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		drops = telemetryDrops;
+	}
+	return drops;
+}
+
+#endif // TELEMETRY_ENABLE
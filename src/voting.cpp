@@ -0,0 +1,82 @@
+/**
+ * This file is part of
+ * 
+ * NITROX ANALYZER
+ * An Arduino based EANx/Nitrox analyzer
+ * 
+ * MIT License, see LICENSE file
+ * 
+ * Copyright © 2020 Charles Fourneau
+ * 
+ */
+
+#include "voting.h"
+
+CellVoter::CellVoter(uint8_t cells, int16_t tolerance, uint16_t persistence) :
+	cells(cells),
+	tolerance(tolerance),
+	persistence(persistence)
+{
+	reset();
+}
+
+void CellVoter::reset()
+{
+	disagreeing = 0;
+	suspects = 0;
+}
+
+// middle value, or mean of the two middle ones
+static int16_t median(const int16_t* values, uint8_t n)
+{
+	if (n == 1) return values[0];
+	if (n == 2) return (int16_t)(((int32_t)values[0] + values[1]) / 2);
+	int16_t a = values[0], b = values[1], c = values[2];
+	if ((a <= b && b <= c) || (c <= b && b <= a)) return b;
+	if ((b <= a && a <= c) || (c <= a && a <= b)) return a;
+	return c;
+}
+
+int16_t CellVoter::vote(const int16_t* values, uint8_t* outliers) const
+{
+	// the median is not more than tolerance from two cells that agree:
+	// compare with half of it
+	int16_t center = median(values, cells);
+	int16_t limit = cells == 2 ? tolerance / 2 : tolerance;
+	int32_t sum = 0;
+	uint8_t agreeing = 0;
+	int16_t highest = values[0];
+	*outliers = 0;
+	for (uint8_t i = 0; i < cells; i++) {
+		int16_t delta = values[i] - center;
+		if (delta > limit || delta < -limit) {
+			*outliers |= 1 << i;
+		}
+		else {
+			sum += values[i];
+			agreeing++;
+		}
+		if (values[i] > highest) highest = values[i];
+	}
+	if (agreeing == 0) return highest;
+	return (int16_t)((sum + agreeing / 2) / agreeing);
+}
+
+int16_t CellVoter::combine(const int16_t* values) const
+{
+	uint8_t outliers;
+	return vote(values, &outliers);
+}
+
+int16_t CellVoter::update(const int16_t* values, uint32_t now)
+{
+	uint8_t outliers;
+	int16_t reading = vote(values, &outliers);
+	if (outliers != disagreeing) {
+		disagreeing = outliers;
+		since = now;
+	}
+	// agreeing again clears the flags right away
+	suspects = (outliers != 0 && now - since >= persistence) ? outliers : 0;
+	return reading;
+}
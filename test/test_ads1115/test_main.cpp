@@ -0,0 +1,369 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - unit tests
+ *
+ * ADS1115 driver against the register model of the simulation: every
+ * conversion read once on the conversion-ready interrupt, also while the
+ * main code accesses other registers or the pulse edges land around the
+ * read of the pin, threshold encoding, window
+ * comparator configuration, latching and non latching ALERT/RDY,
+ * re-arming, and the switch back to conversion-ready.
+ *
+ * pio test -e native -f test_ads1115
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include <Arduino.h>
+#include <ADS1115.h>
+#include <TwiQueue.h>
+#include <unity.h>
+
+#include "devices.h"
+#include "sim.h"
+
+#define ALERT_PIN 8
+
+static sim::Ads1115Model model;
+static ADS1115 ads;
+
+// differential input of the model, µV
+static int32_t inputMicroVolts;
+
+static int64_t input(uint16_t mux, uint64_t t)
+{
+	(void) mux;
+	(void) t;
+	return (int64_t)inputMicroVolts * 1000;
+}
+
+// let n more conversions complete
+static void convert(uint8_t n)
+{
+	uint32_t target = model.conversions + n;
+	while (model.conversions < target) sim::advance(100);
+}
+
+static bool alert()
+{
+	return digitalRead(ALERT_PIN) == LOW;
+}
+
+// conversion reads queued by the ALERT/RDY interrupt, as the firmware does
+static TwiTransaction readTransaction;
+static uint8_t readBuffer[2];
+static volatile uint32_t samples;
+static volatile uint32_t wrongSamples;  // not the conversion of the input
+static volatile uint32_t overruns;
+
+static void readComplete(TwiTransaction* t)
+{
+	if (t->status != TWIQ_DONE) {
+		overruns++;
+		return;
+	}
+	samples++;
+	if (ADS1115::conversionResult(t) != ads.microVoltsToCounts(inputMicroVolts)) wrongSamples++;
+}
+
+static ADS1115ReadyPulse readyPulse;
+static uint8_t isrLatency;  // µs from the vector entry to the read of the pin
+
+ISR(PCINT0_vect)
+{
+	if (isrLatency > 0) sim::advance(isrLatency);
+	uint8_t level = digitalRead(ALERT_PIN);
+	if (!readyPulse.update(level, PCIFR & _BV(PCIF0), false)) return;
+	if (!ads.queueReadConversion(&readTransaction)) overruns++;
+}
+
+static void enableAlertInterrupt(bool enable)
+{
+	if (enable) {
+		*digitalPinToPCMSK(ALERT_PIN) |= _BV(digitalPinToPCMSKbit(ALERT_PIN));
+		*digitalPinToPCICR(ALERT_PIN) |= _BV(digitalPinToPCICRbit(ALERT_PIN));
+	}
+	else {
+		*digitalPinToPCICR(ALERT_PIN) &= ~_BV(digitalPinToPCICRbit(ALERT_PIN));
+	}
+}
+
+// window of +/-100 µV around 1 mV, 2 conversions in a row to assert
+static void startWindow(bool latching)
+{
+	ads.enableWindowComparator(ads.microVoltsToCounts(900), ads.microVoltsToCounts(1100),
+		COMP_QUEUE_2, latching);
+	ads.startContinuousConversion();
+}
+
+void setUp(void)
+{
+	model.input = input;
+	model.noise = false;
+	model.alertPin = ALERT_PIN;
+	sim::setPin(ALERT_PIN, HIGH);
+	inputMicroVolts = 1000;
+	twiQueue.begin();
+	ads = ADS1115();
+	ads.begin();
+	ads.setCaching(true);
+	ads.setGain(GAIN_SIXTEEN);
+	ads.setDataRate(DR_860SPS);
+	ads.setMux(MUX_DIFF_0_1);
+	model.comparatorAlerts = 0;
+	model.alerts = 0;
+	readyPulse = ADS1115ReadyPulse();
+	isrLatency = 0;
+	readTransaction.readData = readBuffer;
+	readTransaction.callback = readComplete;
+	samples = 0;
+	wrongSamples = 0;
+	overruns = 0;
+}
+
+void tearDown(void)
+{
+	// powered down once the conversion in progress is over
+	ads.stopContinuousConversion();
+	sim::advance(5000);
+	enableAlertInterrupt(false);
+}
+
+void test_every_conversion_read_once(void)
+{
+	ads.enableConversionReady();
+	enableAlertInterrupt(true);
+	uint32_t collected = model.collected;
+	uint32_t dropped = model.dropped;
+	uint32_t duplicated = model.duplicated;
+	ads.startContinuousConversion();
+	sim::advance(1000000);
+	ads.stopContinuousConversion();
+	sim::advance(5000);
+	TEST_ASSERT_EQUAL_UINT32(0, overruns);
+	TEST_ASSERT_EQUAL_UINT32(0, wrongSamples);
+	TEST_ASSERT_GREATER_OR_EQUAL(859, samples);
+	TEST_ASSERT_EQUAL_UINT32(samples, model.collected - collected);
+	TEST_ASSERT_EQUAL_UINT32(0, model.dropped - dropped);
+	TEST_ASSERT_EQUAL_UINT32(0, model.duplicated - duplicated);
+	// a read with the pointer already on CONVERSION, after the first one
+	TEST_ASSERT_EQUAL_UINT8(0, readTransaction.writeLength);
+}
+
+void test_register_access_during_sampling(void)
+{
+	ads.enableConversionReady();
+	enableAlertInterrupt(true);
+	ads.startContinuousConversion();
+	// the main code writes and reads other registers while the interrupt
+	// reads conversions, at every phase of the conversion cycle: none of
+	// them may be taken for a sample
+	for (uint16_t i = 0; i < 200; i++) {
+		sim::advance(3000 + 13 * i);
+		ads.setThresholds(0x0000 + i, 0x8000 + i);
+		sim::advance(3000 + 7 * i);
+		TEST_ASSERT_EQUAL_HEX16(ADS1115_REG_CONFIG_DR_860SPS, ads.readConfig() & ADS1115_REG_CONFIG_DR_MASK);
+		sim::advance(3000 + 11 * i);
+		ads.writeConfig();
+	}
+	ads.stopContinuousConversion();
+	sim::advance(5000);
+	TEST_ASSERT_GREATER_OR_EQUAL(100, samples);
+	TEST_ASSERT_EQUAL_UINT32(0, wrongSamples);
+	TEST_ASSERT_EQUAL_UINT32(0, overruns);
+	TEST_ASSERT_EQUAL_UINT32(0, model.duplicated);
+}
+
+void test_pulse_edges_around_the_read(void)
+{
+	ads.enableConversionReady();
+	enableAlertInterrupt(true);
+	uint32_t alerts = model.alerts;
+	ads.startContinuousConversion();
+	for (uint16_t i = 0; i < 300; i++) {
+		uint8_t phase = i % 3;
+		if (phase == 0) {
+			// the rising edge lands after the vector was entered, before the
+			// read: high, and the interrupt runs again for that edge
+			isrLatency = 9 + i % 5;
+			sim::advance(1163);
+		}
+		else if (phase == 1) {
+			// read during the pulse
+			isrLatency = i % 7;
+			sim::advance(1163);
+		}
+		else {
+			// interrupts blocked over the whole pulse: one call, both edges over
+			isrLatency = 0;
+			uint32_t next = model.alerts + 1;
+			cli();
+			while (model.alerts < next) sim::advance(20);
+			sim::advance(20);
+			sei();
+		}
+	}
+	isrLatency = 0;
+	ads.stopContinuousConversion();
+	sim::advance(5000);
+	TEST_ASSERT_GREATER_OR_EQUAL(250, samples);
+	TEST_ASSERT_EQUAL_UINT32(model.alerts - alerts, samples);
+	TEST_ASSERT_EQUAL_UINT32(0, overruns);
+	TEST_ASSERT_EQUAL_UINT32(0, wrongSamples);
+	TEST_ASSERT_EQUAL_UINT32(0, model.duplicated);
+}
+
+void test_threshold_encoding(void)
+{
+	// 7.8125 µV per count at +/-0.256 V
+	TEST_ASSERT_EQUAL_INT16(128, ads.microVoltsToCounts(1000));
+	TEST_ASSERT_EQUAL_INT16(-128, ads.microVoltsToCounts(-1000));
+	TEST_ASSERT_EQUAL_INT32(1000, ads.countsToMicroVolts(128));
+	TEST_ASSERT_EQUAL_INT16(INT16_MAX, ads.microVoltsToCounts(256000));
+	TEST_ASSERT_EQUAL_INT16(INT16_MIN, ads.microVoltsToCounts(-300000));
+	// 125 µV per count at +/-4.096 V
+	ads.setGain(GAIN_ONE);
+	TEST_ASSERT_EQUAL_INT16(8, ads.microVoltsToCounts(1000));
+	TEST_ASSERT_EQUAL_INT16(32000, ads.microVoltsToCounts(4000000));
+	TEST_ASSERT_EQUAL_INT32(-4000000, ads.countsToMicroVolts(-32000));
+	// 187.5 µV per count at +/-6.144 V, within 32 bits at full scale
+	ads.setGain(GAIN_TWOTHIRDS);
+	TEST_ASSERT_EQUAL_INT16(32000, ads.microVoltsToCounts(6000000));
+	TEST_ASSERT_EQUAL_INT16(INT16_MAX, ads.microVoltsToCounts(6144000));
+}
+
+void test_window_registers(void)
+{
+	ads.enableWindowComparator(-100, 250, COMP_QUEUE_4, true);
+	// thresholds are written right away, the configuration on the next write
+	TEST_ASSERT_EQUAL_HEX16(0xFF9C, model.lowThreshold);
+	TEST_ASSERT_EQUAL_HEX16(0x00FA, model.highThreshold);
+	ads.writeConfig();
+	TEST_ASSERT_EQUAL_HEX16(ADS1115_REG_CONFIG_CMODE_WINDOW | ADS1115_REG_CONFIG_CPOL_ACTVLOW
+		| ADS1115_REG_CONFIG_CLAT_LATCH | ADS1115_REG_CONFIG_CQUE_4CONV,
+		model.config & (ADS1115_REG_CONFIG_CMODE_MASK | ADS1115_REG_CONFIG_CPOL_MASK
+		| ADS1115_REG_CONFIG_CLAT_MASK | ADS1115_REG_CONFIG_CQUE_MASK));
+	TEST_ASSERT_TRUE(model.comparatorMode());
+	// gain, rate and input are left alone
+	TEST_ASSERT_EQUAL_HEX16(ADS1115_REG_CONFIG_PGA_0_256V | ADS1115_REG_CONFIG_DR_860SPS,
+		model.config & (ADS1115_REG_CONFIG_PGA_MASK | ADS1115_REG_CONFIG_DR_MASK
+		| ADS1115_REG_CONFIG_MUX_MASK));
+	ads.setThresholds(INT16_MIN, INT16_MAX);
+	TEST_ASSERT_EQUAL_HEX16(0x8000, model.lowThreshold);
+	TEST_ASSERT_EQUAL_HEX16(0x7FFF, model.highThreshold);
+}
+
+void test_latching_window(void)
+{
+	startWindow(true);
+	convert(10);
+	TEST_ASSERT_FALSE(alert());
+	// a single conversion out of the window is not enough
+	inputMicroVolts = 1200;
+	convert(1);
+	inputMicroVolts = 1000;
+	convert(1);
+	TEST_ASSERT_FALSE(alert());
+	// two in a row, below the window
+	inputMicroVolts = 800;
+	convert(2);
+	TEST_ASSERT_TRUE(alert());
+	// stays asserted, even back in the window
+	inputMicroVolts = 1000;
+	convert(5);
+	TEST_ASSERT_TRUE(alert());
+	TEST_ASSERT_EQUAL_UINT32(1, model.comparatorAlerts);
+	// until the conversion register is read
+	TEST_ASSERT_EQUAL_INT16(128, ads.readConversion());
+	TEST_ASSERT_FALSE(alert());
+	convert(5);
+	TEST_ASSERT_FALSE(alert());
+	TEST_ASSERT_EQUAL_UINT32(1, model.comparatorAlerts);
+}
+
+void test_non_latching_window(void)
+{
+	startWindow(false);
+	inputMicroVolts = 1150;
+	convert(1);
+	TEST_ASSERT_FALSE(alert());
+	convert(1);
+	TEST_ASSERT_TRUE(alert());
+	// follows the input back
+	inputMicroVolts = 1050;
+	convert(1);
+	TEST_ASSERT_FALSE(alert());
+	inputMicroVolts = 700;
+	convert(2);
+	TEST_ASSERT_TRUE(alert());
+	TEST_ASSERT_EQUAL_UINT32(2, model.comparatorAlerts);
+}
+
+void test_rearm(void)
+{
+	startWindow(true);
+	inputMicroVolts = 1500;
+	convert(2);
+	TEST_ASSERT_TRUE(alert());
+	// released while still out of the window: asserts again 2 conversions later
+	(void) ads.readConversion();
+	TEST_ASSERT_FALSE(alert());
+	convert(1);
+	TEST_ASSERT_FALSE(alert());
+	convert(1);
+	TEST_ASSERT_TRUE(alert());
+	TEST_ASSERT_EQUAL_UINT32(2, model.comparatorAlerts);
+	// window moved around the new value, as the HOLD watch does
+	(void) ads.readConversion();
+	ads.setThresholds(ads.microVoltsToCounts(1400), ads.microVoltsToCounts(1600));
+	convert(10);
+	TEST_ASSERT_FALSE(alert());
+	inputMicroVolts = 1700;
+	convert(2);
+	TEST_ASSERT_TRUE(alert());
+	// a CONFIG write restarts the comparator, deasserted
+	ads.writeConfig();
+	TEST_ASSERT_FALSE(alert());
+	TEST_ASSERT_EQUAL_UINT32(3, model.comparatorAlerts);
+}
+
+void test_back_to_conversion_ready(void)
+{
+	startWindow(true);
+	inputMicroVolts = 2000;
+	convert(2);
+	TEST_ASSERT_TRUE(alert());
+	(void) ads.readConversion();
+	ads.enableConversionReady();
+	ads.writeConfig();
+	TEST_ASSERT_TRUE(model.conversionReadyMode());
+	TEST_ASSERT_EQUAL_HEX16(ADS1115_REG_CONFIG_CQUE_1CONV,
+		model.config & (ADS1115_REG_CONFIG_CMODE_MASK | ADS1115_REG_CONFIG_CPOL_MASK
+		| ADS1115_REG_CONFIG_CLAT_MASK | ADS1115_REG_CONFIG_CQUE_MASK));
+	// a pulse per conversion, whatever the input
+	uint32_t alerts = model.alerts;
+	convert(10);
+	TEST_ASSERT_EQUAL_UINT32(alerts + 10, model.alerts);
+	TEST_ASSERT_EQUAL_UINT32(1, model.comparatorAlerts);
+}
+
+int main(int argc, char** argv)
+{
+	(void) argc;
+	(void) argv;
+	UNITY_BEGIN();
+	RUN_TEST(test_every_conversion_read_once);
+	RUN_TEST(test_register_access_during_sampling);
+	RUN_TEST(test_pulse_edges_around_the_read);
+	RUN_TEST(test_threshold_encoding);
+	RUN_TEST(test_window_registers);
+	RUN_TEST(test_latching_window);
+	RUN_TEST(test_non_latching_window);
+	RUN_TEST(test_rearm);
+	RUN_TEST(test_back_to_conversion_ready);
+	return UNITY_END();
+}
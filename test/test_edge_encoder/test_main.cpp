@@ -0,0 +1,241 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - unit tests
+ *
+ * EdgeEncoder, its interrupt handlers called on each scripted edge of the
+ * contacts: quadrature decoding with bounce and missed edges, button
+ * debouncing, press / hold / release and double click timing.
+ *
+ * pio test -e native -f test_edge_encoder
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include <Arduino.h>
+#include <EdgeEncoder.h>
+#include <unity.h>
+
+#include "sim.h"
+
+#define PIN_A      2
+#define PIN_B      3
+#define PIN_BUTTON 4
+
+// 4 steps per notch, 5 ms debounce, 1200 ms hold, 600 ms double click
+static EdgeEncoder encoder(PIN_A, PIN_B, PIN_BUTTON);
+
+// getButton() events, as the main loop sees them
+static uint16_t events[EdgeEncoder::DoubleClicked + 1];
+
+// one contact edge, and its interrupt
+static void setContact(uint8_t pin, uint8_t level)
+{
+	sim::setPin(pin, level);
+	if (pin == PIN_BUTTON) (void) encoder.buttonChange();
+	else encoder.quadratureChange();
+}
+
+// a contact settles to level after bounces, 200 µs apart
+static void bounceContact(uint8_t pin, uint8_t level, uint8_t bounces)
+{
+	for (uint8_t i = 0; i < bounces; i++) {
+		setContact(pin, level);
+		sim::advance(200);
+		setContact(pin, !level);
+		sim::advance(200);
+	}
+	setContact(pin, level);
+}
+
+// clockwise: B falls first, A B = 11 -> 10 -> 00 -> 01 -> 11
+static void turn(int8_t notches, uint8_t bounces)
+{
+	static const uint8_t CW[4][2] = {{PIN_B, LOW}, {PIN_A, LOW}, {PIN_B, HIGH}, {PIN_A, HIGH}};
+	static const uint8_t CCW[4][2] = {{PIN_A, LOW}, {PIN_B, LOW}, {PIN_A, HIGH}, {PIN_B, HIGH}};
+	const uint8_t (*sequence)[2] = notches > 0 ? CW : CCW;
+	for (int8_t n = 0; n < abs(notches); n++) {
+		for (uint8_t i = 0; i < 4; i++) {
+			bounceContact(sequence[i][0], sequence[i][1], bounces);
+			sim::advance(2000);
+		}
+	}
+}
+
+// call getButton() every ms, as the main loop would
+static void poll(uint16_t ms)
+{
+	for (uint16_t i = 0; i < ms; i++) {
+		sim::advance(1000);
+		events[encoder.getButton()]++;
+	}
+}
+
+static void press(uint8_t bounces)
+{
+	bounceContact(PIN_BUTTON, LOW, bounces);
+}
+
+static void release(uint8_t bounces)
+{
+	bounceContact(PIN_BUTTON, HIGH, bounces);
+}
+
+void setUp(void)
+{
+	sim::setPin(PIN_A, HIGH);
+	sim::setPin(PIN_B, HIGH);
+	sim::setPin(PIN_BUTTON, HIGH);
+	encoder = EdgeEncoder(PIN_A, PIN_B, PIN_BUTTON);
+	encoder.begin();
+	memset(events, 0, sizeof(events));
+}
+
+void tearDown(void)
+{
+}
+
+void test_notch_clockwise(void)
+{
+	turn(1, 0);
+	TEST_ASSERT_EQUAL_INT16(1, encoder.getValue());
+	TEST_ASSERT_EQUAL_INT16(0, encoder.getValue());
+}
+
+void test_notches_counter_clockwise(void)
+{
+	turn(-3, 0);
+	TEST_ASSERT_EQUAL_INT16(-3, encoder.getValue());
+}
+
+void test_contact_bounce_cancels_out(void)
+{
+	turn(2, 3);
+	TEST_ASSERT_EQUAL_INT16(2, encoder.getValue());
+	turn(-1, 5);
+	TEST_ASSERT_EQUAL_INT16(-1, encoder.getValue());
+}
+
+void test_missed_edge_counts_nothing(void)
+{
+	// both contacts changed between two interrupts: 11 -> 00
+	sim::setPin(PIN_B, LOW);
+	setContact(PIN_A, LOW);
+	setContact(PIN_B, HIGH);
+	setContact(PIN_A, HIGH);
+	// 2 steps out of 4, the rest of the notch is missing
+	TEST_ASSERT_EQUAL_INT16(0, encoder.getValue());
+}
+
+void test_partial_notch_is_kept(void)
+{
+	setContact(PIN_B, LOW);
+	setContact(PIN_A, LOW);
+	TEST_ASSERT_EQUAL_INT16(0, encoder.getValue());
+	setContact(PIN_B, HIGH);
+	setContact(PIN_A, HIGH);
+	TEST_ASSERT_EQUAL_INT16(1, encoder.getValue());
+}
+
+void test_click_after_the_double_click_time(void)
+{
+	press(4);
+	poll(150);
+	release(4);
+	poll(590);
+	TEST_ASSERT_EQUAL_UINT16(0, events[EdgeEncoder::Clicked]);
+	poll(20);
+	TEST_ASSERT_EQUAL_UINT16(1, events[EdgeEncoder::Clicked]);
+	TEST_ASSERT_EQUAL_UINT16(0, events[EdgeEncoder::DoubleClicked]);
+	TEST_ASSERT_EQUAL_UINT16(0, events[EdgeEncoder::Held]);
+}
+
+void test_double_click(void)
+{
+	press(3);
+	poll(100);
+	release(3);
+	poll(200);
+	press(3);
+	poll(100);
+	release(3);
+	poll(1000);
+	TEST_ASSERT_EQUAL_UINT16(1, events[EdgeEncoder::DoubleClicked]);
+	TEST_ASSERT_EQUAL_UINT16(0, events[EdgeEncoder::Clicked]);
+}
+
+void test_two_clicks_too_far_apart(void)
+{
+	press(3);
+	poll(100);
+	release(3);
+	poll(700);
+	press(3);
+	poll(100);
+	release(3);
+	poll(700);
+	TEST_ASSERT_EQUAL_UINT16(2, events[EdgeEncoder::Clicked]);
+	TEST_ASSERT_EQUAL_UINT16(0, events[EdgeEncoder::DoubleClicked]);
+}
+
+void test_hold_then_release(void)
+{
+	press(5);
+	poll(1190);
+	TEST_ASSERT_EQUAL_UINT16(0, events[EdgeEncoder::Held]);
+	poll(310);
+	// every call while the button stays down
+	TEST_ASSERT_INT_WITHIN(2, 300, events[EdgeEncoder::Held]);
+	release(5);
+	poll(1000);
+	TEST_ASSERT_EQUAL_UINT16(1, events[EdgeEncoder::Released]);
+	TEST_ASSERT_EQUAL_UINT16(0, events[EdgeEncoder::Clicked]);
+	TEST_ASSERT_EQUAL_UINT16(0, events[EdgeEncoder::DoubleClicked]);
+}
+
+void test_glitch_is_ignored(void)
+{
+	// shorter than the debounce time
+	press(0);
+	poll(3);
+	release(0);
+	poll(1000);
+	for (uint8_t b = EdgeEncoder::Open + 1; b <= EdgeEncoder::DoubleClicked; b++) {
+		TEST_ASSERT_EQUAL_UINT16(0, events[b]);
+	}
+}
+
+void test_click_across_the_millis_overflow(void)
+{
+	// the button times are 16 bits: around a 65.536 s boundary
+	sim::warpTo((sim::now() / 65536000 + 1) * 65536000 - 100000);
+	poll(1);
+	press(3);
+	poll(150);
+	release(3);
+	poll(700);
+	TEST_ASSERT_EQUAL_UINT16(1, events[EdgeEncoder::Clicked]);
+	TEST_ASSERT_EQUAL_UINT16(0, events[EdgeEncoder::Held]);
+}
+
+int main(int argc, char** argv)
+{
+	(void) argc;
+	(void) argv;
+	UNITY_BEGIN();
+	RUN_TEST(test_notch_clockwise);
+	RUN_TEST(test_notches_counter_clockwise);
+	RUN_TEST(test_contact_bounce_cancels_out);
+	RUN_TEST(test_missed_edge_counts_nothing);
+	RUN_TEST(test_partial_notch_is_kept);
+	RUN_TEST(test_click_after_the_double_click_time);
+	RUN_TEST(test_double_click);
+	RUN_TEST(test_two_clicks_too_far_apart);
+	RUN_TEST(test_hold_then_release);
+	RUN_TEST(test_glitch_is_ignored);
+	RUN_TEST(test_click_across_the_millis_overflow);
+	return UNITY_END();
+}
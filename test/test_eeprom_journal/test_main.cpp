@@ -0,0 +1,270 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - unit tests
+ *
+ * EepromJournal, on the EEPROM model of the simulation: records read back
+ * after a reboot, writes torn by a power loss at every byte, wrap of the
+ * sequence numbers and corrupt slots.
+ *
+ * pio test -e native -f test_eeprom_journal
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include <setjmp.h>
+#include <string.h>
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <EepromJournal.h>
+#include <unity.h>
+#include <util/crc16.h>
+
+#include "sim.h"
+
+#define JOURNAL_START  0x100
+#define JOURNAL_SLOTS  5
+#define SLOT_SIZE      (sizeof(uint32_t) + 3)
+
+static jmp_buf powerLost;
+
+// the sim does not return from a power loss, neither does the test
+static void powerLoss()
+{
+	longjmp(powerLost, 1);
+}
+
+// a fresh journal, as after a reboot
+static uint8_t reboot(EepromJournal& journal)
+{
+	journal = EepromJournal(JOURNAL_START, JOURNAL_SLOTS * SLOT_SIZE + 2, sizeof(uint32_t));
+	return journal.begin();
+}
+
+static void append(EepromJournal& journal, uint32_t value)
+{
+	journal.append(&value);
+}
+
+static uint32_t readValue(EepromJournal& journal, uint8_t age, bool expected = true)
+{
+	uint32_t value = 0;
+	TEST_ASSERT_TRUE_MESSAGE(journal.read(&value, age) == expected, "read");
+	return value;
+}
+
+// a slot written by hand, in the format of the header
+static void writeSlot(uint8_t slot, uint32_t value, uint16_t seq)
+{
+	uint16_t a = JOURNAL_START + slot * SLOT_SIZE;
+	const uint8_t* p = (const uint8_t*)&value;
+	uint8_t crc = 0xFF;
+	for (uint8_t i = 0; i < sizeof(value); i++) {
+		crc = _crc8_ccitt_update(crc, p[i]);
+		EEPROM.cells[a++] = p[i];
+	}
+	crc = _crc8_ccitt_update(crc, seq & 0xFF);
+	crc = _crc8_ccitt_update(crc, seq >> 8);
+	EEPROM.cells[a++] = seq & 0xFF;
+	EEPROM.cells[a++] = seq >> 8;
+	EEPROM.cells[a] = crc;
+}
+
+static void corruptSlot(uint8_t slot)
+{
+	EEPROM.cells[JOURNAL_START + slot * SLOT_SIZE + 1] ^= 0x10;
+}
+
+void setUp(void)
+{
+	EEPROM.clear();
+	EEPROM.powerLossAfter = 0;
+	sim::powerLoss = NULL;
+}
+
+void tearDown(void)
+{
+	EEPROM.powerLossAfter = 0;
+	sim::powerLoss = NULL;
+}
+
+void test_empty(void)
+{
+	EepromJournal journal(0, 0, 0);
+	TEST_ASSERT_EQUAL_UINT8(0, reboot(journal));
+	TEST_ASSERT_EQUAL_UINT8(JOURNAL_SLOTS, journal.getSlots());
+	TEST_ASSERT_EQUAL_UINT8(0, journal.getCount());
+	(void) readValue(journal, 0, false);
+	// nothing written outside the region
+	for (uint16_t i = 0; i < SIM_EEPROM_SIZE; i++) {
+		if (i == JOURNAL_START) i += JOURNAL_SLOTS * SLOT_SIZE;
+		TEST_ASSERT_EQUAL_UINT32(0, EEPROM.writes[i]);
+	}
+}
+
+void test_records_after_a_reboot(void)
+{
+	EepromJournal journal(0, 0, 0);
+	(void) reboot(journal);
+	for (uint32_t v = 100; v < 103; v++) append(journal, v);
+	TEST_ASSERT_EQUAL_UINT8(3, reboot(journal));
+	TEST_ASSERT_EQUAL_UINT8(3, journal.getCount());
+	TEST_ASSERT_EQUAL_UINT16(2, journal.getSequence());
+	TEST_ASSERT_EQUAL_UINT32(102, readValue(journal, 0));
+	TEST_ASSERT_EQUAL_UINT32(101, readValue(journal, 1));
+	TEST_ASSERT_EQUAL_UINT32(100, readValue(journal, 2));
+	(void) readValue(journal, 3, false);
+}
+
+void test_laps_spread_the_wear(void)
+{
+	EepromJournal journal(0, 0, 0);
+	(void) reboot(journal);
+	for (uint32_t v = 0; v < 4 * JOURNAL_SLOTS; v++) append(journal, v);
+	TEST_ASSERT_EQUAL_UINT8(JOURNAL_SLOTS, reboot(journal));
+	for (uint8_t age = 0; age < JOURNAL_SLOTS; age++) {
+		TEST_ASSERT_EQUAL_UINT32(4 * JOURNAL_SLOTS - 1 - age, readValue(journal, age));
+	}
+	// the sequence number bytes of every slot, written once per lap
+	for (uint8_t slot = 0; slot < JOURNAL_SLOTS; slot++) {
+		TEST_ASSERT_EQUAL_UINT32(4, EEPROM.writes[JOURNAL_START + slot * SLOT_SIZE + 4]);
+	}
+}
+
+// a power loss during each write of an append, in the first lap and later
+static void tearEveryWrite(uint8_t records)
+{
+	EepromJournal journal(0, 0, 0);
+	(void) reboot(journal);
+	for (uint32_t v = 0; v < records; v++) append(journal, 0x01010101ul * v);
+	uint8_t image[SIM_EEPROM_SIZE];
+	memcpy(image, EEPROM.cells, sizeof(image));
+	uint8_t expectedCount = records < JOURNAL_SLOTS ? records : JOURNAL_SLOTS;
+
+	for (uint32_t n = 1; ; n++) {
+		memcpy(EEPROM.cells, image, sizeof(image));
+		(void) reboot(journal);
+		EEPROM.powerLossAfter = n;
+		sim::powerLoss = powerLoss;
+		if (setjmp(powerLost) == 0) {
+			append(journal, 0xA5A5A5A5ul);
+			// all the writes went through
+			EEPROM.powerLossAfter = 0;
+			TEST_ASSERT_TRUE(n > 3);
+			break;
+		}
+		EEPROM.powerLossAfter = 0;
+		// either the last record is still the newest, or the new one is whole
+		(void) reboot(journal);
+		if (journal.getSequence() == records - 1) {
+			TEST_ASSERT_EQUAL_UINT32(0x01010101ul * (records - 1), readValue(journal, 0));
+			TEST_ASSERT_TRUE(journal.getCount() >= expectedCount - 1);
+		}
+		else {
+			TEST_ASSERT_EQUAL_UINT16(records, journal.getSequence());
+			TEST_ASSERT_EQUAL_UINT32(0xA5A5A5A5ul, readValue(journal, 0));
+		}
+		TEST_ASSERT_EQUAL_UINT32(0x01010101ul * (records - 2), readValue(journal, journal.getSequence() - (records - 2)));
+		// and the next append goes on from there
+		append(journal, 0x5A5A5A5Aul);
+		(void) reboot(journal);
+		TEST_ASSERT_EQUAL_UINT32(0x5A5A5A5Aul, readValue(journal, 0));
+	}
+}
+
+void test_torn_write_first_lap(void)
+{
+	tearEveryWrite(3);
+}
+
+void test_torn_write_over_an_old_record(void)
+{
+	tearEveryWrite(2 * JOURNAL_SLOTS + 2);
+}
+
+void test_sequence_wrap(void)
+{
+	EepromJournal journal(0, 0, 0);
+	writeSlot(0, 1000, 0xFFFC);
+	TEST_ASSERT_EQUAL_UINT8(1, reboot(journal));
+	for (uint32_t v = 1001; v < 1005; v++) append(journal, v);
+	TEST_ASSERT_EQUAL_UINT8(JOURNAL_SLOTS, reboot(journal));
+	// 0xFFFF is the sequence number of an erased slot, skipped
+	TEST_ASSERT_EQUAL_UINT16(1, journal.getSequence());
+	TEST_ASSERT_EQUAL_UINT8(JOURNAL_SLOTS, journal.getCount());
+	for (uint8_t age = 0; age < JOURNAL_SLOTS; age++) {
+		TEST_ASSERT_EQUAL_UINT32(1004 - age, readValue(journal, age));
+	}
+	// the sequence number of each record, not the newest one minus the age
+	static const uint16_t sequences[JOURNAL_SLOTS] = { 1, 0, 0xFFFE, 0xFFFD, 0xFFFC };
+	for (uint8_t age = 0; age < JOURNAL_SLOTS; age++) {
+		uint32_t value;
+		uint16_t seq = 0xFFFF;
+		TEST_ASSERT_TRUE(journal.read(&value, age, &seq));
+		TEST_ASSERT_EQUAL_UINT16(sequences[age], seq);
+	}
+	// newest found whatever slot it is in
+	append(journal, 1005);
+	append(journal, 1006);
+	TEST_ASSERT_EQUAL_UINT8(JOURNAL_SLOTS, reboot(journal));
+	TEST_ASSERT_EQUAL_UINT16(3, journal.getSequence());
+	TEST_ASSERT_EQUAL_UINT32(1006, readValue(journal, 0));
+	TEST_ASSERT_EQUAL_UINT32(1002, readValue(journal, 4));
+}
+
+void test_corrupt_slot_in_the_middle(void)
+{
+	EepromJournal journal(0, 0, 0);
+	(void) reboot(journal);
+	for (uint32_t v = 0; v < JOURNAL_SLOTS; v++) append(journal, v);
+	corruptSlot(2);
+	TEST_ASSERT_EQUAL_UINT8(JOURNAL_SLOTS - 1, reboot(journal));
+	TEST_ASSERT_EQUAL_UINT8(JOURNAL_SLOTS, journal.getCount());
+	TEST_ASSERT_EQUAL_UINT32(4, readValue(journal, 0));
+	TEST_ASSERT_EQUAL_UINT32(3, readValue(journal, 1));
+	(void) readValue(journal, 2, false);
+	// past the corrupt one
+	TEST_ASSERT_EQUAL_UINT32(1, readValue(journal, 3));
+	TEST_ASSERT_EQUAL_UINT32(0, readValue(journal, 4));
+}
+
+void test_corrupt_oldest_and_newest(void)
+{
+	EepromJournal journal(0, 0, 0);
+	(void) reboot(journal);
+	for (uint32_t v = 0; v < 7; v++) append(journal, v);
+	// slots 0 1 2 3 4 hold 5 6 2 3 4: newest in slot 1, oldest in slot 2
+	corruptSlot(1);
+	corruptSlot(2);
+	TEST_ASSERT_EQUAL_UINT8(3, reboot(journal));
+	TEST_ASSERT_EQUAL_UINT16(5, journal.getSequence());
+	TEST_ASSERT_EQUAL_UINT8(3, journal.getCount());
+	TEST_ASSERT_EQUAL_UINT32(5, readValue(journal, 0));
+	TEST_ASSERT_EQUAL_UINT32(3, readValue(journal, 2));
+	(void) readValue(journal, 3, false);
+	// the corrupt newest slot is the next one written
+	append(journal, 7);
+	TEST_ASSERT_EQUAL_UINT8(4, reboot(journal));
+	TEST_ASSERT_EQUAL_UINT32(7, readValue(journal, 0));
+	TEST_ASSERT_EQUAL_UINT16(6, journal.getSequence());
+}
+
+int main(int argc, char** argv)
+{
+	(void) argc;
+	(void) argv;
+	UNITY_BEGIN();
+	RUN_TEST(test_empty);
+	RUN_TEST(test_records_after_a_reboot);
+	RUN_TEST(test_laps_spread_the_wear);
+	RUN_TEST(test_torn_write_first_lap);
+	RUN_TEST(test_torn_write_over_an_old_record);
+	RUN_TEST(test_sequence_wrap);
+	RUN_TEST(test_corrupt_slot_in_the_middle);
+	RUN_TEST(test_corrupt_oldest_and_newest);
+	return UNITY_END();
+}
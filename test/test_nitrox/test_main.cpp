@@ -0,0 +1,130 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - unit tests
+ *
+ * Gas calculations against the exact formula over their whole input range,
+ * reciprocal tables and divisions: within 1 unit, 2 units for MOD with pO2
+ * limits above 2400 mbar and EAD deeper than 200m.
+ *
+ * pio test -e test_nitrox
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include <Arduino.h>
+#include <nitrox.h>
+#include <unity.h>
+
+#include <math.h>
+
+// highest pO2 limit, calc_mod() and calc_best_mix() stay within 32 bits
+#define PO2_MAX      3000
+// beyond, calc_mod() and calc_ead() are within 2 units
+#define MOD_1_UNIT   2400
+#define EAD_1_UNIT   20000
+
+static void expectWithin(double bound, double exact, uint16_t actual, uint16_t a, uint16_t b)
+{
+	exact = fmin(exact, UINT16_MAX);
+	if (fabs(actual - exact) <= bound) return;
+	char message[80];
+	snprintf(message, sizeof(message), "inputs %u, %u: %u, exact %.3f, bound %.0f", a, b, actual, exact, bound);
+	TEST_FAIL_MESSAGE(message);
+}
+
+// every fO2, table (20.48% to 100%) and division, saturated MOD
+static void test_mod()
+{
+	for (uint16_t pO2 = 100; pO2 <= PO2_MAX; pO2 += 10) {
+		double bound = pO2 <= MOD_1_UNIT ? 1 : 2;
+		for (uint32_t f = 1; f <= UINT16_MAX; f++) {
+			expectWithin(bound, fmax(0, pO2 * 10000.0 / f - 1000.0), calc_mod(f, pO2), f, pO2);
+		}
+	}
+}
+
+static void test_mod_no_signal()
+{
+	TEST_ASSERT_EQUAL_UINT16(UINT16_MAX, calc_mod(0, 1400));
+	TEST_ASSERT_EQUAL_UINT16(UINT16_MAX, calc_mod(0));
+}
+
+// every depth, both pressure tables and the division beyond them
+static void test_best_mix()
+{
+	for (uint16_t pO2 = 100; pO2 <= PO2_MAX; pO2 += 10) {
+		for (uint32_t d = 0; d <= UINT16_MAX; d++) {
+			expectWithin(1, fmin(10000, pO2 * 10000.0 / (d + 1000.0)), calc_best_mix(d, pO2), d, pO2);
+		}
+	}
+}
+
+// the limits of the firmware, at the surface and just below
+static void test_best_mix_shallow()
+{
+	static const uint16_t limits[] = { 1400, 1500, 1600 };
+	for (uint16_t pO2 : limits) {
+		TEST_ASSERT_EQUAL_UINT16(10000, calc_best_mix(0, pO2));
+		TEST_ASSERT_EQUAL_UINT16(10000, calc_best_mix(pO2 - 1000, pO2));
+		for (uint16_t d = pO2 - 1000; d <= 1000; d++) {
+			expectWithin(1, pO2 * 10000.0 / (d + 1000.0), calc_best_mix(d, pO2), d, pO2);
+		}
+	}
+}
+
+// every fO2 up to 100% and beyond (clamped), saturated EAD
+static void test_ead()
+{
+	for (uint32_t f = 0; f <= 10010; f += (f < 10000 ? 7 : 1)) {
+		double ratio = (10000.0 - fmin(f, 10000)) / 7900.0;
+		for (uint32_t d = 0; d <= UINT16_MAX; d += 11) {
+			expectWithin(d <= EAD_1_UNIT ? 1 : 2, fmax(0, (d + 1000.0) * ratio - 1000.0), calc_ead(f, d), f, d);
+		}
+	}
+	for (uint32_t d = 0; d <= UINT16_MAX; d++) {
+		expectWithin(d <= EAD_1_UNIT ? 1 : 2, fmax(0, (d + 1000.0) * 7900 / 7900.0 - 1000.0), calc_ead(2100, d), 2100, d);
+		expectWithin(d <= EAD_1_UNIT ? 1 : 2, fmax(0, (d + 1000.0) * 6800 / 7900.0 - 1000.0), calc_ead(3200, d), 3200, d);
+	}
+}
+
+// every depth down to 600m, beyond pO2 saturates
+static void test_po2()
+{
+	for (uint32_t f = 0; f <= 10000; f += 7) {
+		for (uint32_t d = 0; d <= 60000; d += 11) {
+			expectWithin(1, f * (d + 1000.0) / 10000.0, calc_po2(f, d), f, d);
+		}
+	}
+	for (uint32_t d = 0; d <= 60000; d++) {
+		expectWithin(1, 10000 * (d + 1000.0) / 10000.0, calc_po2(10000, d), 10000, d);
+		expectWithin(1, 2095 * (d + 1000.0) / 10000.0, calc_po2(2095, d), 2095, d);
+	}
+	TEST_ASSERT_EQUAL_UINT16(calc_po2(10000, 60000), calc_po2(10000, UINT16_MAX));
+	TEST_ASSERT_EQUAL_UINT16(calc_po2(10000, 60000), calc_po2(UINT16_MAX, 60000));
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+int main(int argc, char** argv)
+{
+	(void) argc;
+	(void) argv;
+	UNITY_BEGIN();
+	RUN_TEST(test_mod);
+	RUN_TEST(test_mod_no_signal);
+	RUN_TEST(test_best_mix);
+	RUN_TEST(test_best_mix_shallow);
+	RUN_TEST(test_ead);
+	RUN_TEST(test_po2);
+	return UNITY_END();
+}
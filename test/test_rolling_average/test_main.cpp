@@ -0,0 +1,167 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - unit tests
+ *
+ * FixedRollingAverage against the exact average and variance of the same
+ * window: 32 and 64-bit sums of squares, power of two or not, filling and
+ * full windows, readings at the bounds, saturation.
+ *
+ * pio test -e native -f test_rolling_average
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include <Arduino.h>
+#include <RollingAverage.h>
+#include <unity.h>
+
+static uint16_t seed;
+
+static uint16_t random16()
+{
+	seed ^= seed << 7;
+	seed ^= seed >> 9;
+	seed ^= seed << 8;
+	return seed;
+}
+
+/**
+ * Adds the same readings to a FixedRollingAverage and to a copy of its
+ * window, and checks the average and the variance after each one
+ */
+template <uint8_t N, typename T, uint8_t BITS>
+class Checker {
+public:
+	Checker() : count(0), index(0) {}
+
+	void add(T value) {
+		average.addReading(value);
+		int32_t max = (1L << BITS) - 1;
+		int32_t v = value;
+		if (BITS < 8 * sizeof(T)) v = v > max ? max : (v < -max ? -max : v);
+		window[index] = v;
+		index = (index + 1) % N;
+		if (count < N) count++;
+		check();
+	}
+
+	void check() {
+		int64_t sum = 0, sumSquares = 0;
+		for (uint8_t i = 0; i < count; i++) {
+			sum += window[i];
+			sumSquares += (int64_t)window[i] * window[i];
+		}
+		TEST_ASSERT_EQUAL_UINT8(count, average.getCount());
+		if (count == 0) return;
+		TEST_ASSERT_EQUAL_INT32((int32_t)(sum / count), (int32_t)average.getAverage());
+		uint32_t variance = count < 2 ? 0 : (uint32_t)((sumSquares * count - sum * sum) / ((int64_t)count * count));
+		TEST_ASSERT_EQUAL_UINT32(variance, average.getVariance());
+	}
+
+	FixedRollingAverage<N, T, BITS> average;
+
+private:
+	int32_t window[N];
+	uint8_t count;
+	uint8_t index;
+};
+
+// ADC readings of the firmware: 32-bit sums of squares
+static void test_narrow_power_of_two()
+{
+	Checker<16, int16_t, 14> c;
+	for (uint16_t i = 0; i < 500; i++) c.add((int16_t)(1280 + (random16() & 0x3F) - 32));
+	for (uint16_t i = 0; i < 500; i++) c.add((int16_t)((random16() & 0x7FFF) - 16384));
+}
+
+static void test_narrow_not_power_of_two()
+{
+	Checker<20, int16_t, 13> c;
+	for (uint16_t i = 0; i < 500; i++) c.add((int16_t)((random16() & 0x3FFF) - 8192));
+	Checker<3, int16_t, 15> d;
+	for (uint16_t i = 0; i < 500; i++) d.add((int16_t)random16());
+}
+
+// the largest sums: every reading at the bound, of either sign
+static void test_narrow_bounds()
+{
+	Checker<16, int16_t, 14> c;
+	for (uint8_t i = 0; i < 40; i++) c.add(16383);
+	TEST_ASSERT_EQUAL_UINT32(0, c.average.getVariance());
+	for (uint8_t i = 0; i < 40; i++) c.add(i & 1 ? 16383 : -16383);
+	TEST_ASSERT_EQUAL_UINT32(16383ul * 16383, c.average.getVariance());
+	for (uint8_t i = 0; i < 40; i++) c.add(-16383);
+	TEST_ASSERT_EQUAL_INT16(-16383, c.average.getAverage());
+	TEST_ASSERT_EQUAL_UINT32(0, c.average.getVariance());
+}
+
+static void test_saturation()
+{
+	Checker<16, int16_t, 14> c;
+	c.add(INT16_MAX);
+	c.add(INT16_MIN);
+	c.add(16384);
+	c.add(-16384);
+	TEST_ASSERT_EQUAL_INT16(0, c.average.getAverage());
+	TEST_ASSERT_EQUAL_UINT32(16383ul * 16383, c.average.getVariance());
+}
+
+// full range int16_t: 64-bit sums of squares
+static void test_wide()
+{
+	Checker<16, int16_t, 16> c;
+	for (uint16_t i = 0; i < 500; i++) c.add((int16_t)random16());
+	for (uint8_t i = 0; i < 40; i++) c.add(i & 1 ? INT16_MAX : INT16_MIN);
+	Checker<20, int16_t, 16> d;
+	for (uint16_t i = 0; i < 500; i++) d.add((int16_t)random16());
+}
+
+static void test_unsigned()
+{
+	Checker<8, uint16_t, 16> c;
+	for (uint16_t i = 0; i < 500; i++) c.add(random16());
+	for (uint8_t i = 0; i < 20; i++) c.add(i & 1 ? UINT16_MAX : 0);
+	Checker<255, uint8_t, 8> d;
+	for (uint16_t i = 0; i < 1000; i++) d.add((uint8_t)random16());
+	Checker<200, int8_t, 8> e;
+	for (uint16_t i = 0; i < 1000; i++) e.add((int8_t)random16());
+}
+
+static void test_std_dev()
+{
+	FixedRollingAverage<16, int16_t, 14> average;
+	for (uint8_t i = 0; i < 16; i++) average.addReading(i & 1 ? 1290 : 1270);
+	TEST_ASSERT_EQUAL_UINT32(100, average.getVariance());
+	TEST_ASSERT_EQUAL_UINT16(10, average.getStdDev());
+	average.begin();
+	TEST_ASSERT_EQUAL_UINT8(0, average.getCount());
+	TEST_ASSERT_EQUAL_UINT16(0, average.getStdDev());
+}
+
+void setUp()
+{
+	seed = 0xACE1;
+}
+
+void tearDown()
+{
+}
+
+int main(int argc, char** argv)
+{
+	(void) argc;
+	(void) argv;
+	UNITY_BEGIN();
+	RUN_TEST(test_narrow_power_of_two);
+	RUN_TEST(test_narrow_not_power_of_two);
+	RUN_TEST(test_narrow_bounds);
+	RUN_TEST(test_saturation);
+	RUN_TEST(test_wide);
+	RUN_TEST(test_unsigned);
+	RUN_TEST(test_std_dev);
+	return UNITY_END();
+}
@@ -0,0 +1,232 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - unit tests
+ *
+ * Scheduler, on the virtual clock of the simulation: periodic and one-shot
+ * deadlines, also across the millis() overflow, skipped late periods,
+ * timeToNext() and the run statistics.
+ *
+ * pio test -e native -f test_scheduler
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include <Arduino.h>
+#include <Scheduler.h>
+#include <unity.h>
+
+#include "sim.h"
+
+// millis() wraps at 2^32 ms
+#define WRAP_US (4294967296ull * 1000)
+
+static uint32_t runTimes[8];
+static uint8_t runCount;
+static uint16_t runDuration;  // µs, spent by each run
+
+static void record()
+{
+	if (runCount < sizeof(runTimes) / sizeof(runTimes[0])) runTimes[runCount] = millis();
+	runCount++;
+	if (runDuration > 0) delayMicroseconds(runDuration);
+}
+
+enum {
+	TASK_PERIODIC,
+	TASK_ONE_SHOT,
+	TASK_COUNT
+};
+
+static Task tasks[TASK_COUNT] = {
+	SCHEDULER_TASK(record, 10),
+	SCHEDULER_TASK(record, 0),
+};
+
+static Scheduler scheduler(tasks, TASK_COUNT);
+
+// run the scheduler every ms for ms, as loop() would do
+static void runFor(uint32_t ms)
+{
+	for (uint32_t i = 0; i < ms; i++) {
+		sim::advance(1000);
+		scheduler.run();
+	}
+}
+
+// to just before the next millis() overflow
+static void warpBeforeWrap(uint32_t ms)
+{
+	uint64_t wrap = (sim::now() / WRAP_US + 1) * WRAP_US;
+	sim::warpTo(wrap - ms * 1000ull);
+}
+
+void setUp(void)
+{
+	for (uint8_t i = 0; i < TASK_COUNT; i++) {
+		scheduler.stop(i);
+		tasks[i].runs = 0;
+		tasks[i].totalRunTime = 0;
+		tasks[i].maxRunTime = 0;
+		tasks[i].maxLateness = 0;
+	}
+	runCount = 0;
+	runDuration = 0;
+	// ms boundary
+	sim::warpTo((sim::now() / 1000 + 1) * 1000);
+}
+
+void tearDown(void)
+{
+}
+
+void test_periodic_keeps_its_phase(void)
+{
+	uint32_t start = millis();
+	scheduler.start(TASK_PERIODIC, 5);
+	runFor(40);
+	TEST_ASSERT_EQUAL_UINT8(4, runCount);
+	for (uint8_t i = 0; i < 4; i++) {
+		TEST_ASSERT_EQUAL_UINT32(start + 5 + 10 * i, runTimes[i]);
+	}
+	TEST_ASSERT_EQUAL_UINT16(0, tasks[TASK_PERIODIC].maxLateness);
+}
+
+void test_periodic_across_the_overflow(void)
+{
+	warpBeforeWrap(25);
+	uint32_t start = millis();
+	TEST_ASSERT_EQUAL_UINT32(UINT32_MAX - 24, start);
+	scheduler.start(TASK_PERIODIC, 10);
+	runFor(50);
+	TEST_ASSERT_EQUAL_UINT8(5, runCount);
+	for (uint8_t i = 0; i < 5; i++) {
+		TEST_ASSERT_EQUAL_UINT32(start + 10 + 10 * i, runTimes[i]);
+	}
+	// the third run is the first after the overflow
+	TEST_ASSERT_TRUE(runTimes[2] < start);
+}
+
+void test_one_shot_runs_once(void)
+{
+	scheduler.start(TASK_ONE_SHOT, 20);
+	runFor(19);
+	TEST_ASSERT_EQUAL_UINT8(0, runCount);
+	TEST_ASSERT_TRUE(scheduler.isActive(TASK_ONE_SHOT));
+	runFor(30);
+	TEST_ASSERT_EQUAL_UINT8(1, runCount);
+	TEST_ASSERT_FALSE(scheduler.isActive(TASK_ONE_SHOT));
+}
+
+void test_one_shot_across_the_overflow(void)
+{
+	warpBeforeWrap(5);
+	uint32_t start = millis();
+	scheduler.start(TASK_ONE_SHOT, 20);
+	// not due right after the overflow, the deadline is a small value now
+	runFor(19);
+	TEST_ASSERT_EQUAL_UINT8(0, runCount);
+	runFor(1);
+	TEST_ASSERT_EQUAL_UINT8(1, runCount);
+	TEST_ASSERT_EQUAL_UINT32(start + 20, runTimes[0]);
+	TEST_ASSERT_EQUAL_UINT32(15, runTimes[0]);
+}
+
+void test_late_period_is_skipped(void)
+{
+	uint32_t start = millis();
+	scheduler.start(TASK_PERIODIC, 10);
+	// blocked for 3.5 periods: a single run, then a period from now
+	sim::advance(35000);
+	scheduler.run();
+	TEST_ASSERT_EQUAL_UINT8(1, runCount);
+	TEST_ASSERT_EQUAL_UINT16(25, tasks[TASK_PERIODIC].maxLateness);
+	runFor(10);
+	TEST_ASSERT_EQUAL_UINT8(2, runCount);
+	TEST_ASSERT_EQUAL_UINT32(start + 45, runTimes[1]);
+}
+
+void test_late_run_keeps_the_phase(void)
+{
+	uint32_t start = millis();
+	scheduler.start(TASK_PERIODIC, 10);
+	// late by less than a period: the next one is still on time
+	sim::advance(13000);
+	scheduler.run();
+	TEST_ASSERT_EQUAL_UINT8(1, runCount);
+	runFor(7);
+	TEST_ASSERT_EQUAL_UINT8(2, runCount);
+	TEST_ASSERT_EQUAL_UINT32(start + 20, runTimes[1]);
+}
+
+void test_time_to_next(void)
+{
+	TEST_ASSERT_EQUAL_UINT16(SCHEDULER_IDLE, scheduler.timeToNext());
+	scheduler.start(TASK_PERIODIC, 30);
+	scheduler.start(TASK_ONE_SHOT, 12);
+	TEST_ASSERT_EQUAL_UINT16(12, scheduler.timeToNext());
+	runFor(12);
+	TEST_ASSERT_EQUAL_UINT8(1, runCount);
+	TEST_ASSERT_EQUAL_UINT16(18, scheduler.timeToNext());
+	sim::advance(18000);
+	TEST_ASSERT_EQUAL_UINT16(0, scheduler.timeToNext());
+	// past due is due too
+	sim::advance(5000);
+	TEST_ASSERT_EQUAL_UINT16(0, scheduler.timeToNext());
+	scheduler.stop(TASK_PERIODIC);
+	TEST_ASSERT_EQUAL_UINT16(SCHEDULER_IDLE, scheduler.timeToNext());
+}
+
+void test_time_to_next_across_the_overflow(void)
+{
+	warpBeforeWrap(3);
+	scheduler.start(TASK_PERIODIC, 10);
+	TEST_ASSERT_EQUAL_UINT16(10, scheduler.timeToNext());
+	sim::advance(6000);
+	TEST_ASSERT_EQUAL_UINT16(4, scheduler.timeToNext());
+}
+
+void test_statistics(void)
+{
+	runDuration = 300;
+	scheduler.start(TASK_PERIODIC, 10);
+	runFor(50);
+	TEST_ASSERT_EQUAL_UINT32(5, tasks[TASK_PERIODIC].runs);
+	TEST_ASSERT_EQUAL_UINT32(1500, tasks[TASK_PERIODIC].totalRunTime);
+	TEST_ASSERT_EQUAL_UINT16(300, tasks[TASK_PERIODIC].maxRunTime);
+}
+
+void test_statistics_before_the_overflow(void)
+{
+	// average kept when the total would overflow
+	runDuration = 200;
+	tasks[TASK_PERIODIC].runs = 20000000ul;
+	tasks[TASK_PERIODIC].totalRunTime = UINT32_MAX - 100;
+	scheduler.start(TASK_PERIODIC, 10);
+	runFor(10);
+	const Task* t = scheduler.getTask(TASK_PERIODIC);
+	TEST_ASSERT_EQUAL_UINT32(10000001ul, t->runs);
+	TEST_ASSERT_EQUAL_UINT32((UINT32_MAX - 100) / 2 + 200, t->totalRunTime);
+	TEST_ASSERT_EQUAL_UINT32((UINT32_MAX - 100) / 20000000ul, t->totalRunTime / t->runs);
+}
+
+int main(int argc, char** argv)
+{
+	(void) argc;
+	(void) argv;
+	UNITY_BEGIN();
+	RUN_TEST(test_periodic_keeps_its_phase);
+	RUN_TEST(test_periodic_across_the_overflow);
+	RUN_TEST(test_one_shot_runs_once);
+	RUN_TEST(test_one_shot_across_the_overflow);
+	RUN_TEST(test_late_period_is_skipped);
+	RUN_TEST(test_late_run_keeps_the_phase);
+	RUN_TEST(test_time_to_next);
+	RUN_TEST(test_time_to_next_across_the_overflow);
+	RUN_TEST(test_statistics);
+	RUN_TEST(test_statistics_before_the_overflow);
+	return UNITY_END();
+}
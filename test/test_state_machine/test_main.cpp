@@ -0,0 +1,231 @@
+/**
+ * This file is part of
+ *
+ * NITROX ANALYZER - unit tests
+ *
+ * UI state machine: every (state, event) pair through dispatch(), with
+ * recording hooks and actions. Checks the resulting state, the hooks and
+ * actions run and their order, the follow-up events the actions return
+ * and the redraw regions of each transition.
+ *
+ * pio test -e test_state_machine
+ *
+ * MIT License, see LICENSE file
+ *
+ * Copyright © 2020 Charles Fourneau
+ *
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "display.h"
+#include "state.h"
+
+// what dispatch() called, in order, space separated
+static char calls[256];
+// returned by the next action, then EVENT_NONE
+static event_t followUp;
+
+static void record(const char* name)
+{
+	if (calls[0] != '\0') strncat(calls, " ", sizeof(calls) - strlen(calls) - 1);
+	strncat(calls, name, sizeof(calls) - strlen(calls) - 1);
+}
+
+#define HOOK(name) void name() { record(#name); }
+#define ACTION(name) event_t name() { record(#name); event_t e = followUp; followUp = EVENT_NONE; return e; }
+
+HOOK(enterAnalyze)
+HOOK(enterHold)
+HOOK(enterCalibrateMenu)
+HOOK(enterCalibrate)
+HOOK(exitCalibrate)
+HOOK(enterError)
+HOOK(requestRender)
+HOOK(wakeDisplay)
+
+ACTION(beepSplash)
+ACTION(beepClick)
+ACTION(nextModDisplay)
+ACTION(previousModDisplay)
+ACTION(refreshFooter)
+ACTION(refreshReading)
+ACTION(autoHold)
+ACTION(predictSample)
+ACTION(printDebug)
+ACTION(dumpLog)
+ACTION(selectNext)
+ACTION(selectPrevious)
+ACTION(answerDialog)
+ACTION(calibrationSample)
+ACTION(checkCalibration)
+ACTION(saveCalibration)
+ACTION(reportCalibrationFailure)
+
+static const char* const stateNames[STATE_COUNT] = {
+	"START_SCREEN", "ANALYZE", "HOLD", "CALIBRATE_MENU", "CALIBRATE", "ERROR",
+};
+
+static const char* const eventNames[EVENT_COUNT] = {
+	"CLICKED", "HELD", "DOUBLE_CLICKED", "ENCODER_UP", "ENCODER_DOWN", "TIMER", "REFRESH", "SAMPLE",
+	"STABLE", "CONFIRM", "CANCEL", "CALIBRATION_DONE", "CALIBRATION_FAILED", "UNCALIBRATED", "GAS_CHANGED",
+};
+
+struct expected_t {
+	state_t from;
+	event_t event;
+	state_t to;
+	uint8_t redraw;
+	const char* calls;
+};
+
+// The UI as specified, written independently of state.cpp.
+// Every other pair is ignored: same state, nothing called, nothing drawn
+static const expected_t expected[] = {
+	{ STATE_START_SCREEN, EVENT_TIMER, STATE_ANALYZE, REGION_ALL,
+		"beepSplash enterAnalyze wakeDisplay requestRender" },
+
+	{ STATE_ANALYZE, EVENT_CLICKED, STATE_HOLD, REGION_ALL,
+		"beepClick enterHold wakeDisplay requestRender" },
+	{ STATE_ANALYZE, EVENT_HELD, STATE_CALIBRATE_MENU, REGION_ALL,
+		"enterCalibrateMenu wakeDisplay requestRender" },
+	{ STATE_ANALYZE, EVENT_DOUBLE_CLICKED, STATE_ANALYZE, 0, "printDebug" },
+	{ STATE_ANALYZE, EVENT_ENCODER_UP, STATE_ANALYZE, REGION_FOOTER, "nextModDisplay requestRender" },
+	{ STATE_ANALYZE, EVENT_ENCODER_DOWN, STATE_ANALYZE, REGION_FOOTER, "previousModDisplay requestRender" },
+	{ STATE_ANALYZE, EVENT_REFRESH, STATE_ANALYZE, REGION_HEADER | REGION_DIGITS | REGION_FOOTER,
+		"refreshReading requestRender" },
+	{ STATE_ANALYZE, EVENT_SAMPLE, STATE_ANALYZE, 0, "predictSample" },
+	{ STATE_ANALYZE, EVENT_STABLE, STATE_HOLD, REGION_ALL,
+		"autoHold enterHold wakeDisplay requestRender" },
+	{ STATE_ANALYZE, EVENT_UNCALIBRATED, STATE_CALIBRATE_MENU, REGION_ALL,
+		"enterCalibrateMenu wakeDisplay requestRender" },
+
+	{ STATE_HOLD, EVENT_CLICKED, STATE_ANALYZE, REGION_ALL,
+		"beepClick enterAnalyze wakeDisplay requestRender" },
+	{ STATE_HOLD, EVENT_HELD, STATE_CALIBRATE_MENU, REGION_ALL,
+		"enterCalibrateMenu wakeDisplay requestRender" },
+	{ STATE_HOLD, EVENT_DOUBLE_CLICKED, STATE_HOLD, 0, "dumpLog" },
+	{ STATE_HOLD, EVENT_ENCODER_UP, STATE_HOLD, REGION_FOOTER, "nextModDisplay requestRender" },
+	{ STATE_HOLD, EVENT_ENCODER_DOWN, STATE_HOLD, REGION_FOOTER, "previousModDisplay requestRender" },
+	{ STATE_HOLD, EVENT_REFRESH, STATE_HOLD, REGION_FOOTER, "refreshFooter requestRender" },
+	{ STATE_HOLD, EVENT_GAS_CHANGED, STATE_ANALYZE, REGION_ALL,
+		"enterAnalyze wakeDisplay requestRender" },
+
+	{ STATE_CALIBRATE_MENU, EVENT_CLICKED, STATE_CALIBRATE_MENU, 0, "answerDialog" },
+	{ STATE_CALIBRATE_MENU, EVENT_ENCODER_UP, STATE_CALIBRATE_MENU, REGION_DIGITS | REGION_FOOTER,
+		"selectNext requestRender" },
+	{ STATE_CALIBRATE_MENU, EVENT_ENCODER_DOWN, STATE_CALIBRATE_MENU, REGION_DIGITS | REGION_FOOTER,
+		"selectPrevious requestRender" },
+	{ STATE_CALIBRATE_MENU, EVENT_CONFIRM, STATE_CALIBRATE, REGION_ALL,
+		"enterCalibrate wakeDisplay requestRender" },
+	{ STATE_CALIBRATE_MENU, EVENT_CANCEL, STATE_ANALYZE, REGION_ALL,
+		"enterAnalyze wakeDisplay requestRender" },
+
+	{ STATE_CALIBRATE, EVENT_TIMER, STATE_CALIBRATE, 0, "checkCalibration" },
+	{ STATE_CALIBRATE, EVENT_SAMPLE, STATE_CALIBRATE, 0, "calibrationSample" },
+	{ STATE_CALIBRATE, EVENT_CALIBRATION_DONE, STATE_ANALYZE, REGION_ALL,
+		"exitCalibrate saveCalibration enterAnalyze wakeDisplay requestRender" },
+	{ STATE_CALIBRATE, EVENT_CALIBRATION_FAILED, STATE_ERROR, REGION_ALL,
+		"exitCalibrate reportCalibrationFailure enterError wakeDisplay requestRender" },
+
+	{ STATE_ERROR, EVENT_CLICKED, STATE_ANALYZE, REGION_ALL,
+		"enterAnalyze wakeDisplay requestRender" },
+};
+
+static expected_t expectedFor(state_t from, event_t event)
+{
+	for (const expected_t& e : expected) {
+		if (e.from == from && e.event == event) return e;
+	}
+	return { from, event, from, 0, "" };
+}
+
+static void run(state_t from, event_t event, event_t returned)
+{
+	calls[0] = '\0';
+	state = from;
+	followUp = returned;
+	dispatch(event);
+}
+
+// every pair, no follow-up event
+static void test_every_transition()
+{
+	for (uint8_t s = 0; s < STATE_COUNT; s++) {
+		for (uint8_t e = 0; e < EVENT_COUNT; e++) {
+			expected_t x = expectedFor((state_t)s, (event_t)e);
+			char message[64];
+			snprintf(message, sizeof(message), "%s + %s", stateNames[s], eventNames[e]);
+			run(x.from, x.event, EVENT_NONE);
+			TEST_ASSERT_EQUAL_STRING_MESSAGE(stateNames[x.to], stateNames[state], message);
+			TEST_ASSERT_EQUAL_STRING_MESSAGE(x.calls, calls, message);
+			TEST_ASSERT_EQUAL_HEX8_MESSAGE(x.redraw, getTransition(x.from, x.event).redraw, message);
+		}
+	}
+}
+
+// every pair with an action, which returns every event in turn: processed
+// after the hooks of the first transition, from the state it led to
+static void test_every_follow_up()
+{
+	for (const expected_t& x : expected) {
+		if (getTransition(x.from, x.event).action == NULL) continue;
+		for (uint8_t f = 0; f < EVENT_COUNT; f++) {
+			expected_t y = expectedFor(x.to, (event_t)f);
+			char sequence[sizeof(calls)];
+			snprintf(sequence, sizeof(sequence), "%s%s%s", x.calls, y.calls[0] != '\0' ? " " : "", y.calls);
+			char message[96];
+			snprintf(message, sizeof(message), "%s + %s, then %s", stateNames[x.from], eventNames[x.event], eventNames[f]);
+			run(x.from, x.event, (event_t)f);
+			TEST_ASSERT_EQUAL_STRING_MESSAGE(stateNames[y.to], stateNames[state], message);
+			TEST_ASSERT_EQUAL_STRING_MESSAGE(sequence, calls, message);
+		}
+	}
+}
+
+// the guards of the UI, as the firmware actions return them
+static void test_guards()
+{
+	// not calibrated at power up: straight to the calibration menu
+	run(STATE_START_SCREEN, EVENT_TIMER, EVENT_UNCALIBRATED);
+	TEST_ASSERT_EQUAL_INT(STATE_CALIBRATE_MENU, state);
+	// YES: calibrate
+	run(STATE_CALIBRATE_MENU, EVENT_CLICKED, EVENT_CONFIRM);
+	TEST_ASSERT_EQUAL_INT(STATE_CALIBRATE, state);
+	TEST_ASSERT_EQUAL_STRING("answerDialog enterCalibrate wakeDisplay requestRender", calls);
+	// NO: back to the analysis
+	run(STATE_CALIBRATE_MENU, EVENT_CLICKED, EVENT_CANCEL);
+	TEST_ASSERT_EQUAL_INT(STATE_ANALYZE, state);
+	// the check of the calibration ends it
+	run(STATE_CALIBRATE, EVENT_TIMER, EVENT_CALIBRATION_DONE);
+	TEST_ASSERT_EQUAL_INT(STATE_ANALYZE, state);
+	TEST_ASSERT_EQUAL_STRING("checkCalibration exitCalibrate saveCalibration enterAnalyze wakeDisplay requestRender", calls);
+	run(STATE_CALIBRATE, EVENT_TIMER, EVENT_CALIBRATION_FAILED);
+	TEST_ASSERT_EQUAL_INT(STATE_ERROR, state);
+	// a stable reading is held, the refresh draws it first
+	run(STATE_ANALYZE, EVENT_REFRESH, EVENT_STABLE);
+	TEST_ASSERT_EQUAL_INT(STATE_HOLD, state);
+	TEST_ASSERT_EQUAL_STRING("refreshReading requestRender autoHold enterHold wakeDisplay requestRender", calls);
+}
+
+void setUp()
+{
+	calls[0] = '\0';
+	followUp = EVENT_NONE;
+}
+
+void tearDown()
+{
+}
+
+int main(int argc, char** argv)
+{
+	(void) argc;
+	(void) argv;
+	UNITY_BEGIN();
+	RUN_TEST(test_every_transition);
+	RUN_TEST(test_every_follow_up);
+	RUN_TEST(test_guards);
+	return UNITY_END();
+}
@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+#
+# This file is part of
+#
+# NITROX ANALYZER
+# An Arduino based EANx/Nitrox analyzer
+#
+# MIT License, see LICENSE file
+#
+# Copyright © 2020 Charles Fourneau
+#
+"""Decode the telemetry stream of a -D TELEMETRY_ENABLE build.
+
+Reads a serial port (needs pyserial) or a file holding the raw stream
+(e.g. saved with --save, or by the simulator with -o), checks every frame
+and writes the samples as CSV. See include/telemetry.h for the format.
+The conversions can also be written as a simulator trace, to replay them
+through the firmware (see sim/README.md).
+
+  tools/telemetry.py /dev/ttyUSB0 --csv status.csv --raw raw.csv --save stream.bin
+  tools/telemetry.py stream.bin --csv status.csv
+  tools/telemetry.py stream.bin --trace recording.trace
+"""
+
+import argparse
+import csv
+import os
+import struct
+import sys
+import time
+
+RAW = 0x01
+STATUS = 0x02
+
+RAW_NV_PER_COUNT = 7812.5  # PGA 16
+
+STATES = ['START', 'ANALYZE', 'HOLD', 'CALIBRATE_MENU', 'CALIBRATE', 'ERROR']
+
+
+def crc_xmodem(data):
+    crc = 0
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class Decoder:
+    def __init__(self, on_raw, on_status):
+        self.on_raw = on_raw
+        self.on_status = on_status
+        self.buffer = bytearray()
+        self.synced = False
+        self.last_seq = None
+        self.frames = {RAW: 0, STATUS: 0}
+        self.bad = 0        # framing or CRC errors
+        self.lost = 0       # sequence numbers never received
+        self.dropped = 0    # frames the firmware could not queue, from STATUS
+        self.bytes = 0
+
+    def feed(self, data):
+        self.bytes += len(data)
+        for b in data:
+            if b != 0:
+                self.buffer.append(b)
+                continue
+            # the stream may start in the middle of a frame
+            if self.synced:
+                self.frame(cobs_decode(self.buffer))
+            self.synced = True
+            self.buffer.clear()
+
+    def frame(self, frame):
+        if frame is None or len(frame) < 4 or \
+                crc_xmodem(frame[:-2]) != struct.unpack_from('<H', frame, len(frame) - 2)[0]:
+            self.bad += 1
+            return
+        kind, seq = frame[0], frame[1]
+        payload = frame[2:-2]
+        if self.last_seq is not None:
+            self.lost += (seq - self.last_seq - 1) & 0xFF
+        self.last_seq = seq
+        if kind == RAW and len(payload) == 2:
+            self.frames[RAW] += 1
+            self.on_raw(seq, struct.unpack('<h', payload)[0])
+        elif kind == STATUS and len(payload) == 15:
+            self.frames[STATUS] += 1
+            average, fo2, gain, offset, battery, state, dropped, nv = struct.unpack('<hhHhhBHH', payload)
+            self.dropped = dropped
+            self.on_status(seq, average, nv, fo2, gain, offset, battery, state, dropped)
+        else:
+            self.bad += 1
+
+    def summary(self):
+        return ('%d bytes, %d raw + %d status frames, %d bad, %d lost in transit, '
+                '%d dropped by the firmware' % (self.bytes, self.frames[RAW], self.frames[STATUS],
+                                                self.bad, self.lost, self.dropped))
+
+
+def open_input(path, baud):
+    if os.path.isfile(path):
+        return open(path, 'rb'), False
+    try:
+        import serial
+    except ImportError:
+        sys.exit('%s is not a file, and reading a serial port needs pyserial' % path)
+    return serial.Serial(path, baud, timeout=0.2), True
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('input', help='serial port or raw stream file')
+    parser.add_argument('--baud', type=int, default=250000, help='TELEMETRY_BAUD (default 250000)')
+    parser.add_argument('--csv', metavar='FILE', help='write the STATUS frames')
+    parser.add_argument('--raw', metavar='FILE', help='write the RAW conversions')
+    parser.add_argument('--trace', metavar='FILE', help='write the RAW conversions as a simulator trace')
+    parser.add_argument('--rate', type=float, default=475, help='ADC data rate, to time the trace (default 475 SPS)')
+    parser.add_argument('--save', metavar='FILE', help='copy the undecoded stream, can be decoded again later')
+    parser.add_argument('--duration', type=float, help='stop reading a serial port after this many seconds')
+    args = parser.parse_args()
+
+    status_out = raw_out = None
+    files = []
+    if args.csv:
+        files.append(open(args.csv, 'w', newline=''))
+        status_out = csv.writer(files[-1])
+        status_out.writerow(['seq', 'average', 'uV', 'fO2_pct', 'gain', 'offset', 'battery_mV', 'state', 'dropped'])
+    if args.raw:
+        files.append(open(args.raw, 'w', newline=''))
+        raw_out = csv.writer(files[-1])
+        raw_out.writerow(['seq', 'conversion', 'uV'])
+    trace_out = None
+    if args.trace:
+        files.append(open(args.trace, 'w'))
+        trace_out = files[-1]
+        trace_out.write('# recorded from %s at %g SPS by tools/telemetry.py\n' % (args.input, args.rate))
+    save = open(args.save, 'wb') if args.save else None
+    conversions = [-1, 0]  # index of the last one, frames lost until then
+
+    def on_raw(seq, conversion):
+        if raw_out:
+            raw_out.writerow([seq, conversion, '%.3f' % (conversion * RAW_NV_PER_COUNT / 1000)])
+        if trace_out:
+            # lost frames were most likely conversions, keep the time base
+            conversions[0] += 1 + decoder.lost - conversions[1]
+            conversions[1] = decoder.lost
+            trace_out.write('%.3f adc %d\n' % (conversions[0] * 1000 / args.rate, conversion))
+
+    def on_status(seq, average, nv, fo2, gain, offset, battery, state, dropped):
+        if status_out:
+            status_out.writerow([seq, average, '%.3f' % (average * nv / 1000), '%.2f' % (fo2 / 100),
+                                 gain, offset, battery, STATES[state] if state < len(STATES) else state, dropped])
+
+    decoder = Decoder(on_raw, on_status)
+    source, is_port = open_input(args.input, args.baud)
+    start = time.monotonic()
+    try:
+        while args.duration is None or time.monotonic() - start < args.duration:
+            data = source.read(4096)
+            if not data:
+                if is_port:
+                    continue
+                break
+            if save:
+                save.write(data)
+            decoder.feed(data)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        source.close()
+        if trace_out:
+            trace_out.write('%.3f end\n' % ((conversions[0] + 1) * 1000 / args.rate))
+        for f in files + ([save] if save else []):
+            f.close()
+
+    print(decoder.summary(), file=sys.stderr)
+    return 1 if decoder.bad or decoder.lost or decoder.dropped else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())